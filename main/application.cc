@@ -2,6 +2,10 @@
 #include "board.h"
 #include "display.h"
 #include "system_info.h"
+#include "task_registry.h"
+#include "task_profiler.h"
+#include "memory_arena.h"
+#include "heap_profiler.h"
 #include "audio_codec.h"
 #include "mqtt_protocol.h"
 #include "websocket_protocol.h"
@@ -66,6 +70,8 @@ Application::Application() {
         .skip_unhandled_events = true
     };
     esp_timer_create(&clock_timer_args, &clock_timer_handle_);
+
+    RegisterDefaultMessageHandlers();
 }
 
 Application::~Application() {
@@ -76,6 +82,156 @@ Application::~Application() {
     vEventGroupDelete(event_group_);
 }
 
+void Application::RegisterMessageHandler(std::string_view type, MessageDispatcher::Handler handler) {
+    message_dispatcher_.Register(type, std::move(handler));
+}
+
+void Application::RegisterDefaultMessageHandlers() {
+    //如果收到的是TTS消息，说明是服务器正在说话，服务器通过TTS合成语音，并发送给设备播放
+    RegisterMessageHandler("tts", [this](const cJSON* root) {
+        auto state = MessageDispatcher::GetString(root, "state");
+        // 服务器发送给设备json文件，状态为start时，表示服务器开始说话，此时设备如果在空闲或者监听状态，切换到说话状态
+        if (state == "start") {
+            subtitles_.Start();
+            Schedule([this]() {
+                aborted_ = false;
+                if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
+                    SetDeviceState(kDeviceStateSpeaking);
+                }
+            });
+        // 服务器发送给设备json文件，状态为stop时，表示服务器停止说话，此时设备如果在说话状态，切换到监听或者空闲状态
+        } else if (state == "stop") {
+            subtitles_.Finish();
+            Schedule([this]() {
+                if (device_state_ == kDeviceStateSpeaking) {
+                    if (listening_mode_ == kListeningModeManualStop) {
+                        SetDeviceState(kDeviceStateIdle);
+                    } else {
+                        SetDeviceState(kDeviceStateListening);
+                    }
+                }
+            });
+        //服务器发送给设备json文件，状态为sentence_start时，表示服务器开始说一句话，此时设备如果在说话状态，显示当前句子
+        } else if (state == "sentence_start") {
+            //text字段是当前句子的文字内容，墨水屏需要显示当前句子，这是服务器端说话的内容
+            //句子在其音频开始播放时才显示，见 SetupSubtitles
+            auto text = MessageDispatcher::GetString(root, "text");
+            if (!text.empty()) {
+                ESP_LOGI(TAG, "<< %.*s", (int)text.size(), text.data());
+                subtitles_.AddSentence(std::string(text));
+            }
+        }
+    });
+    //如果收到的是STT消息，说明是服务器的语音转文字结果，服务器将用户说的话转成文字，并发送给设备，在墨水屏显示出来
+    RegisterMessageHandler("stt", [this](const cJSON* root) {
+        auto text = MessageDispatcher::GetString(root, "text");
+        if (!text.empty()) {
+            ESP_LOGI(TAG, ">> %.*s", (int)text.size(), text.data());
+            //===================== [wj] Start =====================
+                // @Author  : Wang Jian
+                // @Date    : 2025-10-7
+                // @Reason  : route STT result to DisplayManager (user side)
+            // Route user STT result to DisplayManager (user side)
+            Schedule([this, message = std::string(text)]() {
+                EpdManager::GetInstance().UpdateConversationSide(true, message, "");
+                //===================== [wj] End =====================
+            });
+        }
+    });
+    //如果收到的是LLM消息，说明是服务器发送的情感变化命令，改变设备表情
+    RegisterMessageHandler("llm", [this](const cJSON* root) {
+        auto emotion = MessageDispatcher::GetString(root, "emotion");
+        if (!emotion.empty()) {
+            Schedule([emotion_str = std::string(emotion)]() {
+                Board::GetInstance().GetDisplay()->SetEmotion(emotion_str.c_str());
+            });
+        }
+    });
+    //MCP消息由 McpServer 自己注册处理，见 McpServer::RegisterMessageHandler
+    //这部分处理系统层面的命令，比如“重启”、“恢复出厂”、“清理缓存”等。
+    RegisterMessageHandler("system", [this](const cJSON* root) {
+        auto command = MessageDispatcher::GetString(root, "command");
+        if (command.empty()) {
+            return;
+        }
+        ESP_LOGI(TAG, "System command: %.*s", (int)command.size(), command.data());
+        if (command == "reboot") {
+            // Do a reboot if user requests a OTA update
+            Schedule([this]() {
+                Reboot();
+            });
+        } else {
+            ESP_LOGW(TAG, "Unknown system command: %.*s", (int)command.size(), command.data());
+        }
+    });
+    //这是用来显示警告、提示或系统消息的，比如：网络断开；版本不兼容；设备电量低；登录失效；服务器错误。
+    RegisterMessageHandler("alert", [this](const cJSON* root) {
+        auto status = cJSON_GetObjectItem(root, "status");
+        auto message = cJSON_GetObjectItem(root, "message");
+        auto emotion = cJSON_GetObjectItem(root, "emotion");
+        if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
+            Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::OGG_VIBRATION);
+        } else {
+            ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+        }
+    });
+#if CONFIG_RECEIVE_CUSTOM_MESSAGE
+    RegisterMessageHandler("custom", [this](const cJSON* root) {
+        auto payload = cJSON_GetObjectItem(root, "payload");
+        if (!cJSON_IsObject(payload)) {
+            ESP_LOGW(TAG, "Invalid custom message format: missing payload");
+            return;
+        }
+        // Print the payload once, the log and the display share the same string
+        char* payload_json = cJSON_PrintUnformatted(payload);
+        if (payload_json == nullptr) {
+            return;
+        }
+        std::string payload_str(payload_json);
+        cJSON_free(payload_json);
+        ESP_LOGI(TAG, "Received custom message: %s", payload_str.c_str());
+        //===================== [wj] Start =====================
+            // @Author  : Wang Jian
+            // @Date    : 2025-10-7
+            // @Reason  : route custom payload to DisplayManager (system side)
+        Schedule([this, payload_str = std::move(payload_str)]() {
+            // Show custom payload on the e-paper as a system-side message
+            EpdManager::GetInstance().UpdateConversationSide(false, payload_str, "");
+        //===================== [wj] End =====================
+        });
+    });
+#endif
+}
+
+void Application::SetupSubtitles() {
+    // LCD appends every sentence, OLED batches them into fewer redraws
+    auto display = Board::GetInstance().GetDisplay();
+    subtitles_.AddSink(display->subtitle_batch_ms(), [this, display](const std::string& text, bool new_turn) {
+        Schedule([display, text, new_turn]() {
+            if (new_turn) {
+                display->SetChatMessage("assistant", text.c_str());
+            } else {
+                display->AppendChatMessage("assistant", text.c_str());
+            }
+        });
+    });
+    //===================== [wj] Start =====================
+    // @Author  : Wang Jian
+    // @Date    : 2025-10-7
+    // @Reason  : route TTS sentence to DisplayManager (assistant side)
+    // Send assistant (server TTS) sentences to DisplayManager, batched since every update redraws the e-paper
+    subtitles_.AddSink(CONFIG_SUBTITLE_BATCH_MS, [this](const std::string& text, bool new_turn) {
+        Schedule([text, new_turn]() {
+            if (new_turn) {
+                EpdManager::GetInstance().UpdateConversationSide(false, text, "");
+            } else {
+                EpdManager::GetInstance().AppendConversationSide(false, text);
+            }
+        });
+    });
+    //===================== [wj] End =====================
+}
+
 void Application::CheckAssetsVersion() {
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
@@ -104,11 +260,7 @@ void Application::CheckAssetsVersion() {
         display->SetChatMessage("system", Lang::Strings::PLEASE_WAIT);
 
         bool success = assets.Download(download_url, [display](int progress, size_t speed) -> void {
-            std::thread([display, progress, speed]() {
-                char buffer[32];
-                snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-                display->SetChatMessage("system", buffer);
-            }).detach();
+            display->ui_updates().Post(kUiSlotChatMessage, "%d%% %uKB/s", progress, speed / 1024);
         });
 
         board.SetPowerSaveMode(true);
@@ -276,14 +428,10 @@ void Application::ToggleChatState() {
 
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
-            if (!protocol_->IsAudioChannelOpened()) {
-                SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
-                    return;
-                }
-            }
-
-            SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+            auto mode = aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime;
+            ConnectAndListen(mode, [this, mode]() {
+                SetListeningMode(mode);
+            });
         });
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
@@ -313,14 +461,9 @@ void Application::StartListening() {
     
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
-            if (!protocol_->IsAudioChannelOpened()) {
-                SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
-                    return;
-                }
-            }
-
-            SetListeningMode(kListeningModeManualStop);
+            ConnectAndListen(kListeningModeManualStop, [this]() {
+                SetListeningMode(kListeningModeManualStop);
+            });
         });
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
@@ -407,13 +550,26 @@ void Application::Start() {
     callbacks.on_vad_change = [this](bool speaking) {
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
+
+    //TTS 音频播放到的位置，用于同步显示字幕
+    SetupSubtitles();
+    callbacks.on_playback_position = [this](uint32_t turn, uint32_t position_ms) {
+        subtitles_.OnPlayback(turn, position_ms);
+    };
     audio_service_.SetCallbacks(callbacks);
 
     // Start the main event loop task with priority 3，创建主循环任务
-    xTaskCreate([](void* arg) {
+    TaskRegistry::Create(kTaskMainEventLoop, [](void* arg) {
         ((Application*)arg)->MainEventLoop();
         vTaskDelete(NULL);
-    }, "main_event_loop", 2048 * 4, this, 3, &main_event_loop_task_handle_);
+    }, this, &main_event_loop_task_handle_);
+
+#if CONFIG_USE_TASK_PROFILER
+    TaskProfiler::GetInstance().Start(CONFIG_TASK_PROFILER_INTERVAL_MS);
+#endif
+#if CONFIG_USE_HEAP_PROFILER
+    HeapProfiler::Start();
+#endif
 
     /* Start the clock timer to update the status bar */
     esp_timer_start_periodic(clock_timer_handle_, 1000000);
@@ -449,6 +605,8 @@ void Application::Start() {
     mcp_server.AddCommonTools();
     //注册用户专属工具（权限更高），设备重启，OTA升级等
     mcp_server.AddUserOnlyTools();
+    //接收服务器发送的MCP命令，执行对应的工具逻辑
+    mcp_server.RegisterMessageHandler();
     //创建Mqtt协议对象或者WebSocket协议对象
     if (ota.HasMqttConfig()) {
         protocol_ = std::make_unique<MqttProtocol>();
@@ -471,7 +629,15 @@ void Application::Start() {
     //当收到来自服务器的音频包时被调用，在设备当前处于正在播放/说话状态才把包丢到解码队列，其他状态则丢弃
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
         if (device_state_ == kDeviceStateSpeaking) {
-            audio_service_.PushPacketToDecodeQueue(std::move(packet));
+            ReportWakeLatency(wake_first_tts_pending_, "first TTS audio");
+            // Tag the packet with its place in the TTS stream so the subtitles follow playback
+            uint32_t turn;
+            uint32_t position_ms = subtitles_.NextAudioPosition(packet->frame_duration, turn);
+            packet->stream_position_ms = position_ms;
+            packet->stream_turn = turn;
+            if (audio_service_.PushPacketToDecodeQueue(std::move(packet))) {
+                subtitles_.AddAudio(turn, position_ms);
+            }
         }
     });
     //设备与服务器之间的音频通道（Audio Stream 通信链路）建立成功
@@ -496,127 +662,14 @@ void Application::Start() {
     //STT语音转文字，用于设备向服务器发送语音，服务器转成文字，并返回文字结果
     //LLM大模型交互，用于设备向服务器发送文字，服务器返回大模型生成的回答
     //TTS文字转语音，用于服务器将模型返回的文字生成语音，并将json和音频包发送给设备
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        //如果收到的是TTS消息，说明是服务器正在说话，服务器通过TTS合成语音，并发送给设备播放
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-        // 服务器发送给设备json文件，状态为start时，表示服务器开始说话，此时设备如果在空闲或者监听状态，切换到说话状态
-            if (strcmp(state->valuestring, "start") == 0) {
-                Schedule([this]() {
-                    aborted_ = false;
-                    if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
-                        SetDeviceState(kDeviceStateSpeaking);
-                    }
-                });
-        // 服务器发送给设备json文件，状态为stop时，表示服务器停止说话，此时设备如果在说话状态，切换到监听或者空闲状态
-            } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
-                    if (device_state_ == kDeviceStateSpeaking) {
-                        if (listening_mode_ == kListeningModeManualStop) {
-                            SetDeviceState(kDeviceStateIdle);
-                        } else {
-                            SetDeviceState(kDeviceStateListening);
-                        }
-                    }
-                });
-        //服务器发送给设备json文件，状态为sentence_start时，表示服务器开始说一句话，此时设备如果在说话状态，显示当前句子
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-        //text字段是当前句子的文字内容，墨水屏需要显示当前句子，这是服务器端说话的内容
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    //===================== [wj] Start =====================
-                    // @Author  : Wang Jian
-                    // @Date    : 2025-10-7
-                    // @Reason  : route TTS sentence to DisplayManager (assistant side)
-                    // Send assistant (server TTS) sentence start to DisplayManager
-                    Schedule([this, message = std::string(text->valuestring)]() {
-                        EpdManager::GetInstance().UpdateConversationSide(false, message, "");
-                    //===================== [wj] End =====================
-                    });
-                }
-            }
-        //如果收到的是STT消息，说明是服务器的语音转文字结果，服务器将用户说的话转成文字，并发送给设备，在墨水屏显示出来
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                //===================== [wj] Start =====================
-                    // @Author  : Wang Jian
-                    // @Date    : 2025-10-7
-                    // @Reason  : route STT result to DisplayManager (user side)
-                // Route user STT result to DisplayManager (user side)
-                Schedule([this, message = std::string(text->valuestring)]() {
-                    EpdManager::GetInstance().UpdateConversationSide(true, message, "");
-                    //===================== [wj] End =====================
-                });
-            }
-        //如果收到的是LLM消息，说明是服务器发送的情感变化命令，改变设备表情
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
-                });
-            }
-        //如果收到的是MCP消息，说明是服务器发送的MCP命令，执行对应的工具逻辑
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
-                McpServer::GetInstance().ParseMessage(payload);
-            }
-        //这部分处理系统层面的命令，比如“重启”、“恢复出厂”、“清理缓存”等。
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (cJSON_IsString(command)) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
-                    // Do a reboot if user requests a OTA update
-                    Schedule([this]() {
-                        Reboot();
-                    });
-                } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
-                }
-            }
-        //这是用来显示警告、提示或系统消息的，比如：网络断开；版本不兼容；设备电量低；登录失效；服务器错误。
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::OGG_VIBRATION);
-            } else {
-                ESP_LOGW(TAG, "Alert command requires status, message and emotion");
-            }
-#if CONFIG_RECEIVE_CUSTOM_MESSAGE
-        } else if (strcmp(type->valuestring, "custom") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
-            if (cJSON_IsObject(payload)) {
-                //===================== [wj] Start =====================
-                    // @Author  : Wang Jian
-                    // @Date    : 2025-10-7
-                    // @Reason  : route custom payload to DisplayManager (system side)
-                Schedule([this, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
-                    // Show custom payload on the e-paper as a system-side message
-                    EpdManager::GetInstance().UpdateConversationSide(false, payload_str, "");
-                //===================== [wj] End =====================
-                });
-            } else {
-                ESP_LOGW(TAG, "Invalid custom message format: missing payload");
-            }
-#endif
-        } else {
-            ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
-        }
+    protocol_->OnIncomingJson([this](const cJSON* root) {
+        message_dispatcher_.Dispatch(root);
     });
     //初始化协议，建立与服务器的连接
     bool protocol_started = protocol_->Start();
 
     SystemInfo::PrintHeapStats();
+    MemoryArena::PrintReport();
     SetDeviceState(kDeviceStateIdle);
 
     has_server_time_ = ota.HasServerTime();
@@ -655,11 +708,20 @@ void Application::MainEventLoop() {
             Alert(Lang::Strings::ERROR, last_error_message_.c_str(), "circle_xmark", Lang::Sounds::OGG_EXCLAMATION);
         }
 
-        if (bits & MAIN_EVENT_SEND_AUDIO) {
+        // Audio captured while the channel opens stays queued until the server hello
+        if ((bits & MAIN_EVENT_SEND_AUDIO) && device_state_ != kDeviceStateConnecting) {
             while (auto packet = audio_service_.PopPacketFromSendQueue()) {
+                if (protocol_ && packet->gap_ms > 0) {
+                    protocol_->SendVoiceGap(packet->gap_start_ms, packet->gap_ms);
+                }
                 if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
                     break;
                 }
+                ReportWakeLatency(wake_first_byte_pending_, "first uplink audio");
+            }
+            size_t dropped = audio_service_.TakeSendDroppedCount();
+            if (dropped > 0) {
+                ESP_LOGW(TAG, "Uplink stalled, %u audio packets dropped", dropped);
             }
         }
 
@@ -693,6 +755,16 @@ void Application::MainEventLoop() {
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
                 // SystemInfo::PrintTaskList();
                 SystemInfo::PrintHeapStats();
+#if CONFIG_USE_TASK_PROFILER
+                TaskProfiler::GetInstance().PrintStats();
+#endif
+            }
+            // Arena low water marks and fragmentation drift slowly, once a minute is enough
+            if (clock_ticks_ % 60 == 0) {
+                MemoryArena::PrintReport();
+#if CONFIG_USE_HEAP_PROFILER
+                HeapProfiler::PrintHotspots(10);
+#endif
             }
         }
     }
@@ -704,31 +776,29 @@ void Application::OnWakeWordDetected() {
     }
 
     if (device_state_ == kDeviceStateIdle) {
+        StartWakeLatency();
         audio_service_.EncodeWakeWord();
 
-        if (!protocol_->IsAudioChannelOpened()) {
-            SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
-                audio_service_.EnableWakeWordDetection(true);
-                return;
-            }
-        }
-
         auto wake_word = audio_service_.GetLastWakeWord();
         ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
+        auto mode = aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime;
+        ConnectAndListen(mode, [this, mode, wake_word]() {
 #if CONFIG_SEND_WAKE_WORD_DATA
-        // Encode and send the wake word data to the server
-        while (auto packet = audio_service_.PopWakeWordPacket()) {
-            protocol_->SendAudio(std::move(packet));
-        }
-        // Set the chat state to wake word detected
-        protocol_->SendWakeWordDetected(wake_word);
-        SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+            // Encode and send the wake word data to the server
+            while (auto packet = audio_service_.PopWakeWordPacket()) {
+                if (protocol_->SendAudio(std::move(packet))) {
+                    ReportWakeLatency(wake_first_byte_pending_, "first uplink audio");
+                }
+            }
+            // Set the chat state to wake word detected
+            protocol_->SendWakeWordDetected(wake_word);
+            SetListeningMode(mode);
 #else
-        SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
-        // Play the pop up sound to indicate the wake word is detected
-        audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
+            SetListeningMode(mode);
+            // Play the pop up sound to indicate the wake word is detected
+            audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
 #endif
+        });
     } else if (device_state_ == kDeviceStateSpeaking) {
         AbortSpeaking(kAbortReasonWakeWordDetected);
     } else if (device_state_ == kDeviceStateActivating) {
@@ -744,6 +814,58 @@ void Application::AbortSpeaking(AbortReason reason) {
     }
 }
 
+// Open the audio channel without blocking the main event loop. The microphone starts at once and
+// its packets wait in the send queue until the server hello has arrived (the queue covers the
+// whole hello timeout); then on_opened runs on the main event loop and is expected to call
+// SetListeningMode.
+void Application::ConnectAndListen(ListeningMode mode, std::function<void()> on_opened) {
+    if (protocol_->IsAudioChannelOpened()) {
+        on_opened();
+        return;
+    }
+
+    SetDeviceState(kDeviceStateConnecting);
+    listening_mode_ = mode;
+    audio_service_.EnableVoiceGate(mode == kListeningModeManualStop);
+    // The wake word kept the input running, so live audio follows its buffer without a warm up gap
+    audio_service_.EnableVoiceProcessing(true, !audio_service_.IsWakeWordRunning());
+    audio_service_.EnableWakeWordDetection(false);
+
+    bool started = protocol_->OpenAudioChannelAsync([this, on_opened = std::move(on_opened)](bool opened) {
+        if (opened) {
+            ReportWakeLatency(wake_channel_pending_, "channel ready");
+        }
+        Schedule([this, opened, on_opened]() {
+            // An error or the user may already have moved us on
+            if (device_state_ != kDeviceStateConnecting) {
+                return;
+            }
+            if (!opened) {
+                SetDeviceState(kDeviceStateIdle);
+                return;
+            }
+            on_opened();
+        });
+    });
+    if (!started) {
+        SetDeviceState(kDeviceStateIdle);
+    }
+}
+
+// Wake to channel ready, first uplink audio and first TTS audio, for the log only
+void Application::StartWakeLatency() {
+    wake_time_ = esp_timer_get_time();
+    wake_channel_pending_ = true;
+    wake_first_byte_pending_ = true;
+    wake_first_tts_pending_ = true;
+}
+
+void Application::ReportWakeLatency(std::atomic<bool>& pending, const char* milestone) {
+    if (pending.exchange(false)) {
+        ESP_LOGI(TAG, "Wake to %s: %d ms", milestone, (int)((esp_timer_get_time() - wake_time_) / 1000));
+    }
+}
+
 void Application::SetListeningMode(ListeningMode mode) {
     listening_mode_ = mode;
     SetDeviceState(kDeviceStateListening);
@@ -769,6 +891,9 @@ void Application::SetDeviceState(DeviceState state) {
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
+            // A wake that ends here has nothing left to measure
+            wake_channel_pending_ = wake_first_byte_pending_ = wake_first_tts_pending_ = false;
+            subtitles_.Clear();
             display->SetStatus(Lang::Strings::STANDBY);
             display->SetEmotion("neutral");
             audio_service_.EnableVoiceProcessing(false);
@@ -783,12 +908,19 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
 
-            // Make sure the audio processor is running
-            if (!audio_service_.IsAudioProcessorRunning()) {
+            // Make sure the audio processor is running, it already is if it captured while connecting
+            if (previous_state == kDeviceStateConnecting || !audio_service_.IsAudioProcessorRunning()) {
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
-                audio_service_.EnableVoiceProcessing(true);
-                audio_service_.EnableWakeWordDetection(false);
+                if (!audio_service_.IsAudioProcessorRunning()) {
+                    // Only manual stop ends the turn explicitly, in auto stop and realtime modes the
+                    // server VAD needs the silence to find the end of speech
+                    audio_service_.EnableVoiceGate(listening_mode_ == kListeningModeManualStop);
+                    audio_service_.EnableVoiceProcessing(true);
+                    audio_service_.EnableWakeWordDetection(false);
+                }
+                // Flush the audio held back while connecting
+                xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
             }
             break;
         case kDeviceStateSpeaking:
@@ -848,11 +980,7 @@ bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
     vTaskDelay(pdMS_TO_TICKS(1000));
 
     bool upgrade_success = ota.StartUpgradeFromUrl(upgrade_url, [display](int progress, size_t speed) {
-        std::thread([display, progress, speed]() {
-            char buffer[32];
-            snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-            display->SetChatMessage("system", buffer);
-        }).detach();
+        display->ui_updates().Post(kUiSlotChatMessage, "%d%% %uKB/s", progress, speed / 1024);
     });
 
     if (!upgrade_success) {
@@ -879,30 +1007,28 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
     }
 
     if (device_state_ == kDeviceStateIdle) {
+        StartWakeLatency();
         audio_service_.EncodeWakeWord();
 
-        if (!protocol_->IsAudioChannelOpened()) {
-            SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
-                audio_service_.EnableWakeWordDetection(true);
-                return;
-            }
-        }
-
         ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
+        auto mode = aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime;
+        ConnectAndListen(mode, [this, mode, wake_word]() {
 #if CONFIG_USE_AFE_WAKE_WORD || CONFIG_USE_CUSTOM_WAKE_WORD
-        // Encode and send the wake word data to the server
-        while (auto packet = audio_service_.PopWakeWordPacket()) {
-            protocol_->SendAudio(std::move(packet));
-        }
-        // Set the chat state to wake word detected
-        protocol_->SendWakeWordDetected(wake_word);
-        SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
+            // Encode and send the wake word data to the server
+            while (auto packet = audio_service_.PopWakeWordPacket()) {
+                if (protocol_->SendAudio(std::move(packet))) {
+                    ReportWakeLatency(wake_first_byte_pending_, "first uplink audio");
+                }
+            }
+            // Set the chat state to wake word detected
+            protocol_->SendWakeWordDetected(wake_word);
+            SetListeningMode(mode);
 #else
-        SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
-        // Play the pop up sound to indicate the wake word is detected
-        audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
+            SetListeningMode(mode);
+            // Play the pop up sound to indicate the wake word is detected
+            audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
 #endif
+        });
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
@@ -10,11 +10,14 @@
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <atomic>
 
 #include "protocol.h"
 #include "ota.h"
 #include "audio_service.h"
 #include "device_state_event.h"
+#include "message_dispatcher.h"
+#include "subtitle_timeline.h"
 
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
@@ -63,6 +66,9 @@ public:
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
+    // Handle server messages of the given type, replacing the default handler if any.
+    // Register before the protocol starts, handlers run on the network task.
+    void RegisterMessageHandler(std::string_view type, MessageDispatcher::Handler handler);
 
 private:
     Application();
@@ -78,6 +84,8 @@ private:
     AecMode aec_mode_ = kAecOff;
     std::string last_error_message_;
     AudioService audio_service_;
+    MessageDispatcher message_dispatcher_;
+    SubtitleTimeline subtitles_;
 
     bool has_server_time_ = false;
     bool aborted_ = false;
@@ -85,11 +93,22 @@ private:
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
 
+    // Latency of the current wake, each milestone is logged once
+    int64_t wake_time_ = 0;
+    std::atomic<bool> wake_channel_pending_ = false;
+    std::atomic<bool> wake_first_byte_pending_ = false;
+    std::atomic<bool> wake_first_tts_pending_ = false;
+
     void OnWakeWordDetected();
     void CheckNewVersion(Ota& ota);
     void CheckAssetsVersion();
+    void RegisterDefaultMessageHandlers();
+    void SetupSubtitles();
     void ShowActivationCode(const std::string& code, const std::string& message);
     void SetListeningMode(ListeningMode mode);
+    void ConnectAndListen(ListeningMode mode, std::function<void()> on_opened);
+    void StartWakeLatency();
+    void ReportWakeLatency(std::atomic<bool>& pending, const char* milestone);
 };
 
 
@@ -160,6 +160,11 @@ bool Assets::Apply() {
                 ESP_LOGE(TAG, "Failed to load fonts.bin");
                 return false;
             }
+            // Optional UTF-8 list of the most frequent characters, cached before the themes use the font
+            cJSON* prewarm = cJSON_GetObjectItem(root, "text_font_prewarm");
+            if (cJSON_IsString(prewarm) && GetAssetData(prewarm->valuestring, ptr, size)) {
+                text_font->Prewarm(static_cast<const char*>(ptr), size);
+            }
             if (light_theme != nullptr) {
                 light_theme->set_text_font(text_font);
             }
@@ -272,7 +277,8 @@ bool Assets::Apply() {
     if (cJSON_IsString(font)) {
         std::string fonts_text_file = font->valuestring;
         if (GetAssetData(fonts_text_file, ptr, size)) {
-            auto text_font = std::make_shared<LvglCBinFont>(ptr);
+            // esp_emote_gfx draws the glyphs itself
+            auto text_font = std::make_shared<LvglCBinFont>(ptr, false);
             if (text_font->font() == nullptr) {
                 ESP_LOGE(TAG, "Failed to load fonts.bin");
                 return false;
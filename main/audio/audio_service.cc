@@ -1,4 +1,5 @@
 #include "audio_service.h"
+#include "task_registry.h"
 #include <esp_log.h>
 #include <cstring>
 
@@ -41,6 +42,13 @@ void AudioService::Initialize(AudioCodec* codec) {
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
         reference_resampler_.Configure(codec->input_sample_rate(), 16000);
+        // Further microphones of an array each keep their own resampler state
+        int extra_mics = codec->input_channels() - (codec->input_reference() ? 2 : 1);
+        for (int i = 0; i < extra_mics; i++) {
+            auto resampler = std::make_unique<OpusResampler>();
+            resampler->Configure(codec->input_sample_rate(), 16000);
+            extra_mic_resamplers_.push_back(std::move(resampler));
+        }
     }
 
 #if CONFIG_USE_AUDIO_PROCESSOR
@@ -50,9 +58,20 @@ void AudioService::Initialize(AudioCodec* codec) {
 #endif
 
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
+        if (voice_gate_active_) {
+            voice_gate_->Process(std::move(data), voice_detected_);
+            return;
+        }
         PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
     });
 
+#if CONFIG_USE_VOICE_GATE
+    voice_gate_ = std::make_unique<VoiceGate>(OPUS_FRAME_DURATION_MS, CONFIG_VOICE_GATE_HANGOVER_MS, CONFIG_VOICE_GATE_PREROLL_MS);
+    voice_gate_->OnOutput([this](std::vector<int16_t>&& data, uint32_t gap_start_ms, uint32_t gap_ms) {
+        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data), gap_start_ms, gap_ms);
+    });
+#endif
+
     audio_processor_->OnVadStateChange([this](bool speaking) {
         voice_detected_ = speaking;
         if (callbacks_.on_vad_change) {
@@ -60,6 +79,16 @@ void AudioService::Initialize(AudioCodec* codec) {
         }
     });
 
+#if CONFIG_USE_MIC_ARRAY_BEAMFORMING
+    int mic_channels = codec->input_channels() - (codec->input_reference() ? 1 : 0);
+    if (mic_channels > 1) {
+        mic_array_ = std::make_unique<MicArrayFrontEnd>(mic_channels, codec->input_reference(),
+            CONFIG_MIC_ARRAY_SPACING_MM, 16000);
+    } else {
+        ESP_LOGW(TAG, "Mic array beamforming needs 2 or more microphones, the codec has %d", mic_channels);
+    }
+#endif
+
     esp_timer_create_args_t audio_power_timer_args = {
         .callback = [](void* arg) {
             AudioService* audio_service = (AudioService*)arg;
@@ -79,42 +108,26 @@ void AudioService::Start() {
 
     esp_timer_start_periodic(audio_power_timer_, 1000000);
 
-#if CONFIG_USE_AUDIO_PROCESSOR
-    /* Start the audio input task */
-    xTaskCreatePinnedToCore([](void* arg) {
-        AudioService* audio_service = (AudioService*)arg;
-        audio_service->AudioInputTask();
-        vTaskDelete(NULL);
-    }, "audio_input", 2048 * 3, this, 8, &audio_input_task_handle_, 0);
-
-    /* Start the audio output task */
-    xTaskCreate([](void* arg) {
-        AudioService* audio_service = (AudioService*)arg;
-        audio_service->AudioOutputTask();
-        vTaskDelete(NULL);
-    }, "audio_output", 2048 * 2, this, 4, &audio_output_task_handle_);
-#else
     /* Start the audio input task */
-    xTaskCreate([](void* arg) {
+    TaskRegistry::Create(kTaskAudioInput, [](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioInputTask();
         vTaskDelete(NULL);
-    }, "audio_input", 2048 * 2, this, 8, &audio_input_task_handle_);
+    }, this, &audio_input_task_handle_);
 
     /* Start the audio output task */
-    xTaskCreate([](void* arg) {
+    TaskRegistry::Create(kTaskAudioOutput, [](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioOutputTask();
         vTaskDelete(NULL);
-    }, "audio_output", 2048, this, 4, &audio_output_task_handle_);
-#endif
+    }, this, &audio_output_task_handle_);
 
     /* Start the opus codec task */
-    xTaskCreate([](void* arg) {
+    TaskRegistry::Create(kTaskOpusCodec, [](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->OpusCodecTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 13, this, 2, &opus_codec_task_handle_);
+    }, this, &opus_codec_task_handle_);
 }
 
 void AudioService::Stop() {
@@ -144,22 +157,33 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
         if (!codec_->InputData(data)) {
             return false;
         }
-        if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
+        int channels = codec_->input_channels();
+        if (channels > 1) {
+            // Resample each channel on its own: the microphones first, the reference (if any) last
+            size_t frames = data.size() / channels;
+            auto channel = std::vector<int16_t>(frames);
+            std::vector<int16_t> resampled;
+            std::vector<int16_t> output;
+            for (int c = 0; c < channels; c++) {
+                OpusResampler* resampler;
+                if (c == 0) {
+                    resampler = &input_resampler_;
+                } else if (c == channels - 1 && codec_->input_reference()) {
+                    resampler = &reference_resampler_;
+                } else {
+                    resampler = extra_mic_resamplers_[c - 1].get();
+                }
+                for (size_t i = 0; i < frames; ++i) {
+                    channel[i] = data[i * channels + c];
+                }
+                resampled.resize(resampler->GetOutputSamples(frames));
+                resampler->Process(channel.data(), frames, resampled.data());
+                output.resize(resampled.size() * channels);
+                for (size_t i = 0; i < resampled.size(); ++i) {
+                    output[i * channels + c] = resampled[i];
+                }
             }
+            data = std::move(output);
         } else {
             auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
             input_resampler_.Process(data.data(), data.size(), resampled.data());
@@ -212,10 +236,11 @@ void AudioService::AudioInputTask() {
             std::vector<int16_t> data;
             int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
             if (ReadAudioData(data, 16000, samples)) {
-                // If input channels is 2, we need to fetch the left channel data
-                if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
+                // With several input channels, we only keep the first microphone
+                int channels = codec_->input_channels();
+                if (channels > 1) {
+                    auto mono_data = std::vector<int16_t>(data.size() / channels);
+                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += channels) {
                         mono_data[i] = data[j];
                     }
                     data = std::move(mono_data);
@@ -243,6 +268,11 @@ void AudioService::AudioInputTask() {
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+                    if (mic_array_ && !mic_array_->Process(data)) {
+                        // The AFE expects the beam layout, so a frame that could not be collapsed is dropped
+                        ESP_LOGE(TAG, "Mic array rejected %u samples, frame dropped", data.size());
+                        continue;
+                    }
                     audio_processor_->Feed(std::move(data));
                     continue;
                 }
@@ -280,6 +310,10 @@ void AudioService::AudioOutputTask() {
         last_output_time_ = std::chrono::steady_clock::now();
         debug_statistics_.playback_count++;
 
+        if (task->stream_position_ms > 0 && callbacks_.on_playback_position) {
+            callbacks_.on_playback_position(task->stream_turn, task->stream_position_ms);
+        }
+
 #if CONFIG_USE_SERVER_AEC
         /* Record the timestamp for server AEC */
         if (task->timestamp > 0) {
@@ -297,7 +331,7 @@ void AudioService::OpusCodecTask() {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
         audio_queue_cv_.wait(lock, [this]() {
             return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
+                !audio_encode_queue_.empty() ||
                 (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
         });
         if (service_stopped_) {
@@ -314,6 +348,8 @@ void AudioService::OpusCodecTask() {
             auto task = std::make_unique<AudioTask>();
             task->type = kAudioTaskTypeDecodeToPlaybackQueue;
             task->timestamp = packet->timestamp;
+            task->stream_position_ms = packet->stream_position_ms;
+            task->stream_turn = packet->stream_turn;
 
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
             if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
@@ -336,7 +372,7 @@ void AudioService::OpusCodecTask() {
         }
         
         /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
+        if (!audio_encode_queue_.empty()) {
             auto task = std::move(audio_encode_queue_.front());
             audio_encode_queue_.pop_front();
             audio_queue_cv_.notify_all();
@@ -346,6 +382,8 @@ void AudioService::OpusCodecTask() {
             packet->frame_duration = OPUS_FRAME_DURATION_MS;
             packet->sample_rate = 16000;
             packet->timestamp = task->timestamp;
+            packet->gap_start_ms = task->gap_start_ms;
+            packet->gap_ms = task->gap_ms;
             if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
                 ESP_LOGE(TAG, "Failed to encode audio");
                 continue;
@@ -354,7 +392,21 @@ void AudioService::OpusCodecTask() {
             if (task->type == kAudioTaskTypeEncodeToSendQueue) {
                 {
                     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
+                    uint32_t start_ms = packet->gap_ms > 0 ? packet->gap_start_ms + packet->gap_ms : send_stream_end_ms_;
+                    send_stream_end_ms_ = start_ms + packet->frame_duration;
+                    // With the voice gate on, frames refused before this one join its gap
+                    if (send_gap_pending_ && voice_gate_active_) {
+                        packet->gap_start_ms = send_gap_start_ms_;
+                        packet->gap_ms = start_ms - send_gap_start_ms_;
+                    }
+                    // The uplink stalled beyond the handshake budget, keep the start of the utterance
+                    uint32_t gap_start_ms = packet->gap_ms > 0 ? packet->gap_start_ms : start_ms;
+                    if (audio_send_queue_.Push(std::move(packet))) {
+                        send_gap_pending_ = false;
+                    } else if (!send_gap_pending_) {
+                        send_gap_pending_ = true;
+                        send_gap_start_ms_ = gap_start_ms;
+                    }
                 }
                 if (callbacks_.on_send_queue_available) {
                     callbacks_.on_send_queue_available();
@@ -386,10 +438,12 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     }
 }
 
-void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
+void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm, uint32_t gap_start_ms, uint32_t gap_ms) {
     auto task = std::make_unique<AudioTask>();
     task->type = type;
     task->pcm = std::move(pcm);
+    task->gap_start_ms = gap_start_ms;
+    task->gap_ms = gap_ms;
     
     /* Push the task to the encode queue */
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
@@ -423,13 +477,17 @@ bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> pa
     return true;
 }
 
+size_t AudioService::TakeSendDroppedCount() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    return audio_send_queue_.TakeDroppedCount();
+}
+
 std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     if (audio_send_queue_.empty()) {
         return nullptr;
     }
-    auto packet = std::move(audio_send_queue_.front());
-    audio_send_queue_.pop_front();
+    auto packet = audio_send_queue_.Pop();
     audio_queue_cv_.notify_all();
     return packet;
 }
@@ -474,7 +532,7 @@ void AudioService::EnableWakeWordDetection(bool enable) {
     }
 }
 
-void AudioService::EnableVoiceProcessing(bool enable) {
+void AudioService::EnableVoiceProcessing(bool enable, bool warmup) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
         if (!audio_processor_initialized_) {
@@ -482,9 +540,22 @@ void AudioService::EnableVoiceProcessing(bool enable) {
             audio_processor_initialized_ = true;
         }
 
-        /* We should make sure no audio is playing */
+        /* We should make sure no audio is playing, and drop what an earlier session left unsent */
         ResetDecoder();
-        audio_input_need_warmup_ = true;
+        {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            audio_encode_queue_.clear();
+            audio_send_queue_.clear();
+            send_stream_end_ms_ = 0;
+            send_gap_pending_ = false;
+            voice_gate_active_ = voice_gate_ && voice_gate_enabled_;
+            audio_queue_cv_.notify_all();
+        }
+        audio_input_need_warmup_ = warmup;
+        /* The processor is stopped, so the gate can be reset without racing its output */
+        if (voice_gate_) {
+            voice_gate_->Reset();
+        }
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
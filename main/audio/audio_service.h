@@ -20,6 +20,9 @@
 #include "audio_codec.h"
 #include "audio_processor.h"
 #include "processors/audio_debugger.h"
+#include "processors/mic_array_front_end.h"
+#include "processors/voice_gate.h"
+#include "drop_newest_queue.h"
 #include "wake_word.h"
 #include "protocol.h"
 
@@ -39,7 +42,8 @@
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
 #define MAX_PLAYBACK_TASKS_IN_QUEUE 2
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
-#define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+// Covers the audio channel handshake, which waits up to 10 s for the server hello
+#define MAX_SEND_PACKETS_IN_QUEUE (10000 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
 
@@ -57,6 +61,7 @@ struct AudioServiceCallbacks {
     std::function<void(const std::string&)> on_wake_word_detected;
     std::function<void(bool)> on_vad_change;
     std::function<void(void)> on_audio_testing_queue_full;
+    std::function<void(uint32_t turn, uint32_t position_ms)> on_playback_position;
 };
 
 
@@ -70,6 +75,10 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    uint32_t gap_start_ms = 0;
+    uint32_t gap_ms = 0;
+    uint32_t stream_position_ms = 0;
+    uint32_t stream_turn = 0;
 };
 
 struct DebugStatistics {
@@ -97,14 +106,19 @@ public:
     bool IsAfeWakeWord();
 
     void EnableWakeWordDetection(bool enable);
-    void EnableVoiceProcessing(bool enable);
+    // warmup drops the first reads after enabling, which is only needed when the input was idle
+    void EnableVoiceProcessing(bool enable, bool warmup = true);
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
+    // Drop silent frames instead of uploading them, takes effect with the next voice processing start
+    void EnableVoiceGate(bool enable) { voice_gate_enabled_ = enable; }
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    // Packets the full send queue refused since the previous call
+    size_t TakeSendDroppedCount();
     void PlaySound(const std::string_view& sound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
@@ -116,10 +130,13 @@ private:
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
+    std::unique_ptr<MicArrayFrontEnd> mic_array_;
+    std::unique_ptr<VoiceGate> voice_gate_;
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
+    std::vector<std::unique_ptr<OpusResampler>> extra_mic_resamplers_;
     OpusResampler output_resampler_;
     DebugStatistics debug_statistics_;
     srmodel_list_t* models_list_ = nullptr;
@@ -133,7 +150,14 @@ private:
     std::mutex audio_queue_mutex_;
     std::condition_variable audio_queue_cv_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
+    // Bounded by refusing the newest packet, so the encoder never waits on the uplink and the
+    // start of the utterance survives a slow handshake
+    DropNewestQueue<std::unique_ptr<AudioStreamPacket>> audio_send_queue_{MAX_SEND_PACKETS_IN_QUEUE};
+    // Stream time where the next packet starts, and where the frames refused since the last
+    // queued packet began, so they reach the server as a gap of the voice gate timeline
+    uint32_t send_stream_end_ms_ = 0;
+    bool send_gap_pending_ = false;
+    uint32_t send_gap_start_ms_ = 0;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
@@ -145,6 +169,8 @@ private:
     bool voice_detected_ = false;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
+    bool voice_gate_enabled_ = false;
+    bool voice_gate_active_ = false;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
     std::chrono::steady_clock::time_point last_input_time_;
@@ -153,7 +179,7 @@ private:
     void AudioInputTask();
     void AudioOutputTask();
     void OpusCodecTask();
-    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm, uint32_t gap_start_ms = 0, uint32_t gap_ms = 0);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
 };
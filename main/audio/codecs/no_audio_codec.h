@@ -10,6 +10,11 @@
 class NoAudioCodec : public AudioCodec {
 protected:
     std::mutex data_if_mutex_;
+    // 32-bit slot scratch, one DMA frame each so Read and Write never allocate
+    int32_t tx_buffer_[AUDIO_CODEC_DMA_FRAME_NUM];
+    int32_t rx_buffer_[AUDIO_CODEC_DMA_FRAME_NUM];
+    // Q16 gain applied to the last written sample, ramped towards the volume setting
+    int32_t output_gain_ = 0;
 
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
@@ -0,0 +1,72 @@
+#include "pcm_ops.h"
+
+static inline int16_t clamp16(int32_t value) {
+    return value > INT16_MAX ? INT16_MAX : value < -INT16_MAX ? -INT16_MAX : (int16_t)value;
+}
+
+int32_t pcm_volume_to_gain(int volume) {
+    if (volume <= 0) {
+        return 0;
+    }
+    if (volume >= 100) {
+        return 65536;
+    }
+    // (volume / 100)^2 * 65536 without floating point
+    return volume * volume * 65536 / 10000;
+}
+
+void pcm_widen_gain(int32_t* dst, const int16_t* src, size_t count, int32_t gain_from, int32_t gain_to) {
+    size_t i = 0;
+    if (gain_from != gain_to && count > 0) {
+        // Ramp in Q8 above the gain so short buffers still take small steps
+        int32_t step = ((gain_to - gain_from) * 256) / (int32_t)count;
+        int32_t gain = gain_from * 256;
+        for (; i < count; i++) {
+            dst[i] = src[i] * (gain >> 8);
+            gain += step;
+        }
+        return;
+    }
+
+    int32_t gain = gain_to;
+    for (; i + 4 <= count; i += 4) {
+        int32_t s0 = src[i], s1 = src[i + 1], s2 = src[i + 2], s3 = src[i + 3];
+        dst[i] = s0 * gain;
+        dst[i + 1] = s1 * gain;
+        dst[i + 2] = s2 * gain;
+        dst[i + 3] = s3 * gain;
+    }
+    for (; i < count; i++) {
+        dst[i] = src[i] * gain;
+    }
+}
+
+void pcm_narrow(int16_t* dst, const int32_t* src, size_t count, int shift) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32_t s0 = src[i] >> shift, s1 = src[i + 1] >> shift;
+        int32_t s2 = src[i + 2] >> shift, s3 = src[i + 3] >> shift;
+        dst[i] = clamp16(s0);
+        dst[i + 1] = clamp16(s1);
+        dst[i + 2] = clamp16(s2);
+        dst[i + 3] = clamp16(s3);
+    }
+    for (; i < count; i++) {
+        dst[i] = clamp16(src[i] >> shift);
+    }
+}
+
+void pcm_gain16(int16_t* samples, size_t count, int gain) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32_t s0 = samples[i] * gain, s1 = samples[i + 1] * gain;
+        int32_t s2 = samples[i + 2] * gain, s3 = samples[i + 3] * gain;
+        samples[i] = clamp16(s0);
+        samples[i + 1] = clamp16(s1);
+        samples[i + 2] = clamp16(s2);
+        samples[i + 3] = clamp16(s3);
+    }
+    for (; i < count; i++) {
+        samples[i] = clamp16(samples[i] * gain);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Small PCM kernels shared by the I2S codecs that have no hardware volume or gain.
+// Gains are Q16 fixed point, 65536 is unity. Loops are unrolled by four samples.
+
+// Q16 output gain for a 0-100 volume, following the same square law as the old float code
+int32_t pcm_volume_to_gain(int volume);
+
+// Widen 16-bit samples to the high bits of 32-bit I2S slots while applying a gain that
+// moves linearly from gain_from to gain_to over the buffer. Gains must be 0-65536,
+// which keeps every product inside int32 so no clamping is needed.
+void pcm_widen_gain(int32_t* dst, const int16_t* src, size_t count, int32_t gain_from, int32_t gain_to);
+
+// Narrow 32-bit I2S slots to 16-bit samples by an arithmetic right shift, clamping to +-INT16_MAX
+void pcm_narrow(int16_t* dst, const int32_t* src, size_t count, int shift);
+
+// Multiply 16-bit samples in place by an integer gain, clamping to +-INT16_MAX
+void pcm_gain16(int16_t* samples, size_t count, int gain);
@@ -0,0 +1,55 @@
+#ifndef DROP_NEWEST_QUEUE_H
+#define DROP_NEWEST_QUEUE_H
+
+#include <deque>
+#include <cstddef>
+#include <utility>
+
+/*
+ * FIFO with a fixed capacity whose Push never waits: when it is full the new item is
+ * refused and counted, so what is already queued, e.g. the start of an utterance held
+ * while the audio channel opens, is kept. The producer keeps the refused item.
+ *
+ * Not thread safe, callers hold their own lock.
+ */
+template <typename T>
+class DropNewestQueue {
+public:
+    explicit DropNewestQueue(size_t capacity) : capacity_(capacity) {}
+
+    // Returns false when the queue is full, item is left untouched then
+    bool Push(T&& item) {
+        if (items_.size() >= capacity_) {
+            dropped_++;
+            return false;
+        }
+        items_.push_back(std::move(item));
+        return true;
+    }
+
+    T Pop() {
+        T item = std::move(items_.front());
+        items_.pop_front();
+        return item;
+    }
+
+    T& front() { return items_.front(); }
+    bool empty() const { return items_.empty(); }
+    size_t size() const { return items_.size(); }
+    size_t capacity() const { return capacity_; }
+    void clear() { items_.clear(); }
+
+    // Items refused since the last call
+    size_t TakeDroppedCount() {
+        size_t dropped = dropped_;
+        dropped_ = 0;
+        return dropped;
+    }
+
+private:
+    size_t capacity_;
+    size_t dropped_ = 0;
+    std::deque<T> items_;
+};
+
+#endif // DROP_NEWEST_QUEUE_H
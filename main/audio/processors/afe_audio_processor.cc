@@ -1,5 +1,7 @@
 #include "afe_audio_processor.h"
+#include "task_registry.h"
 #include <esp_log.h>
+#include <algorithm>
 
 #define PROCESSOR_RUNNING 0x01
 
@@ -19,8 +21,14 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
 
     int ref_num = codec_->input_reference() ? 1 : 0;
 
+    int mic_num = codec_->input_channels() - ref_num;
+#if CONFIG_USE_MIC_ARRAY_BEAMFORMING
+    // AudioService sums the microphone array into a single beam before feeding us
+    mic_num = std::min(mic_num, 1);
+#endif
+
     std::string input_format;
-    for (int i = 0; i < codec_->input_channels() - ref_num; i++) {
+    for (int i = 0; i < mic_num; i++) {
         input_format.push_back('M');
     }
     for (int i = 0; i < ref_num; i++) {
@@ -67,11 +75,11 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
     afe_iface_ = esp_afe_handle_from_config(afe_config);
     afe_data_ = afe_iface_->create_from_config(afe_config);
     
-    xTaskCreate([](void* arg) {
+    TaskRegistry::Create(kTaskAudioCommunication, [](void* arg) {
         auto this_ = (AfeAudioProcessor*)arg;
         this_->AudioProcessorTask();
         vTaskDelete(NULL);
-    }, "audio_communication", 4096, this, 3, NULL);
+    }, this);
 }
 
 AfeAudioProcessor::~AfeAudioProcessor() {
@@ -0,0 +1,145 @@
+#include "mic_array_front_end.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define TAG "MicArrayFrontEnd"
+
+// Speed of sound in mm per second
+#define SPEED_OF_SOUND_MM_S 343000
+// Frames a new direction has to win in a row before it is reported
+#define DIRECTION_HOLD_FRAMES 3
+
+MicArrayFrontEnd::MicArrayFrontEnd(int mic_channels, bool has_reference, int mic_spacing_mm, int sample_rate)
+    : mics_(std::clamp(mic_channels, 1, kMaxMics)), has_reference_(has_reference) {
+    channels_ = mics_ + (has_reference_ ? 1 : 0);
+    mix_gain_ = 65536 / mics_;
+
+    // Delay every microphone so a plane wave from the preset angle lines up across the array
+    for (int p = 0; p < kPresetCount; p++) {
+        double step = mic_spacing_mm * std::sin(kPresetAngles[p] * M_PI / 180.0) * sample_rate / SPEED_OF_SOUND_MM_S;
+        int min_delay = 0;
+        for (int m = 0; m < mics_; m++) {
+            delays_[p][m] = (int)std::lround(m * step);
+            min_delay = std::min(min_delay, delays_[p][m]);
+        }
+        for (int m = 0; m < mics_; m++) {
+            delays_[p][m] = std::min(delays_[p][m] - min_delay, kMaxDelay);
+        }
+    }
+    ESP_LOGI(TAG, "%d mics, %d mm apart, largest steering delay %d samples",
+        mics_, mic_spacing_mm, delays_[kPresetCount - 1][mics_ - 1]);
+}
+
+void MicArrayFrontEnd::SetSteering(int preset) {
+    steering_ = (preset >= 0 && preset < kPresetCount) ? preset : -1;
+}
+
+bool MicArrayFrontEnd::Process(std::vector<int16_t>& data) {
+    if (data.size() % channels_ != 0) {
+        return false;
+    }
+    int frames = data.size() / channels_;
+    if (history_ < kMaxDelay + frames) {
+        history_ = kMaxDelay + frames;
+        for (int m = 0; m < mics_; m++) {
+            mic_buffers_[m].resize(history_);
+        }
+    }
+
+    // Split the microphones behind the samples kept from the previous call
+    for (int m = 0; m < mics_; m++) {
+        int16_t* dst = mic_buffers_[m].data() + kMaxDelay;
+        const int16_t* src = data.data() + m;
+        for (int n = 0; n < frames; n++) {
+            dst[n] = src[n * channels_];
+        }
+    }
+
+    uint64_t energies[kPresetCount];
+    for (int p = 0; p < kPresetCount; p++) {
+        energies[p] = BeamEnergy(p, frames);
+    }
+    UpdateDirection(energies);
+
+    // Sum the steered beam, the reference (if any) moves down next to it
+    int beam = steering_ >= 0 ? steering_ : direction_.load();
+    const int16_t* taps[kMaxMics];
+    for (int m = 0; m < mics_; m++) {
+        taps[m] = mic_buffers_[m].data() + kMaxDelay - delays_[beam][m];
+    }
+    int out_channels = output_channels();
+    for (int n = 0; n < frames; n++) {
+        int32_t sum = 0;
+        for (int m = 0; m < mics_; m++) {
+            sum += taps[m][n];
+        }
+        int16_t reference = has_reference_ ? data[n * channels_ + mics_] : 0;
+        data[n * out_channels] = (int16_t)((sum * mix_gain_) >> 16);
+        if (has_reference_) {
+            data[n * out_channels + 1] = reference;
+        }
+    }
+    data.resize(frames * out_channels);
+
+    for (int m = 0; m < mics_; m++) {
+        int16_t* buffer = mic_buffers_[m].data();
+        memmove(buffer, buffer + frames, kMaxDelay * sizeof(int16_t));
+    }
+    return true;
+}
+
+uint64_t MicArrayFrontEnd::BeamEnergy(int preset, int frames) const {
+    const int16_t* taps[kMaxMics];
+    for (int m = 0; m < mics_; m++) {
+        taps[m] = mic_buffers_[m].data() + kMaxDelay - delays_[preset][m];
+    }
+    uint64_t energy = 0;
+    for (int n = 0; n < frames; n++) {
+        int32_t sum = 0;
+        for (int m = 0; m < mics_; m++) {
+            sum += taps[m][n];
+        }
+        energy += (int64_t)sum * sum;
+    }
+    return energy;
+}
+
+void MicArrayFrontEnd::UpdateDirection(const uint64_t* energies) {
+    uint64_t best = 0, total = 0;
+    int best_preset = direction_.load();
+    for (int p = 0; p < kPresetCount; p++) {
+        total += energies[p];
+        if (energies[p] > best) {
+            best = energies[p];
+            best_preset = p;
+        }
+    }
+    uint64_t mean = total / kPresetCount;
+    if (mean == 0) {
+        return;
+    }
+
+    // The background level falls at once and creeps up slowly, so speech stands out of it
+    if (noise_floor_ == 0 || mean < noise_floor_) {
+        noise_floor_ = mean;
+    } else {
+        noise_floor_ += (mean - noise_floor_) >> 6;
+    }
+
+    // Only loud frames with one clearly stronger beam can move the estimate
+    if (mean < noise_floor_ * 2 || best * 8 < mean * 9) {
+        candidate_frames_ = 0;
+        return;
+    }
+    if (best_preset != candidate_) {
+        candidate_ = best_preset;
+        candidate_frames_ = 0;
+    }
+    if (++candidate_frames_ >= DIRECTION_HOLD_FRAMES && candidate_ != direction_) {
+        direction_ = candidate_;
+        ESP_LOGI(TAG, "Voice direction: %d degrees", kPresetAngles[candidate_]);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef MIC_ARRAY_FRONT_END_H
+#define MIC_ARRAY_FRONT_END_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Delay-and-sum beamformer for boards with a linear array of 2 to 4 microphones.
+ * It runs between AudioService::ReadAudioData and AudioProcessor::Feed, turning the
+ * interleaved [mic0 .. micN-1, (ref)] frames into [beam, (ref)] frames so the AFE only
+ * has to clean up a single, already focused channel.
+ *
+ * The beam is steered to one of a few fixed presets. In tracking mode every preset is
+ * evaluated each frame and the one with the most speech energy becomes the direction of
+ * arrival, which is also what steers the beam.
+ */
+class MicArrayFrontEnd {
+public:
+    static constexpr int kPresetCount = 5;
+    static constexpr int kPresetAngles[kPresetCount] = { -60, -30, 0, 30, 60 };
+    static constexpr int kMaxMics = 4;
+    static constexpr int kMaxDelay = 32;
+
+    MicArrayFrontEnd(int mic_channels, bool has_reference, int mic_spacing_mm, int sample_rate);
+
+    // Collapse data in place, returns false if the layout does not match
+    bool Process(std::vector<int16_t>& data);
+
+    // Steer to a fixed preset, or track the speaker with -1 (the default)
+    void SetSteering(int preset);
+    // Direction of arrival in degrees, 0 is broadside to the array. Safe to call from any task.
+    int GetDirection() const { return kPresetAngles[direction_.load()]; }
+
+    int output_channels() const { return has_reference_ ? 2 : 1; }
+
+private:
+    int mics_;
+    bool has_reference_;
+    int channels_;
+    int32_t mix_gain_;
+    int delays_[kPresetCount][kMaxMics];
+    std::vector<int16_t> mic_buffers_[kMaxMics];
+    int history_ = 0;
+
+    int steering_ = -1;
+    std::atomic<int> direction_ = kPresetCount / 2;
+    int candidate_ = kPresetCount / 2;
+    int candidate_frames_ = 0;
+    uint64_t noise_floor_ = 0;
+
+    uint64_t BeamEnergy(int preset, int frames) const;
+    void UpdateDirection(const uint64_t* energies);
+};
+
+#endif // MIC_ARRAY_FRONT_END_H
@@ -0,0 +1,106 @@
+#include "voice_gate.h"
+
+#include <esp_log.h>
+#include <cstdlib>
+
+#define TAG "VoiceGate"
+
+// Mean absolute sample level a frame must exceed the noise floor by (x2 is 6 dB)
+#define VOICE_GATE_SNR_RATIO 2
+// Below this mean level a frame is never speech, whatever the floor
+#define VOICE_GATE_MIN_LEVEL 64
+#define VOICE_GATE_INITIAL_FLOOR 128
+
+VoiceGate::VoiceGate(int frame_duration_ms, int hangover_ms, int preroll_ms)
+    : frame_duration_ms_(frame_duration_ms),
+      hangover_frames_((hangover_ms + frame_duration_ms - 1) / frame_duration_ms),
+      preroll_frames_(preroll_ms / frame_duration_ms),
+      noise_floor_(VOICE_GATE_INITIAL_FLOOR) {
+}
+
+void VoiceGate::OnOutput(std::function<void(std::vector<int16_t>&& data, uint32_t gap_start_ms, uint32_t gap_ms)> callback) {
+    output_callback_ = callback;
+}
+
+void VoiceGate::Reset() {
+    if (frame_index_ > 0) {
+        ESP_LOGI(TAG, "Sent %lu frames, dropped %lu frames (%lu ms) of silence",
+            sent_frames_, dropped_frames_, dropped_frames_ * frame_duration_ms_);
+    }
+    open_ = false;
+    hangover_left_ = 0;
+    frame_index_ = 0;
+    gap_frames_ = 0;
+    sent_frames_ = 0;
+    dropped_frames_ = 0;
+    preroll_.clear();
+}
+
+bool VoiceGate::IsSpeech(const std::vector<int16_t>& data) {
+    if (data.empty()) {
+        return false;
+    }
+    uint32_t sum = 0;
+    for (auto sample : data) {
+        sum += std::abs(sample);
+    }
+    uint32_t level = sum / data.size();
+
+    // The floor drops to quiet frames at once and creeps up under louder ones
+    if (level < noise_floor_) {
+        noise_floor_ = level > 1 ? level : 1;
+    } else {
+        noise_floor_ += (level - noise_floor_) / 64;
+    }
+    return level >= VOICE_GATE_MIN_LEVEL && level > noise_floor_ * VOICE_GATE_SNR_RATIO;
+}
+
+void VoiceGate::Process(std::vector<int16_t>&& data, bool vad_speaking) {
+    bool speech = IsSpeech(data) || vad_speaking;
+    uint32_t index = frame_index_++;
+    if (!output_callback_) {
+        return;
+    }
+
+    if (speech) {
+        hangover_left_ = hangover_frames_;
+    }
+
+    if (open_) {
+        sent_frames_++;
+        output_callback_(std::move(data), 0, 0);
+        if (!speech && --hangover_left_ <= 0) {
+            open_ = false;
+            gap_frames_ = 0;
+        }
+        return;
+    }
+
+    if (!speech) {
+        // Hold the frame as pre-roll, the oldest one falls out into the gap
+        preroll_.push_back(std::move(data));
+        if (preroll_.size() > preroll_frames_) {
+            if (gap_frames_ == 0) {
+                gap_start_frame_ = index - preroll_frames_;
+            }
+            gap_frames_++;
+            dropped_frames_++;
+            preroll_.pop_front();
+        }
+        return;
+    }
+
+    open_ = true;
+    uint32_t gap_start_ms = gap_start_frame_ * frame_duration_ms_;
+    uint32_t gap_ms = gap_frames_ * frame_duration_ms_;
+    while (!preroll_.empty()) {
+        sent_frames_++;
+        output_callback_(std::move(preroll_.front()), gap_start_ms, gap_ms);
+        preroll_.pop_front();
+        gap_ms = 0;
+        gap_start_ms = 0;
+    }
+    sent_frames_++;
+    output_callback_(std::move(data), gap_start_ms, gap_ms);
+    gap_frames_ = 0;
+}
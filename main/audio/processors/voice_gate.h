@@ -0,0 +1,48 @@
+#ifndef VOICE_GATE_H
+#define VOICE_GATE_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+/*
+ * Energy gate that sits behind the audio processor and drops frames holding only
+ * background noise, so they are neither encoded nor uploaded.
+ *
+ * A frame is speech when its level stands well above the tracked noise floor, or when
+ * the AFE VAD says so. The gate stays open for a hangover after the last speech frame,
+ * and keeps a short pre-roll of silent frames that is sent ahead of the speech that
+ * reopens it, so word onsets are not clipped.
+ */
+class VoiceGate {
+public:
+    VoiceGate(int frame_duration_ms, int hangover_ms, int preroll_ms);
+
+    // Start a new listening session, the noise floor is kept
+    void Reset();
+    void Process(std::vector<int16_t>&& data, bool vad_speaking);
+    // gap_ms is the silence dropped right before this frame, which started gap_start_ms
+    // after the session began. Both are 0 for frames that follow their predecessor.
+    void OnOutput(std::function<void(std::vector<int16_t>&& data, uint32_t gap_start_ms, uint32_t gap_ms)> callback);
+
+private:
+    int frame_duration_ms_;
+    int hangover_frames_;
+    size_t preroll_frames_;
+    std::function<void(std::vector<int16_t>&& data, uint32_t gap_start_ms, uint32_t gap_ms)> output_callback_;
+
+    bool open_ = false;
+    int hangover_left_ = 0;
+    uint32_t frame_index_ = 0;
+    uint32_t gap_start_frame_ = 0;
+    uint32_t gap_frames_ = 0;
+    uint32_t sent_frames_ = 0;
+    uint32_t dropped_frames_ = 0;
+    uint32_t noise_floor_;
+    std::deque<std::vector<int16_t>> preroll_;
+
+    bool IsSpeech(const std::vector<int16_t>& data);
+};
+
+#endif // VOICE_GATE_H
@@ -1,5 +1,6 @@
 #include "custom_wake_word.h"
 #include "audio_service.h"
+#include "memory_arena.h"
 #include "system_info.h"
 #include "assets.h"
 
@@ -24,7 +25,7 @@ CustomWakeWord::~CustomWakeWord() {
     }
 
     if (wake_word_encode_task_stack_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_stack_);
+        MemoryArena::Free(kMemoryWakeWord, wake_word_encode_task_stack_);
     }
 
     if (wake_word_encode_task_buffer_ != nullptr) {
@@ -148,10 +149,11 @@ void CustomWakeWord::Feed(const std::vector<int16_t>& data) {
     }
 
     esp_mn_state_t mn_state;
-    // If input channels is 2, we need to fetch the left channel data
-    if (codec_->input_channels() == 2) {
-        auto mono_data = std::vector<int16_t>(data.size() / 2);
-        for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
+    // With several input channels, we only keep the first microphone
+    int channels = codec_->input_channels();
+    if (channels > 1) {
+        auto mono_data = std::vector<int16_t>(data.size() / channels);
+        for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += channels) {
             mono_data[i] = data[j];
         }
 
@@ -206,7 +208,7 @@ void CustomWakeWord::EncodeWakeWordData() {
     const size_t stack_size = 4096 * 7;
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
-        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
+        wake_word_encode_task_stack_ = (StackType_t*)MemoryArena::Allocate(kMemoryWakeWord, stack_size);
         assert(wake_word_encode_task_stack_ != nullptr);
     }
     if (wake_word_encode_task_buffer_ == nullptr) {
@@ -21,6 +21,7 @@
 #include "power_save_timer.h"
 #include "system_reset.h"
 #include "wifi_board.h"
+#include "settings.h"
 
 #define TAG "AIPI-Lite"
 
@@ -56,6 +57,7 @@ class AIPILite : public WifiBoard {
             GetBacklight()->RestoreBrightness();
         });
         power_save_timer_->OnShutdownRequest([this]() {
+            Settings::Flush();
             ESP_LOGI(TAG, "Shutting down");
             esp_lcd_panel_disp_on_off(panel_, false);  // 关闭显示
             rtc_gpio_set_level(POWER_CONTROL_PIN, 0);
@@ -164,6 +166,7 @@ class AIPILite : public WifiBoard {
                 !(power_manager_->IsCharging() &&
                   power_manager_->GetBatteryLevel() < 100)) {
                 ESP_LOGI(TAG, "Power button long pressed, shutting down");
+                Settings::Flush();
                 esp_lcd_panel_disp_on_off(panel_, false);  // 关闭显示
                 rtc_gpio_set_level(POWER_CONTROL_PIN, 0);
                 rtc_gpio_hold_dis(POWER_CONTROL_PIN);
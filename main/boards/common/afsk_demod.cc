@@ -1,5 +1,7 @@
 #include "afsk_demod.h"
 #include <cstring>
+#include <cmath>
+#include <cstdlib>
 #include <algorithm>
 #include "esp_log.h"
 #include "display.h"
@@ -11,6 +13,8 @@
 namespace audio_wifi_config
 {
     static const char *kLogTag = "AUDIO_WIFI_CONFIG";
+    // Contrast margin (Q8) a new decision point needs over the current one
+    static const int16_t kDecisionHysteresis = 32;
 
     void ReceiveWifiCredentialsFromAudio(Application *app,
                                         WifiConfigurationAp *wifi_ap,
@@ -19,10 +23,13 @@ namespace audio_wifi_config
                                     )
     {
         const int kInputSampleRate = 16000;                                    // Input sampling rate
-        const float kDownsampleStep = static_cast<float>(kInputSampleRate) / static_cast<float>(kAudioSampleRate); // Downsampling step
         std::vector<int16_t> audio_data;
+        std::vector<float> probabilities;
+        probabilities.reserve(16);
         AudioSignalProcessor signal_processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize);
         AudioDataBuffer data_buffer;
+        // Downsampling phase, one sample is kept every time it wraps around kInputSampleRate
+        size_t downsample_phase = 0;
 
         while (true)
         {
@@ -40,37 +47,20 @@ namespace audio_wifi_config
                 continue;
             }
 
-            if (input_channels == 2) { // 如果是双声道输入，转换为单声道
-                auto mono_data = std::vector<int16_t>(audio_data.size() / 2);
-                for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                    mono_data[i] = audio_data[j];
+            // Downsample the first channel and feed it to the demodulator sample by sample
+            probabilities.clear();
+            for (size_t i = 0; i < audio_data.size(); i += input_channels) {
+                downsample_phase += kAudioSampleRate;
+                if (downsample_phase < kInputSampleRate) {
+                    continue;
                 }
-                audio_data = std::move(mono_data);
-            }
-            
-            // Downsample the audio data
-            std::vector<float> downsampled_data;
-            size_t last_index = 0;
-
-            if (kDownsampleStep > 1.0f) {
-                downsampled_data.reserve(audio_data.size() / static_cast<size_t>(kDownsampleStep));
-                for (size_t i = 0; i < audio_data.size(); ++i) {
-                    size_t sample_index = static_cast<size_t>(i / kDownsampleStep);
-                    if ((sample_index + 1) > last_index) {
-                        downsampled_data.push_back(static_cast<float>(audio_data[i]));
-                        last_index = sample_index + 1;
-                    }
-                }
-            } else {
-                downsampled_data.reserve(audio_data.size());
-                for (int16_t sample : audio_data) {
-                    downsampled_data.push_back(static_cast<float>(sample));
+                downsample_phase -= kInputSampleRate;
+                float probability;
+                if (signal_processor.ProcessSample(audio_data[i], probability)) {
+                    probabilities.push_back(probability);
                 }
             }
             
-            // Process audio samples to get probability data
-            auto probabilities = signal_processor.ProcessAudioSamples(downsampled_data);
-            
             // Feed probability data to the data buffer
             if (data_buffer.ProcessProbabilityData(probabilities, 0.5f)) {
                 // If complete data was received, extract WiFi credentials
@@ -113,109 +103,102 @@ namespace audio_wifi_config
         0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0};
 
     // FrequencyDetector implementation
-    FrequencyDetector::FrequencyDetector(float frequency, size_t window_size)
-        : frequency_(frequency), window_size_(window_size) {
-        frequency_bin_ = std::floor(frequency_ * static_cast<float>(window_size_));
-        angular_frequency_ = 2.0f * M_PI * frequency_;
-        cos_coefficient_ = std::cos(angular_frequency_);
-        sin_coefficient_ = std::sin(angular_frequency_);
-        filter_coefficient_ = 2.0f * cos_coefficient_;
-
-        // Initialize state buffer
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
+    FrequencyDetector::FrequencyDetector(size_t bin, size_t window_size)
+        : bin_(bin), window_size_(std::min(window_size, kMaxWindowSize)) {
+        for (size_t i = 0; i < window_size_; ++i) {
+            float angle = 2.0f * static_cast<float>(M_PI) * i / window_size_;
+            cos_table_[i] = static_cast<int16_t>(std::lround(std::cos(angle) * 32767.0f));
+            sin_table_[i] = static_cast<int16_t>(std::lround(std::sin(angle) * 32767.0f));
+        }
+        Reset();
     }
 
     void FrequencyDetector::Reset() {
-        state_buffer_.clear();
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
+        phase_ = 0;
+        real_ = 0;
+        imaginary_ = 0;
     }
 
-    void FrequencyDetector::ProcessSample(float sample) {
-        if (state_buffer_.size() < 2) {
-            return;
+    void FrequencyDetector::ProcessSample(int16_t sample, int16_t oldest) {
+        // The oldest sample entered the window exactly window_size_ samples ago, so its
+        // twiddle index bin * (n - window_size) mod window_size is the same as the new one
+        int32_t c = cos_table_[phase_];
+        int32_t s = sin_table_[phase_];
+        real_ += ((sample * c) >> 15) - ((oldest * c) >> 15);
+        imaginary_ -= ((sample * s) >> 15) - ((oldest * s) >> 15);
+
+        phase_ += bin_;
+        if (phase_ >= window_size_) {
+            phase_ -= window_size_;
         }
-
-        float s_minus_2 = state_buffer_.front();  // S[-2]
-        state_buffer_.pop_front();
-        float s_minus_1 = state_buffer_.front();  // S[-1]
-        state_buffer_.pop_front();
-
-        float s_current = sample + filter_coefficient_ * s_minus_1 - s_minus_2;
-
-        state_buffer_.push_back(s_minus_1);  // Put S[-1] back
-        state_buffer_.push_back(s_current);  // Add new S[0]
     }
 
-    float FrequencyDetector::GetAmplitude() const {
-        if (state_buffer_.size() < 2) {
-            return 0.0f;
-        }
-
-        float s_minus_1 = state_buffer_[1];                      // S[-1]
-        float s_minus_2 = state_buffer_[0];                      // S[-2]
-        float real_part = cos_coefficient_ * s_minus_1 - s_minus_2;  // Real part
-        float imaginary_part = sin_coefficient_ * s_minus_1;         // Imaginary part
-
-        return std::sqrt(real_part * real_part + imaginary_part * imaginary_part) / 
-               (static_cast<float>(window_size_) / 2.0f);
+    uint32_t FrequencyDetector::GetMagnitude() const {
+        // Alpha max plus beta min: max + 3/8 min, within 7% of the true magnitude
+        uint32_t a = std::abs(real_);
+        uint32_t b = std::abs(imaginary_);
+        return a > b ? a + (b * 3 >> 3) : b + (a * 3 >> 3);
     }
 
     // AudioSignalProcessor implementation
     AudioSignalProcessor::AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
                                              size_t bit_rate, size_t window_size)
-        : input_buffer_size_(window_size), output_sample_count_(0) {
+        : window_size_(std::min(window_size, kMaxWindowSize)), window_position_(0), bit_phase_(0), decision_phase_(0),
+          mark_detector_(mark_frequency * window_size_ / sample_rate, window_size_),
+          space_detector_(space_frequency * window_size_ / sample_rate, window_size_) {
         if (sample_rate % bit_rate != 0) {
             // On ESP32 we can continue execution, but log the error
             ESP_LOGW(kLogTag, "Sample rate %zu is not divisible by bit rate %zu", sample_rate, bit_rate);
         }
+        if ((mark_frequency * window_size_) % sample_rate != 0 || (space_frequency * window_size_) % sample_rate != 0) {
+            ESP_LOGW(kLogTag, "Tones %zu/%zu Hz are not on DFT bins of a %zu sample window",
+                     mark_frequency, space_frequency, window_size_);
+        }
 
-        float normalized_mark_freq = static_cast<float>(mark_frequency) / static_cast<float>(sample_rate);
-        float normalized_space_freq = static_cast<float>(space_frequency) / static_cast<float>(sample_rate);
-
-        mark_detector_ = std::make_unique<FrequencyDetector>(normalized_mark_freq, window_size);
-        space_detector_ = std::make_unique<FrequencyDetector>(normalized_space_freq, window_size);
-
-        samples_per_bit_ = sample_rate / bit_rate;  // Number of samples per bit
+        window_.fill(0);
+        window_fill_ = window_size_;
+        phase_contrast_.fill(0);
+        samples_per_bit_ = std::min(sample_rate / bit_rate, kMaxWindowSize);  // Number of samples per bit
     }
 
-    std::vector<float> AudioSignalProcessor::ProcessAudioSamples(const std::vector<float> &samples) {
-        std::vector<float> result;
-
-        for (float sample : samples) {
-            if (input_buffer_.size() < input_buffer_size_) {
-                input_buffer_.push_back(sample);  // Just add, don't process yet
-            } else {
-                // Input buffer is full, process the data
-                input_buffer_.pop_front();   // Remove oldest sample
-                input_buffer_.push_back(sample);  // Add new sample
-                output_sample_count_++;
-
-                if (output_sample_count_ >= samples_per_bit_) {
-                    // Process all samples in the window using Goertzel algorithm
-                    for (float window_sample : input_buffer_) {
-                        mark_detector_->ProcessSample(window_sample);
-                        space_detector_->ProcessSample(window_sample);
-                    }
-
-                    float mark_amplitude = mark_detector_->GetAmplitude();   // Mark amplitude
-                    float space_amplitude = space_detector_->GetAmplitude(); // Space amplitude
+    bool AudioSignalProcessor::ProcessSample(int16_t sample, float &mark_probability) {
+        int16_t oldest = window_[window_position_];
+        window_[window_position_] = sample;
+        if (++window_position_ >= window_size_) {
+            window_position_ = 0;
+        }
+        mark_detector_.ProcessSample(sample, oldest);
+        space_detector_.ProcessSample(sample, oldest);
 
-                    // Avoid division by zero
-                    float mark_probability = mark_amplitude / 
-                                           (space_amplitude + mark_amplitude + std::numeric_limits<float>::epsilon());
-                    result.push_back(mark_probability);
+        if (window_fill_ > 0) {
+            --window_fill_;  // Just add, don't decide yet
+            return false;
+        }
 
-                    // Reset detector windows
-                    mark_detector_->Reset();
-                    space_detector_->Reset();
-                    output_sample_count_ = 0;  // Reset output counter
-                }
+        // The window covers exactly one bit when the contrast between the tones peaks, so
+        // bits are decided at the position of the bit period where it has been highest
+        int32_t mark_magnitude = mark_detector_.GetMagnitude();
+        int32_t space_magnitude = space_detector_.GetMagnitude();
+        int32_t total = mark_magnitude + space_magnitude + 1;
+        int32_t contrast = std::abs(mark_magnitude - space_magnitude) * 256 / total;
+        int16_t &average = phase_contrast_[bit_phase_];
+        average += (contrast - average) / 8;
+
+        bool decided = false;
+        if (bit_phase_ == decision_phase_) {
+            mark_probability = static_cast<float>(mark_magnitude) / static_cast<float>(total);
+            decided = true;
+        }
+        if (++bit_phase_ >= samples_per_bit_) {
+            bit_phase_ = 0;
+            // Moving the decision point drops or repeats a bit, only do it for a clearly better one
+            size_t best = std::max_element(phase_contrast_.begin(), phase_contrast_.begin() + samples_per_bit_) -
+                          phase_contrast_.begin();
+            if (phase_contrast_[best] > phase_contrast_[decision_phase_] + kDecisionHysteresis) {
+                decision_phase_ = best;
             }
         }
-
-        return result;
+        return decided;
     }
 
     // AudioDataBuffer implementation
@@ -1,20 +1,31 @@
 #pragma once
 
+#include <array>
 #include <vector>
 #include <deque>
 #include <string>
-#include <memory>
 #include <optional>
-#include <cmath>
+#include <cstdint>
 #include "wifi_configuration_ap.h"
 #include "application.h"
 
 // Audio signal processing constants for WiFi configuration via audio
 const size_t kAudioSampleRate = 6400;
+#if CONFIG_ACOUSTIC_WIFI_PROVISIONING_200BPS
+const size_t kMarkFrequency = 1800;
+const size_t kSpaceFrequency = 1400;
+const size_t kBitRate = 200;
+#else
 const size_t kMarkFrequency = 1800;
 const size_t kSpaceFrequency = 1500;
 const size_t kBitRate = 100;
-const size_t kWindowSize = 64;
+#endif
+// One bit per window, both tones must fall on a DFT bin of it (multiples of kBitRate)
+const size_t kWindowSize = kAudioSampleRate / kBitRate;
+const size_t kMaxWindowSize = 128;
+static_assert(kWindowSize <= kMaxWindowSize, "AFSK window too large");
+static_assert(kMarkFrequency % kBitRate == 0 && kSpaceFrequency % kBitRate == 0,
+              "AFSK tones must be multiples of the bit rate");
 
 namespace audio_wifi_config
 {
@@ -23,28 +34,28 @@ namespace audio_wifi_config
                                          size_t input_channels = 1);
 
     /**
-     * Goertzel algorithm implementation for single frequency detection
-     * Used to detect specific audio frequencies in the AFSK demodulation process
+     * Sliding DFT of a single frequency bin in Q15 fixed point
+     * Every sample entering and leaving the window updates the bin in O(1). The terms added
+     * and later removed are computed identically, so the integer state never drifts.
      */
     class FrequencyDetector
     {
     private:
-        float frequency_;              // Target frequency (normalized, i.e., f / fs)
-        size_t window_size_;           // Window size for analysis
-        float frequency_bin_;          // Frequency bin
-        float angular_frequency_;      // Angular frequency
-        float cos_coefficient_;        // cos(w)
-        float sin_coefficient_;        // sin(w)
-        float filter_coefficient_;     // 2 * cos(w)
-        std::deque<float> state_buffer_;  // Circular buffer for storing S[-1] and S[-2]
+        size_t bin_;                                    // DFT bin index, frequency = bin * fs / window
+        size_t window_size_;                            // Window size for analysis
+        size_t phase_;                                  // (bin * n) mod window_size of the newest sample
+        std::array<int16_t, kMaxWindowSize> cos_table_; // cos(2 * pi * i / window_size) in Q15
+        std::array<int16_t, kMaxWindowSize> sin_table_; // sin(2 * pi * i / window_size) in Q15
+        int32_t real_;                                  // Real part of the bin, sample units
+        int32_t imaginary_;                             // Imaginary part of the bin, sample units
 
     public:
         /**
          * Constructor
-         * @param frequency Normalized frequency (f / fs)
+         * @param bin DFT bin index (target frequency * window_size / sample_rate)
          * @param window_size Window size for analysis
          */
-        FrequencyDetector(float frequency, size_t window_size);
+        FrequencyDetector(size_t bin, size_t window_size);
 
         /**
          * Reset the detector state
@@ -52,16 +63,17 @@ namespace audio_wifi_config
         void Reset();
 
         /**
-         * Process one audio sample
-         * @param sample Input audio sample
+         * Slide the window by one sample
+         * @param sample Sample entering the window
+         * @param oldest Sample leaving the window (0 while the window fills up)
          */
-        void ProcessSample(float sample);
+        void ProcessSample(int16_t sample, int16_t oldest);
 
         /**
-         * Calculate current amplitude
-         * @return Amplitude value
+         * Calculate current magnitude, approximated without a square root
+         * @return Magnitude in sample units
          */
-        float GetAmplitude() const;
+        uint32_t GetMagnitude() const;
     };
 
     /**
@@ -71,12 +83,16 @@ namespace audio_wifi_config
     class AudioSignalProcessor
     {
     private:
-        std::deque<float> input_buffer_;             // Input sample buffer
-        size_t input_buffer_size_;                   // Input buffer size = window size
-        size_t output_sample_count_;                 // Output sample counter
-        size_t samples_per_bit_;                     // Samples per bit threshold
-        std::unique_ptr<FrequencyDetector> mark_detector_;   // Mark frequency detector
-        std::unique_ptr<FrequencyDetector> space_detector_;  // Space frequency detector
+        std::array<int16_t, kMaxWindowSize> window_;   // Ring buffer of the last window_size_ samples
+        size_t window_size_;                           // Window size
+        size_t window_position_;                       // Ring buffer position of the oldest sample
+        size_t window_fill_;                           // Samples in the window until it is full
+        size_t samples_per_bit_;                       // Samples per bit
+        size_t bit_phase_;                             // Position of the current sample within the bit period
+        size_t decision_phase_;                        // Bit period position where bits are decided
+        std::array<int16_t, kMaxWindowSize> phase_contrast_;  // Averaged mark/space contrast per position, Q8
+        FrequencyDetector mark_detector_;              // Mark frequency detector
+        FrequencyDetector space_detector_;             // Space frequency detector
 
     public:
         /**
@@ -85,17 +101,18 @@ namespace audio_wifi_config
          * @param mark_frequency Mark frequency for digital '1'
          * @param space_frequency Space frequency for digital '0'
          * @param bit_rate Data transmission bit rate
-         * @param window_size Analysis window size
+         * @param window_size Analysis window size, at most kMaxWindowSize
          */
         AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
                            size_t bit_rate, size_t window_size);
 
         /**
-         * Process input audio samples
-         * @param samples Input audio sample vector
-         * @return Vector of Mark probability values (0.0 to 1.0)
+         * Process one audio sample
+         * @param sample Input audio sample
+         * @param mark_probability Set to the Mark probability (0.0 to 1.0) once per bit
+         * @return true when a bit was completed and mark_probability was set
          */
-        std::vector<float> ProcessAudioSamples(const std::vector<float> &samples);
+        bool ProcessSample(int16_t sample, float &mark_probability);
     };
 
     /**
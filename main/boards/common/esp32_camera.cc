@@ -5,8 +5,12 @@
 #include <unistd.h>
 #include <errno.h>
 #include <esp_heap_caps.h>
+#include <esp_pthread.h>
+#include <esp_timer.h>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <utility>
 
 #include "esp_imgfx_color_convert.h"
 #include "esp_video_device.h"
@@ -14,6 +18,7 @@
 #include "linux/videodev2.h"
 
 #include "board.h"
+#include "memory_arena.h"
 #include "display.h"
 #include "esp32_camera.h"
 #include "esp_jpeg_common.h"
@@ -21,6 +26,7 @@
 #include "jpg/jpeg_to_image.h"
 #include "lvgl_display.h"
 #include "mcp_server.h"
+#include "pixel_ops.h"
 #include "system_info.h"
 
 #ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_DEBUG_MODE
@@ -275,6 +281,10 @@ Esp32Camera::Esp32Camera(const esp_video_init_config_t& config) {
     // 申请缓冲并mmap
     struct v4l2_requestbuffers req = {};
     req.count = strcmp(video_device_name, ESP_VIDEO_MIPI_CSI_DEVICE_NAME) == 0 ? 2 : 1;
+#if CONFIG_XIAOZHI_CAMERA_BURST_FRAMES > 1
+    // 连拍时要保留当前最好的一帧，同时继续接收下一帧
+    req.count++;
+#endif
     req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     req.memory = V4L2_MEMORY_MMAP;
     if (ioctl(video_fd_, VIDIOC_REQBUFS, &req) != 0) {
@@ -361,6 +371,14 @@ Esp32Camera::Esp32Camera(const esp_video_init_config_t& config) {
 }
 
 Esp32Camera::~Esp32Camera() {
+    if (encoder_thread_.joinable()) {
+        encoder_thread_.join();
+    }
+    ReleaseFrame();
+    if (jpeg_chunk_pool_ != nullptr) {
+        MemoryArena::Free(kMemoryCamera, jpeg_chunk_pool_);
+        jpeg_chunk_pool_ = nullptr;
+    }
     if (streaming_on_ && video_fd_ >= 0) {
         int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         ioctl(video_fd_, VIDIOC_STREAMOFF, &type);
@@ -378,6 +396,89 @@ Esp32Camera::~Esp32Camera() {
     esp_video_deinit();
 }
 
+std::shared_ptr<void> Esp32Camera::LendBuffer(const struct v4l2_buffer& buf) {
+    // 借出期间驱动不会写入这个缓冲区，最后一个持有者释放时重新入队
+    return std::shared_ptr<void>(mmap_buffers_[buf.index].start, [this, buf](void*) mutable {
+        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
+            ESP_LOGE(TAG, "VIDIOC_QBUF failed");
+        }
+    });
+}
+
+void Esp32Camera::ReleaseFrame() {
+    frame_.data = nullptr;
+    frame_.len = 0;
+    frame_.owner.reset();
+}
+
+void Esp32Camera::SamplePsramUsage() {
+    psram_min_free_ = MIN(psram_min_free_, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+}
+
+#if CONFIG_XIAOZHI_CAMERA_BURST_FRAMES > 1
+uint32_t Esp32Camera::ScoreFrame(const uint8_t* data, size_t len) {
+#ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
+    int width = sensor_width_;
+    int height = sensor_height_;
+#else
+    int width = frame_.width;
+    int height = frame_.height;
+#endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
+    // 评分在字节序转换之前进行，缓冲区还是传感器的原始字节序
+#ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
+    constexpr bool swapped = true;
+#else
+    constexpr bool swapped = false;
+#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
+    // 每 4 行取一行，足以区分模糊和曝光
+    const int row_step = 4;
+    pixel_luma_stats_t stats = {};
+    switch (sensor_format_) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_YUV422P:
+            if (len < (size_t)width * height * 2) {
+                return 0;
+            }
+            pixel_luma_stats8(data + (swapped ? 1 : 0), width, height, 2, row_step, &stats);
+            break;
+        case V4L2_PIX_FMT_GREY:
+            if (len < (size_t)width * height) {
+                return 0;
+            }
+            pixel_luma_stats8(data, width, height, 1, row_step, &stats);
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            if (len < (size_t)width * height * 3) {
+                return 0;
+            }
+            // 绿色通道近似亮度
+            pixel_luma_stats8(data + 1, width, height, 3, row_step, &stats);
+            break;
+        case V4L2_PIX_FMT_RGB565:
+        case V4L2_PIX_FMT_RGB565X:
+            if (len < (size_t)width * height * 2) {
+                return 0;
+            }
+            pixel_luma_stats565((const uint16_t*)data, width, height,
+                                (sensor_format_ == V4L2_PIX_FMT_RGB565X) != swapped, row_step, &stats);
+            break;
+        default:
+            // YUV420 和 JPEG 不评分，保留第一帧
+            return 0;
+    }
+    if (stats.samples == 0) {
+        return 0;
+    }
+
+    // 平均梯度衡量清晰度；平均亮度偏离中灰以及过暗、过亮的像素越多，曝光分越低
+    uint32_t sharpness = (uint64_t)stats.gradient * 256 / stats.samples;
+    int mean = stats.sum / stats.samples;
+    int exposure = 256 - abs(mean - 128) - (int)((uint64_t)stats.clipped * 256 / stats.samples);
+    exposure = MAX(exposure, 16);
+    return (uint64_t)sharpness * exposure >> 8;
+}
+#endif  // CONFIG_XIAOZHI_CAMERA_BURST_FRAMES > 1
+
 void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token) {
     explain_url_ = url;
     explain_token_ = token;
@@ -388,345 +489,317 @@ bool Esp32Camera::Capture() {
         encoder_thread_.join();
     }
 
+    // 归还上一帧借出的缓冲区，否则只有一个缓冲区的设备会一直等不到新帧
+    ReleaseFrame();
+
     if (!streaming_on_ || video_fd_ < 0) {
         return false;
     }
+    capture_time_us_ = esp_timer_get_time();
+    psram_free_at_capture_ = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    psram_min_free_ = psram_free_at_capture_;
 
+    // 前两帧可能是旧数据，直接归还驱动；第三帧的 mmap 缓冲区借给预览和编码使用，不再复制
+    struct v4l2_buffer buf = {};
     for (int i = 0; i < 3; i++) {
-        struct v4l2_buffer buf = {};
+        if (i > 0 && ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
+            ESP_LOGE(TAG, "VIDIOC_QBUF failed");
+        }
+        buf = {};
         buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         buf.memory = V4L2_MEMORY_MMAP;
         if (ioctl(video_fd_, VIDIOC_DQBUF, &buf) != 0) {
             ESP_LOGE(TAG, "VIDIOC_DQBUF failed");
             return false;
         }
-        if (i == 2) {
-            // 保存帧副本到PSRAM
-            if (frame_.data) {
-                heap_caps_free(frame_.data);
-                frame_.data = nullptr;
-                frame_.format = 0;
-            }
-            frame_.len = buf.bytesused;
-            frame_.data = (uint8_t*)heap_caps_malloc(frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (!frame_.data) {
-                ESP_LOGE(TAG, "alloc frame copy failed: need allocate %lu bytes", buf.bytesused);
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
-                return false;
-            }
+    }
+
+#if CONFIG_XIAOZHI_CAMERA_BURST_FRAMES > 1
+    // 连拍多帧，只保留亮度平面上最清晰、曝光最好的一帧，其余立即归还驱动
+    uint32_t best_score = ScoreFrame((const uint8_t*)mmap_buffers_[buf.index].start, buf.bytesused);
+    for (int i = 1; i < CONFIG_XIAOZHI_CAMERA_BURST_FRAMES; i++) {
+        struct v4l2_buffer next = {};
+        next.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        next.memory = V4L2_MEMORY_MMAP;
+        if (ioctl(video_fd_, VIDIOC_DQBUF, &next) != 0) {
+            ESP_LOGE(TAG, "VIDIOC_DQBUF failed");
+            break;
+        }
+        uint32_t score = ScoreFrame((const uint8_t*)mmap_buffers_[next.index].start, next.bytesused);
+        ESP_LOGD(TAG, "Burst frame %d score %lu, best %lu", i, score, best_score);
+        if (score > best_score) {
+            std::swap(buf, next);
+            best_score = score;
+        }
+        if (ioctl(video_fd_, VIDIOC_QBUF, &next) != 0) {
+            ESP_LOGE(TAG, "VIDIOC_QBUF failed");
+        }
+    }
+#endif  // CONFIG_XIAOZHI_CAMERA_BURST_FRAMES > 1
+
+    frame_.data = (uint8_t*)mmap_buffers_[buf.index].start;
+    frame_.len = MIN(buf.bytesused, mmap_buffers_[buf.index].length);
+    frame_.owner = LendBuffer(buf);
+    SamplePsramUsage();
 
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
-            ESP_LOGW(TAG, "mmap_buffers_[buf.index].length = %d, sensor_width = %d, sensor_height = %d",
-                     mmap_buffers_[buf.index].length, sensor_width_, sensor_height_);
+    ESP_LOGW(TAG, "mmap_buffers_[buf.index].length = %d, sensor_width = %d, sensor_height = %d",
+             mmap_buffers_[buf.index].length, sensor_width_, sensor_height_);
 #else
-            ESP_LOGW(TAG, "mmap_buffers_[buf.index].length = %d, frame.width = %d, frame.height = %d",
-                     mmap_buffers_[buf.index].length, frame_.width, frame_.height);
+    ESP_LOGW(TAG, "mmap_buffers_[buf.index].length = %d, frame.width = %d, frame.height = %d",
+             mmap_buffers_[buf.index].length, frame_.width, frame_.height);
 #endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
-            ESP_LOG_BUFFER_HEXDUMP(TAG, mmap_buffers_[buf.index].start, MIN(mmap_buffers_[buf.index].length, 256),
-                                   ESP_LOG_DEBUG);
-
-            switch (sensor_format_) {
-                case V4L2_PIX_FMT_RGB565:
-                case V4L2_PIX_FMT_RGB24:
-                case V4L2_PIX_FMT_YUYV:
-                case V4L2_PIX_FMT_YUV420:
-                case V4L2_PIX_FMT_GREY:
+    ESP_LOG_BUFFER_HEXDUMP(TAG, mmap_buffers_[buf.index].start, MIN(mmap_buffers_[buf.index].length, 256),
+                           ESP_LOG_DEBUG);
+
+    // 缓冲区在归还驱动之前归我们独占，字节序转换直接原地进行
+    switch (sensor_format_) {
+        case V4L2_PIX_FMT_RGB565:
+        case V4L2_PIX_FMT_RGB24:
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_GREY:
 #ifdef CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
-                case V4L2_PIX_FMT_JPEG:
+        case V4L2_PIX_FMT_JPEG:
 #endif  // CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
 #ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                {
-                    auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                    auto dst16 = (uint16_t*)frame_.data;
-                    size_t count = (size_t)mmap_buffers_[buf.index].length / 2;
-                    for (size_t i = 0; i < count; i++) {
-                        dst16[i] = __builtin_bswap16(src16[i]);
-                    }
-                }
-#else
-                    memcpy(frame_.data, mmap_buffers_[buf.index].start,
-                           MIN(mmap_buffers_[buf.index].length, frame_.len));
+            pixel_swap_bytes16((uint16_t*)frame_.data, (const uint16_t*)frame_.data, frame_.len / 2);
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    frame_.format = sensor_format_;
-                    break;
-                case V4L2_PIX_FMT_YUV422P: {
-                    // 这个格式是 422 YUYV，不是 planer
-                    frame_.format = V4L2_PIX_FMT_YUYV;
+            frame_.format = sensor_format_;
+            break;
+        case V4L2_PIX_FMT_YUV422P: {
+            // 这个格式是 422 YUYV，不是 planer
+            frame_.format = V4L2_PIX_FMT_YUYV;
 #ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    {
-                        auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                        auto dst16 = (uint16_t*)frame_.data;
-                        size_t count = (size_t)mmap_buffers_[buf.index].length / 2;
-                        for (size_t i = 0; i < count; i++) {
-                            dst16[i] = __builtin_bswap16(src16[i]);
-                        }
-                    }
-#else
-                    memcpy(frame_.data, mmap_buffers_[buf.index].start,
-                           MIN(mmap_buffers_[buf.index].length, frame_.len));
+            pixel_swap_bytes16((uint16_t*)frame_.data, (const uint16_t*)frame_.data, frame_.len / 2);
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    break;
-                }
-                case V4L2_PIX_FMT_RGB565X: {
-                    // 大端序的 RGB565 需要转换为小端序
-                    // 目前 esp_video 的大小端都会返回格式为 RGB565，不会返回格式为 RGB565X，此 case 用于未来版本兼容
-                    auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                    auto dst16 = (uint16_t*)frame_.data;
-                    size_t pixel_count = (size_t)frame_.width * (size_t)frame_.height;
-                    for (size_t i = 0; i < pixel_count; i++) {
-                        dst16[i] = __builtin_bswap16(src16[i]);
-                    }
-                    frame_.format = V4L2_PIX_FMT_RGB565;
-                    break;
-                }
-                default:
-                    ESP_LOGE(TAG, "unsupported sensor format: 0x%08lx", sensor_format_);
-                    if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                        ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                    }
-                    return false;
-            }
+            break;
+        }
+        case V4L2_PIX_FMT_RGB565X: {
+            // 大端序的 RGB565 需要转换为小端序
+            // 目前 esp_video 的大小端都会返回格式为 RGB565，不会返回格式为 RGB565X，此 case 用于未来版本兼容
+            pixel_swap_bytes16((uint16_t*)frame_.data, (const uint16_t*)frame_.data,
+                               MIN((size_t)frame_.width * frame_.height, frame_.len / 2));
+            frame_.format = V4L2_PIX_FMT_RGB565;
+            break;
+        }
+        default:
+            ESP_LOGE(TAG, "unsupported sensor format: 0x%08lx", sensor_format_);
+            ReleaseFrame();
+            return false;
+    }
 
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
 #ifndef CONFIG_SOC_PPA_SUPPORTED
-            uint8_t* rotate_dst =
-                (uint8_t*)heap_caps_aligned_alloc(64, frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (rotate_dst == nullptr) {
-                ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
-                return false;
-            }
-            uint8_t* rotate_src = (uint8_t*)frame_.data;
-
-            esp_imgfx_rotate_cfg_t rotate_cfg = {
-                .in_res =
-                    {
-                        .width = static_cast<int16_t>(sensor_width_),
-                        .height = static_cast<int16_t>(sensor_height_),
-                    },
-                .degree = IMAGE_ROTATION_ANGLE,
-            };
-            switch (frame_.format) {
-                case V4L2_PIX_FMT_RGB565:
-                    rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
-                    break;
-                case V4L2_PIX_FMT_YUYV:
-                    rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
-                    break;
-                case V4L2_PIX_FMT_GREY:
-                    rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_Y;
-                    break;
-                case V4L2_PIX_FMT_RGB24:
-                    rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
-                    break;
-                default:
-                    ESP_LOGE(TAG, "unsupported sensor format: 0x%08lx", sensor_format_);
-                    if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                        ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                    }
-                    return false;
-            }
-            esp_imgfx_rotate_handle_t rotate_handle = nullptr;
-            esp_imgfx_err_t imgfx_err = esp_imgfx_rotate_open(&rotate_cfg, &rotate_handle);
-            if (imgfx_err != ESP_IMGFX_ERR_OK || rotate_handle == nullptr) {
-                ESP_LOGE(TAG, "esp_imgfx_rotate_create failed");
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
-                return false;
-            }
+    uint8_t* rotate_dst =
+        (uint8_t*)heap_caps_aligned_alloc(64, frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (rotate_dst == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
+        ReleaseFrame();
+        return false;
+    }
+    uint8_t* rotate_src = (uint8_t*)frame_.data;
 
-            esp_imgfx_data_t rotate_input_data = {
-                .data = rotate_src,
-                .data_len = frame_.len,
-            };
-            esp_imgfx_data_t rotate_output_data = {
-                .data = rotate_dst,
-                .data_len = frame_.len,
-            };
+    esp_imgfx_rotate_cfg_t rotate_cfg = {
+        .in_res =
+            {
+                .width = static_cast<int16_t>(sensor_width_),
+                .height = static_cast<int16_t>(sensor_height_),
+            },
+        .degree = IMAGE_ROTATION_ANGLE,
+    };
+    switch (frame_.format) {
+        case V4L2_PIX_FMT_RGB565:
+            rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
+            break;
+        case V4L2_PIX_FMT_GREY:
+            rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_Y;
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            rotate_cfg.in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
+            break;
+        default:
+            ESP_LOGE(TAG, "unsupported sensor format: 0x%08lx", sensor_format_);
+            ReleaseFrame();
+            return false;
+    }
+    esp_imgfx_rotate_handle_t rotate_handle = nullptr;
+    esp_imgfx_err_t imgfx_err = esp_imgfx_rotate_open(&rotate_cfg, &rotate_handle);
+    if (imgfx_err != ESP_IMGFX_ERR_OK || rotate_handle == nullptr) {
+        ESP_LOGE(TAG, "esp_imgfx_rotate_create failed");
+        ReleaseFrame();
+        return false;
+    }
 
-            imgfx_err = esp_imgfx_rotate_process(rotate_handle, &rotate_input_data, &rotate_output_data);
-            if (imgfx_err != ESP_IMGFX_ERR_OK) {
-                ESP_LOGE(TAG, "esp_imgfx_rotate_process failed");
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
-                esp_imgfx_rotate_close(rotate_handle);
-                rotate_handle = nullptr;
-                return false;
-            }
+    esp_imgfx_data_t rotate_input_data = {
+        .data = rotate_src,
+        .data_len = frame_.len,
+    };
+    esp_imgfx_data_t rotate_output_data = {
+        .data = rotate_dst,
+        .data_len = frame_.len,
+    };
 
-            frame_.data = rotate_dst;
+    imgfx_err = esp_imgfx_rotate_process(rotate_handle, &rotate_input_data, &rotate_output_data);
+    if (imgfx_err != ESP_IMGFX_ERR_OK) {
+        ESP_LOGE(TAG, "esp_imgfx_rotate_process failed");
+        heap_caps_free(rotate_dst);
+        rotate_dst = nullptr;
+        ReleaseFrame();
+        esp_imgfx_rotate_close(rotate_handle);
+        rotate_handle = nullptr;
+        return false;
+    }
 
-            heap_caps_free(rotate_src);
-            rotate_src = nullptr;
+    // 旋转结果改由堆内存持有，V4L2 缓冲区随之归还
+    frame_.data = rotate_dst;
+    frame_.owner = std::shared_ptr<void>(rotate_dst, heap_caps_free);
+    rotate_src = nullptr;
 
-            esp_imgfx_rotate_close(rotate_handle);
-            rotate_handle = nullptr;
+    esp_imgfx_rotate_close(rotate_handle);
+    rotate_handle = nullptr;
 #else   // CONFIG_SOC_PPA_SUPPORTED
-            uint8_t* rotate_src = nullptr;
-
-            ppa_srm_color_mode_t ppa_color_mode;
-            switch (frame_.format) {
-                case V4L2_PIX_FMT_RGB565:
-                    rotate_src = (uint8_t*)frame_.data;
-                    ppa_color_mode = PPA_SRM_COLOR_MODE_RGB565;
-                    break;
-                case V4L2_PIX_FMT_RGB24:
-                    rotate_src = (uint8_t*)frame_.data;
-                    ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
-                    break;
-                case V4L2_PIX_FMT_YUYV: {
-                    ESP_LOGW(TAG, "YUYV format is not supported for PPA rotation, using software conversion to RGB888");
-                    rotate_src = (uint8_t*)heap_caps_malloc(frame_.width * frame_.height * 3,
-                                                            MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                    if (rotate_src == nullptr) {
-                        ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
-                        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                            ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                        }
-                        return false;
-                    }
-                    esp_imgfx_color_convert_cfg_t convert_cfg = {
-                        .in_res = {.width = static_cast<int16_t>(frame_.width),
-                                   .height = static_cast<int16_t>(frame_.height)},
-                        .in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
-                        .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888,
-                    };
-                    esp_imgfx_color_convert_handle_t convert_handle = nullptr;
-                    esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
-                    if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
-                        ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
-                        heap_caps_free(rotate_src);
-                        rotate_src = nullptr;
-                        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                            ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                        }
-                        return false;
-                    }
-                    esp_imgfx_data_t convert_input_data = {
-                        .data = frame_.data,
-                        .data_len = frame_.len,
-                    };
-                    esp_imgfx_data_t convert_output_data = {
-                        .data = rotate_src,
-                        .data_len = static_cast<uint32_t>(frame_.width * frame_.height * 3),
-                    };
-                    err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
-                    if (err != ESP_IMGFX_ERR_OK) {
-                        ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
-                        heap_caps_free(rotate_src);
-                        rotate_src = nullptr;
-                        esp_imgfx_color_convert_close(convert_handle);
-                        convert_handle = nullptr;
-                        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                            ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                        }
-                        return false;
-                    }
-                    esp_imgfx_color_convert_close(convert_handle);
-                    convert_handle = nullptr;
-                    ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
-                    heap_caps_free(frame_.data);
-                    frame_.data = rotate_src;
-                    frame_.len = frame_.width * frame_.height * 3;
-                    break;
-                }
-                default:
-                    ESP_LOGE(TAG, "unsupported sensor format for PPA rotation: 0x%08lx", sensor_format_);
-                    if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                        ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                    }
-                    return false;
-            }
+    uint8_t* rotate_src = nullptr;
 
-            uint8_t* rotate_dst = (uint8_t*)heap_caps_malloc(
-                frame_.width * frame_.height * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT | MALLOC_CAP_CACHE_ALIGNED);
-            if (rotate_dst == nullptr) {
+    ppa_srm_color_mode_t ppa_color_mode;
+    switch (frame_.format) {
+        case V4L2_PIX_FMT_RGB565:
+            rotate_src = (uint8_t*)frame_.data;
+            ppa_color_mode = PPA_SRM_COLOR_MODE_RGB565;
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            rotate_src = (uint8_t*)frame_.data;
+            ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
+            break;
+        case V4L2_PIX_FMT_YUYV: {
+            ESP_LOGW(TAG, "YUYV format is not supported for PPA rotation, using software conversion to RGB888");
+            rotate_src = (uint8_t*)heap_caps_malloc(frame_.width * frame_.height * 3,
+                                                    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (rotate_src == nullptr) {
                 ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
+                ReleaseFrame();
                 return false;
             }
-
-            ppa_client_handle_t ppa_client = nullptr;
-            ppa_client_config_t client_cfg = {
-                .oper_type = PPA_OPERATION_SRM,
-                .max_pending_trans_num = 1,
+            esp_imgfx_color_convert_cfg_t convert_cfg = {
+                .in_res = {.width = static_cast<int16_t>(frame_.width),
+                           .height = static_cast<int16_t>(frame_.height)},
+                .in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
+                .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888,
             };
-            esp_err_t err = ppa_register_client(&client_cfg, &ppa_client);
-            if (err != ESP_OK || ppa_client == nullptr) {
-                ESP_LOGE(TAG, "ppa_register_client failed: %d", (int)err);
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
+            esp_imgfx_color_convert_handle_t convert_handle = nullptr;
+            esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
+            if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
+                heap_caps_free(rotate_src);
+                rotate_src = nullptr;
+                ReleaseFrame();
                 return false;
             }
-
-            ppa_srm_rotation_angle_t ppa_angle = IMAGE_ROTATION_ANGLE;
-
-            ppa_srm_oper_config_t srm_cfg = {};
-            srm_cfg.in.buffer = (void*)rotate_src;
-            srm_cfg.in.pic_w = sensor_width_;
-            srm_cfg.in.pic_h = sensor_height_;
-            srm_cfg.in.block_w = sensor_width_;
-            srm_cfg.in.block_h = sensor_height_;
-            srm_cfg.in.block_offset_x = 0;
-            srm_cfg.in.block_offset_y = 0;
-            srm_cfg.in.srm_cm = ppa_color_mode;
-
-            srm_cfg.out.buffer = (void*)rotate_dst;
-            srm_cfg.out.buffer_size = frame_.len;
-            srm_cfg.out.pic_w = frame_.width;
-            srm_cfg.out.pic_h = frame_.height;
-            srm_cfg.out.block_offset_x = 0;
-            srm_cfg.out.block_offset_y = 0;
-            srm_cfg.out.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
-
-            // 等比例缩放 1.0
-            srm_cfg.scale_x = 1.0f;
-            srm_cfg.scale_y = 1.0f;
-            srm_cfg.rotation_angle = ppa_angle;
-            srm_cfg.mode = PPA_TRANS_MODE_BLOCKING;
-            srm_cfg.user_data = nullptr;
-
-            err = ppa_do_scale_rotate_mirror(ppa_client, &srm_cfg);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "ppa_do_scale_rotate_mirror failed: %d", (int)err);
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
-                (void)ppa_unregister_client(ppa_client);
-                if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-                    ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
-                }
+            esp_imgfx_data_t convert_input_data = {
+                .data = frame_.data,
+                .data_len = frame_.len,
+            };
+            esp_imgfx_data_t convert_output_data = {
+                .data = rotate_src,
+                .data_len = static_cast<uint32_t>(frame_.width * frame_.height * 3),
+            };
+            err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
+            if (err != ESP_IMGFX_ERR_OK) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
+                heap_caps_free(rotate_src);
+                rotate_src = nullptr;
+                esp_imgfx_color_convert_close(convert_handle);
+                convert_handle = nullptr;
+                ReleaseFrame();
                 return false;
             }
+            esp_imgfx_color_convert_close(convert_handle);
+            convert_handle = nullptr;
+            ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
+            frame_.data = rotate_src;
+            frame_.owner = std::shared_ptr<void>(rotate_src, heap_caps_free);
+            frame_.len = frame_.width * frame_.height * 3;
+            break;
+        }
+        default:
+            ESP_LOGE(TAG, "unsupported sensor format for PPA rotation: 0x%08lx", sensor_format_);
+            ReleaseFrame();
+            return false;
+    }
 
-            (void)ppa_unregister_client(ppa_client);
+    uint8_t* rotate_dst = (uint8_t*)heap_caps_malloc(
+        frame_.width * frame_.height * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT | MALLOC_CAP_CACHE_ALIGNED);
+    if (rotate_dst == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
+        ReleaseFrame();
+        return false;
+    }
 
-            frame_.data = rotate_dst;
-            frame_.len = frame_.width * frame_.height * 2;
-            frame_.format = V4L2_PIX_FMT_RGB565;
-            heap_caps_free(rotate_src);
-            rotate_src = nullptr;
-#endif  // CONFIG_SOC_PPA_SUPPORTED
-#endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
-        }
+    ppa_client_handle_t ppa_client = nullptr;
+    ppa_client_config_t client_cfg = {
+        .oper_type = PPA_OPERATION_SRM,
+        .max_pending_trans_num = 1,
+    };
+    esp_err_t err = ppa_register_client(&client_cfg, &ppa_client);
+    if (err != ESP_OK || ppa_client == nullptr) {
+        ESP_LOGE(TAG, "ppa_register_client failed: %d", (int)err);
+        heap_caps_free(rotate_dst);
+        rotate_dst = nullptr;
+        ReleaseFrame();
+        return false;
+    }
 
-        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
-            ESP_LOGE(TAG, "VIDIOC_QBUF failed");
-        }
+    ppa_srm_rotation_angle_t ppa_angle = IMAGE_ROTATION_ANGLE;
+
+    ppa_srm_oper_config_t srm_cfg = {};
+    srm_cfg.in.buffer = (void*)rotate_src;
+    srm_cfg.in.pic_w = sensor_width_;
+    srm_cfg.in.pic_h = sensor_height_;
+    srm_cfg.in.block_w = sensor_width_;
+    srm_cfg.in.block_h = sensor_height_;
+    srm_cfg.in.block_offset_x = 0;
+    srm_cfg.in.block_offset_y = 0;
+    srm_cfg.in.srm_cm = ppa_color_mode;
+
+    srm_cfg.out.buffer = (void*)rotate_dst;
+    srm_cfg.out.buffer_size = frame_.len;
+    srm_cfg.out.pic_w = frame_.width;
+    srm_cfg.out.pic_h = frame_.height;
+    srm_cfg.out.block_offset_x = 0;
+    srm_cfg.out.block_offset_y = 0;
+    srm_cfg.out.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
+
+    // 等比例缩放 1.0
+    srm_cfg.scale_x = 1.0f;
+    srm_cfg.scale_y = 1.0f;
+    srm_cfg.rotation_angle = ppa_angle;
+    srm_cfg.mode = PPA_TRANS_MODE_BLOCKING;
+    srm_cfg.user_data = nullptr;
+
+    err = ppa_do_scale_rotate_mirror(ppa_client, &srm_cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ppa_do_scale_rotate_mirror failed: %d", (int)err);
+        heap_caps_free(rotate_dst);
+        rotate_dst = nullptr;
+        (void)ppa_unregister_client(ppa_client);
+        ReleaseFrame();
+        return false;
     }
 
+    (void)ppa_unregister_client(ppa_client);
+
+    frame_.data = rotate_dst;
+    frame_.len = frame_.width * frame_.height * 2;
+    frame_.format = V4L2_PIX_FMT_RGB565;
+    // 旋转结果改由堆内存持有，V4L2 缓冲区或 YUYV 转换的中间结果随之释放
+    frame_.owner = std::shared_ptr<void>(rotate_dst, heap_caps_free);
+    rotate_src = nullptr;
+#endif  // CONFIG_SOC_PPA_SUPPORTED
+#endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
+
     // 显示预览图片
     auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
     if (display != nullptr) {
@@ -741,11 +814,42 @@ bool Esp32Camera::Capture() {
         lv_color_format_t color_format = LV_COLOR_FORMAT_RGB565;
         uint8_t* data = nullptr;
 
+        // 预览图最终会被缩放到不超过屏幕宽度，先按整数倍缩小，避免分配整帧缓冲区
+        int factor = 1;
+        if (display->width() > 0 && w / display->width() > 1) {
+            factor = w / display->width();
+        }
+
         switch (frame_.format) {
             // LVGL 显示 YUV 系的图像似乎都有问题，暂时转换为 RGB565 显示
             case V4L2_PIX_FMT_YUYV:
-            case V4L2_PIX_FMT_YUV420:
+            case V4L2_PIX_FMT_RGB565:
             case V4L2_PIX_FMT_RGB24: {
+                // 直接从借出的缓冲区边转换边缩小
+                uint16_t out_w = (w / factor) & ~1;
+                uint16_t out_h = h / factor;
+                lvgl_image_size = out_w * out_h * 2;
+                data = (uint8_t*)heap_caps_malloc(lvgl_image_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                if (data == nullptr) {
+                    ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+                    return false;
+                }
+                if (frame_.format == V4L2_PIX_FMT_YUYV) {
+                    pixel_yuyv_to_rgb565((uint16_t*)data, out_w, out_h, frame_.data, w, factor);
+                } else if (frame_.format == V4L2_PIX_FMT_RGB24) {
+                    pixel_rgb888_to_rgb565((uint16_t*)data, out_w, out_h, frame_.data, w, factor);
+                } else if (factor > 1) {
+                    pixel_downscale16((uint16_t*)data, out_w, out_h, (const uint16_t*)frame_.data, w, factor);
+                } else {
+                    memcpy(data, frame_.data, lvgl_image_size);
+                }
+                w = out_w;
+                h = out_h;
+                stride = w * 2;
+                break;
+            }
+
+            case V4L2_PIX_FMT_YUV420: {
                 color_format = LV_COLOR_FORMAT_RGB565;
                 data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
                 if (data == nullptr) {
@@ -790,16 +894,6 @@ bool Esp32Camera::Capture() {
                 break;
             }
 
-            case V4L2_PIX_FMT_RGB565:
-                data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                if (data == nullptr) {
-                    ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-                    return false;
-                }
-                memcpy(data, frame_.data, frame_.len);
-                lvgl_image_size = frame_.len;  // fallthrough 时兼顾 YUYV 与 RGB565
-                break;
-
 #ifdef CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
             case V4L2_PIX_FMT_JPEG: {
                 uint8_t* out_data = nullptr;  // out data is allocated by jpeg_to_image
@@ -832,9 +926,12 @@ bool Esp32Camera::Capture() {
                 return false;
         }
 
+        SamplePsramUsage();
         auto image = std::make_unique<LvglAllocatedImage>(data, lvgl_image_size, w, h, stride, color_format);
         display->SetPreviewImage(std::move(image));
     }
+    ESP_LOGI(TAG, "Captured %ux%u frame in %d ms", frame_.width, frame_.height,
+             (int)((esp_timer_get_time() - capture_time_us_) / 1000));
     return true;
 }
 
@@ -872,6 +969,57 @@ bool Esp32Camera::SetVFlip(bool enabled) {
     return true;
 }
 
+// 编码线程与上传方之间循环使用的 JPEG 块：编码线程把输出拷入空闲块，上传方发送后归还。
+// 网络比编码慢时编码线程会在取空闲块时阻塞，内存占用固定为 JPEG_CHUNK_SIZE * JPEG_CHUNK_COUNT
+#define JPEG_CHUNK_SIZE 4096
+#define JPEG_CHUNK_COUNT 8
+
+namespace {
+
+struct JpegChunkPipe {
+    QueueHandle_t free_chunks;   // 空闲块
+    QueueHandle_t ready_chunks;  // 按顺序待发送的块，data 为 nullptr 表示编码结束
+    uint32_t stalls = 0;         // 编码线程等待空闲块的次数
+    bool encode_ok = false;
+};
+
+size_t WriteJpegChunks(void* arg, size_t index, const void* data, size_t len) {
+    auto pipe = static_cast<JpegChunkPipe*>(arg);
+    if (data == nullptr || len == 0) {
+        return 0;  // 结束信号，由编码线程在编码函数返回后发送
+    }
+    // 每段输出立即交给上传方，分块编码时第一个 MCU 行编码完即可开始上传
+    auto src = static_cast<const uint8_t*>(data);
+    size_t left = len;
+    while (left > 0) {
+        JpegChunk chunk;
+        if (xQueueReceive(pipe->free_chunks, &chunk, 0) != pdPASS) {
+            pipe->stalls++;
+            xQueueReceive(pipe->free_chunks, &chunk, portMAX_DELAY);
+        }
+        chunk.len = MIN(left, (size_t)JPEG_CHUNK_SIZE);
+        memcpy(chunk.data, src, chunk.len);
+        xQueueSend(pipe->ready_chunks, &chunk, portMAX_DELAY);
+        src += chunk.len;
+        left -= chunk.len;
+    }
+    return len;
+}
+
+struct FrameStripeSource {
+    const uint8_t* data;
+    size_t row_bytes;
+};
+
+bool ReadFrameStripe(void* arg, uint16_t y, uint16_t lines, uint8_t* buf) {
+    // 从借出的帧缓冲区直接取出一个 MCU 行交给编码器
+    auto source = static_cast<const FrameStripeSource*>(arg);
+    memcpy(buf, source->data + y * source->row_bytes, lines * source->row_bytes);
+    return true;
+}
+
+}  // namespace
+
 /**
  * @brief 将摄像头捕获的图像发送到远程服务器进行AI分析和解释
  *
@@ -880,9 +1028,10 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  * 问题对图像进行AI分析并返回结果。
  *
  * 实现特点：
- * - 使用独立线程编码JPEG，与主线程分离
+ * - 使用独立线程编码JPEG，与主线程分离，双核芯片上固定在另一个核心
  * - 采用分块传输编码(chunked transfer encoding)优化内存使用
- * - 通过队列机制实现编码线程和发送线程的数据同步
+ * - 编码线程和发送线程之间循环使用固定数量的 JPEG 块，网络较慢时编码线程自动等待
+ * - YUYV/RGB565 帧按 MCU 行编码，第一个 MCU 行编码完即开始上传
  * - 支持设备ID、客户端ID和认证令牌的HTTP头部配置
  *
  * @param question 要向AI提出的关于图像的问题，将作为表单字段发送
@@ -900,44 +1049,88 @@ std::string Esp32Camera::Explain(const std::string& question) {
         throw std::runtime_error("Image explain URL or token is not set");
     }
 
-    // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
+    if (jpeg_chunk_pool_ == nullptr) {
+        jpeg_chunk_pool_ = (uint8_t*)MemoryArena::Allocate(kMemoryCamera, JPEG_CHUNK_SIZE * JPEG_CHUNK_COUNT);
+        if (jpeg_chunk_pool_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate JPEG chunk pool");
+            throw std::runtime_error("Failed to allocate JPEG chunk pool");
+        }
+    }
+
+    JpegChunkPipe pipe;
+    pipe.free_chunks = xQueueCreate(JPEG_CHUNK_COUNT, sizeof(JpegChunk));
+    pipe.ready_chunks = xQueueCreate(JPEG_CHUNK_COUNT + 1, sizeof(JpegChunk));
+    if (pipe.free_chunks == nullptr || pipe.ready_chunks == nullptr) {
         ESP_LOGE(TAG, "Failed to create JPEG queue");
+        if (pipe.free_chunks != nullptr) {
+            vQueueDelete(pipe.free_chunks);
+        }
+        if (pipe.ready_chunks != nullptr) {
+            vQueueDelete(pipe.ready_chunks);
+        }
         throw std::runtime_error("Failed to create JPEG queue");
     }
+    for (int i = 0; i < JPEG_CHUNK_COUNT; i++) {
+        JpegChunk chunk = {.data = jpeg_chunk_pool_ + i * JPEG_CHUNK_SIZE, .len = 0};
+        xQueueSend(pipe.free_chunks, &chunk, 0);
+    }
 
-    // We spawn a thread to encode the image to JPEG using optimized encoder (cost about 500ms and 8KB SRAM)
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
-        uint16_t w = frame_.width ? frame_.width : 320;
-        uint16_t h = frame_.height ? frame_.height : 240;
-        v4l2_pix_fmt_t enc_fmt = frame_.format;
-        bool ok = image_to_jpeg_cb(
-            frame_.data, frame_.len, w, h, enc_fmt, 80,
-            [](void* arg, size_t index, const void* data, size_t len) -> size_t {
-                auto jpeg_queue = static_cast<QueueHandle_t>(arg);
-                JpegChunk chunk = {.data = nullptr, .len = len};
-                if (index == 0 && data != nullptr && len > 0) {
-                    chunk.data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                    if (chunk.data == nullptr) {
-                        ESP_LOGE(TAG, "Failed to allocate %zu bytes for JPEG chunk", len);
-                        chunk.len = 0;
-                    } else {
-                        memcpy(chunk.data, data, len);
-                    }
-                } else {
-                    chunk.len = 0;  // Sentinel or error
-                }
-                xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
-                return len;
-            },
-            jpeg_queue);
+    // 上传和编码都占用 CPU，双核芯片上把编码线程放到另一个核心
+    // 先保存调用线程原有的 pthread 配置，创建完编码线程后恢复
+    esp_pthread_cfg_t previous_cfg;
+    if (esp_pthread_get_cfg(&previous_cfg) != ESP_OK) {
+        previous_cfg = esp_pthread_get_default_config();
+    }
+    esp_pthread_cfg_t thread_cfg = esp_pthread_get_default_config();
+    thread_cfg.thread_name = "jpeg_encoder";
+#if CONFIG_SOC_CPU_CORES_NUM > 1
+    thread_cfg.pin_to_core = xPortGetCoreID() == 0 ? 1 : 0;
+#endif
+    esp_pthread_set_cfg(&thread_cfg);
 
-        if (!ok) {
-            JpegChunk chunk = {.data = nullptr, .len = 0};
-            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
+    // We spawn a thread to encode the image to JPEG using optimized encoder (cost about 500ms and 8KB SRAM)
+    // 线程持有帧的一份引用，编码完成前借出的缓冲区不会被归还
+    encoder_thread_ = std::thread([frame = frame_, &pipe]() {
+        uint16_t w = frame.width ? frame.width : 320;
+        uint16_t h = frame.height ? frame.height : 240;
+        v4l2_pix_fmt_t enc_fmt = frame.format;
+        bool stripes = enc_fmt == V4L2_PIX_FMT_YUYV || enc_fmt == V4L2_PIX_FMT_RGB565;
+#if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
+        // 硬件编码器整帧编码已经足够快
+        stripes = false;
+#endif
+        if (stripes) {
+            FrameStripeSource source = {.data = frame.data, .row_bytes = (size_t)w * 2};
+            pipe.encode_ok = image_to_jpeg_stripes(w, h, enc_fmt, 80, ReadFrameStripe, &source,
+                                                   WriteJpegChunks, &pipe, nullptr);
+        } else {
+            pipe.encode_ok = image_to_jpeg_cb(frame.data, frame.len, w, h, enc_fmt, 80, WriteJpegChunks, &pipe);
         }
+        JpegChunk terminator = {.data = nullptr, .len = 0};
+        xQueueSend(pipe.ready_chunks, &terminator, portMAX_DELAY);
     });
+    esp_pthread_set_cfg(&previous_cfg);
+
+    // 发送或丢弃剩余的块直到编码结束，然后回收编码线程和队列
+    size_t total_sent = 0;
+    int64_t first_chunk_us = 0;
+    auto finish_encoding = [&](Http* http) {
+        JpegChunk chunk;
+        while (xQueueReceive(pipe.ready_chunks, &chunk, portMAX_DELAY) == pdPASS && chunk.data != nullptr) {
+            if (http != nullptr) {
+                if (first_chunk_us == 0) {
+                    first_chunk_us = esp_timer_get_time();
+                }
+                SamplePsramUsage();
+                http->Write((const char*)chunk.data, chunk.len);
+                total_sent += chunk.len;
+            }
+            xQueueSend(pipe.free_chunks, &chunk, portMAX_DELAY);
+        }
+        encoder_thread_.join();
+        vQueueDelete(pipe.free_chunks);
+        vQueueDelete(pipe.ready_chunks);
+    };
 
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(3);
@@ -954,17 +1147,8 @@ std::string Esp32Camera::Explain(const std::string& question) {
     http->SetHeader("Transfer-Encoding", "chunked");
     if (!http->Open("POST", explain_url_)) {
         ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
-        encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
-            }
-        }
-        vQueueDelete(jpeg_queue);
+        // 丢弃编码输出，编码线程才不会一直等待空闲块
+        finish_encoding(nullptr);
         throw std::runtime_error("Failed to connect to explain URL");
     }
 
@@ -987,29 +1171,10 @@ std::string Esp32Camera::Explain(const std::string& question) {
         http->Write(file_header.c_str(), file_header.size());
     }
 
-    // 第三块：JPEG数据
-    size_t total_sent = 0;
-    bool saw_terminator = false;
-    while (true) {
-        JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
-            ESP_LOGE(TAG, "Failed to receive JPEG chunk");
-            break;
-        }
-        if (chunk.data == nullptr) {
-            saw_terminator = true;
-            break;  // The last chunk
-        }
-        http->Write((const char*)chunk.data, chunk.len);
-        total_sent += chunk.len;
-        heap_caps_free(chunk.data);
-    }
-    // Wait for the encoder thread to finish
-    encoder_thread_.join();
-    // 清理队列
-    vQueueDelete(jpeg_queue);
+    // 第三块：JPEG数据，边编码边发送
+    finish_encoding(http.get());
 
-    if (!saw_terminator || total_sent == 0) {
+    if (!pipe.encode_ok || total_sent == 0) {
         ESP_LOGE(TAG, "JPEG encoder failed or produced empty output");
         throw std::runtime_error("Failed to encode image to JPEG");
     }
@@ -1022,6 +1187,11 @@ std::string Esp32Camera::Explain(const std::string& question) {
     }
     // 结束块
     http->Write("", 0);
+    int64_t upload_done_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Capture to upload: %d ms (first JPEG chunk after %d ms, encoder waited for chunks %lu times), "
+             "peak PSRAM use %u KB",
+             (int)((upload_done_us - capture_time_us_) / 1000), (int)((first_chunk_us - capture_time_us_) / 1000),
+             pipe.stalls, (unsigned)((psram_free_at_capture_ - psram_min_free_) / 1024));
 
     if (http->GetStatusCode() != 200) {
         ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
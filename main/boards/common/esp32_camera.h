@@ -27,6 +27,8 @@ private:
         uint16_t width = 0;
         uint16_t height = 0;
         v4l2_pix_fmt_t format = 0;
+        // 持有 data 的引用：借出的 V4L2 缓冲区在最后一个引用释放时重新入队，堆内存则被释放
+        std::shared_ptr<void> owner;
     } frame_;
     v4l2_pix_fmt_t sensor_format_ = 0;
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
@@ -40,6 +42,18 @@ private:
     std::string explain_url_;
     std::string explain_token_;
     std::thread encoder_thread_;
+    uint8_t* jpeg_chunk_pool_ = nullptr;
+    // 拍照到上传完成的耗时和 PSRAM 峰值统计
+    int64_t capture_time_us_ = 0;
+    size_t psram_free_at_capture_ = 0;
+    size_t psram_min_free_ = 0;
+
+    std::shared_ptr<void> LendBuffer(const struct v4l2_buffer& buf);
+    void ReleaseFrame();
+    void SamplePsramUsage();
+#if CONFIG_XIAOZHI_CAMERA_BURST_FRAMES > 1
+    uint32_t ScoreFrame(const uint8_t* data, size_t len);
+#endif
 
 public:
     Esp32Camera(const esp_video_init_config_t& config);
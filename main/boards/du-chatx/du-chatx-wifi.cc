@@ -8,6 +8,7 @@
 #include "led/single_led.h"
 #include "power_manager.h"
 #include "power_save_timer.h"
+#include "settings.h"
 
 #include <wifi_station.h>
 #include <esp_log.h>
@@ -52,6 +53,7 @@ private:
             GetBacklight()->RestoreBrightness(); 
         });
         power_save_timer_->OnShutdownRequest([this]() {
+            Settings::Flush();
             ESP_LOGI(TAG, "Shutting down");
             rtc_gpio_set_level(GPIO_NUM_1, 0);
             // 启用保持功能，确保睡眠期间电平不变
@@ -8,6 +8,12 @@
 #define AUDIO_OUTPUT_SAMPLE_RATE 24000
 
 #define AUDIO_INPUT_REFERENCE    true
+// The second microphone of the array is only read when the beamformer uses it
+#if CONFIG_USE_MIC_ARRAY_BEAMFORMING
+#define AUDIO_INPUT_MICS         2
+#else
+#define AUDIO_INPUT_MICS         1
+#endif
 
 #define AUDIO_I2S_GPIO_MCLK GPIO_NUM_16
 #define AUDIO_I2S_GPIO_WS   GPIO_NUM_45
@@ -27,6 +27,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "power_manager.h"
+#include "settings.h"
 
 #define TAG "Spotpear_ESP32_S3_1_28_BOX"
 
@@ -152,6 +153,7 @@ private:
             GetBacklight()->RestoreBrightness();
         });
         power_save_timer_->OnShutdownRequest([this]() {
+            Settings::Flush();
             ESP_LOGI(TAG, "Shutting down");
             // 关闭ES8311音频编解码器
             auto codec = GetAudioCodec();
@@ -9,6 +9,7 @@
 #include "button.h"
 #include "board.h"
 #include "config.h"
+#include "settings.h"
 #include "assets/lang_config.h"
 #include <esp_sleep.h>
 
@@ -289,6 +290,7 @@ public:
         if (!new_charging_status && shutdown_first_)
         {
             shutdown_first_ = false; // 进入后置 false ，防止再次进入关机状态
+            Settings::Flush();
             gpio_config_t shutdown_gpio_conf = {};
             shutdown_gpio_conf.intr_type = GPIO_INTR_DISABLE;
             shutdown_gpio_conf.mode = GPIO_MODE_OUTPUT;
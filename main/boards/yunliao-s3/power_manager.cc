@@ -188,6 +188,7 @@ void PowerManager::Sleep() {
     ESP_LOGI(TAG, "Entering deep sleep");
     Settings settings("board", true);
     settings.SetInt("sleep_flag", 1);
+    Settings::Flush();
     Shutdown4G();
     Shutdown5V();
 
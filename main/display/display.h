@@ -2,6 +2,7 @@
 #define DISPLAY_H
 
 #include "emoji_collection.h"
+#include "ui_update_channel.h"
 
 #ifndef CONFIG_USE_EMOTE_MESSAGE_STYLE
 #define HAVE_LVGL 1
@@ -35,19 +36,30 @@ public:
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetEmotion(const char* emotion);
     virtual void SetChatMessage(const char* role, const char* content);
+    // Append to the latest message of the same role, e.g. streamed TTS sentences
+    virtual void AppendChatMessage(const char* role, const char* content);
+    // Minimum interval between subtitle updates, slow panels batch sentences
+    virtual int subtitle_batch_ms() const { return 0; }
     virtual void SetTheme(Theme* theme);
     virtual Theme* GetTheme() { return current_theme_; }
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
+    // Runs callback on the task that renders the display, displays without one run it in place
+    virtual void RunOnUiTask(void (*callback)(void* arg), void* arg) { callback(arg); }
+    // Drops calls queued by RunOnUiTask that have not run yet
+    virtual void CancelOnUiTask(void (*callback)(void* arg), void* arg) {}
 
     inline int width() const { return width_; }
     inline int height() const { return height_; }
+    // Progress of long-running operations, posted from any task and applied at most every 200 ms
+    inline UiUpdateChannel& ui_updates() { return ui_updates_; }
 
 protected:
     int width_ = 0;
     int height_ = 0;
 
     Theme* current_theme_ = nullptr;
+    UiUpdateChannel ui_updates_{this};
 
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
@@ -2,6 +2,7 @@
 #include "gif/lvgl_gif.h"
 #include "settings.h"
 #include "lvgl_theme.h"
+#include "glyph_cache.h"
 #include "assets/lang_config.h"
 
 #include <vector>
@@ -11,6 +12,7 @@
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
 #include <esp_psram.h>
+#include <esp_timer.h>
 #include <cstring>
 
 #include "board.h"
@@ -88,6 +90,74 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     esp_timer_create(&preview_timer_args, &preview_timer_);
 }
 
+void LcdDisplay::InitializeRenderStats() {
+#if CONFIG_USE_DISPLAY_RENDER_STATS
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto& stats = static_cast<LcdDisplay*>(lv_event_get_user_data(e))->render_stats_;
+        int64_t now = esp_timer_get_time();
+        switch (lv_event_get_code(e)) {
+            case LV_EVENT_REFR_START:
+                stats.refresh_start = now;
+                break;
+            case LV_EVENT_FLUSH_START:
+                stats.flush_start = now;
+                break;
+            case LV_EVENT_FLUSH_FINISH:
+                stats.flush_time += now - stats.flush_start;
+                break;
+            case LV_EVENT_FLUSH_WAIT_START:
+                stats.flush_wait_start = now;
+                break;
+            case LV_EVENT_FLUSH_WAIT_FINISH:
+                stats.flush_wait_time += now - stats.flush_wait_start;
+                break;
+            case LV_EVENT_REFR_READY: {
+                stats.refresh_time += now - stats.refresh_start;
+                stats.frames++;
+                int64_t window = now - stats.window_start;
+                if (window >= 10 * 1000000) {
+                    // Drawing is the refresh minus the time spent waiting for the panel transfer
+                    int64_t draw_time = stats.refresh_time - stats.flush_wait_time;
+                    ESP_LOGI(TAG, "Render stats: %.1f fps, draw %.2f ms/frame, flush submit %.2f ms/frame, "
+                        "flush wait %.2f ms/frame, draw load %.1f%%, wait %.1f%%",
+                        stats.frames * 1000000.0f / window,
+                        draw_time / 1000.0f / stats.frames,
+                        stats.flush_time / 1000.0f / stats.frames,
+                        stats.flush_wait_time / 1000.0f / stats.frames,
+                        draw_time * 100.0f / window,
+                        stats.flush_wait_time * 100.0f / window);
+                    stats = RenderStats{ .window_start = now };
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }, LV_EVENT_ALL, this);
+    render_stats_.window_start = esp_timer_get_time();
+#endif
+}
+
+#if CONFIG_USE_DISPLAY_RENDER_STATS
+void LcdDisplay::LogLayoutStats(size_t length, int64_t layout_time) {
+    // Short messages lay out in well under a millisecond, only long bubbles are worth a line
+    if (length < 512) {
+        return;
+    }
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+    auto glyph_cache = lvgl_theme->text_font()->glyph_cache();
+    if (glyph_cache == nullptr) {
+        ESP_LOGI(TAG, "Layout of %u bytes: %.2f ms, no glyph cache", length, layout_time / 1000.0f);
+        return;
+    }
+    auto stats = glyph_cache->GetStats();
+    ESP_LOGI(TAG, "Layout of %u bytes: %.2f ms, glyph cache hits %.1f%% of %lu lookups, bitmaps %.1f%% of %lu",
+        length, layout_time / 1000.0f,
+        stats.lookups > 0 ? stats.hits * 100.0f / stats.lookups : 0.0f, stats.lookups,
+        stats.bitmap_lookups > 0 ? stats.bitmap_hits * 100.0f / stats.bitmap_lookups : 0.0f, stats.bitmap_lookups);
+}
+#endif
+
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy)
     : LcdDisplay(panel_io, panel, width, height) {
@@ -164,6 +234,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    InitializeRenderStats();
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -227,6 +298,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add RGB display");
         return;
     }
+    InitializeRenderStats();
     
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -280,6 +352,7 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    InitializeRenderStats();
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -289,6 +362,8 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
 }
 
 LcdDisplay::~LcdDisplay() {
+    // A queued progress update would touch the labels deleted below
+    ui_updates_.Stop();
     SetPreviewImage(nullptr);
     
     // Clean up GIF controller
@@ -319,6 +394,15 @@ LcdDisplay::~LcdDisplay() {
     }
     if (content_ != nullptr) {
         lv_obj_del(content_);
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+        lv_style_reset(&message_row_style_);
+        lv_style_reset(&bubble_style_);
+        lv_style_reset(&user_bubble_style_);
+        lv_style_reset(&assistant_bubble_style_);
+        lv_style_reset(&system_bubble_style_);
+        lv_style_reset(&message_text_style_);
+        lv_style_reset(&system_text_style_);
+#endif
     }
     if (bottom_bar_ != nullptr) {
         lv_obj_del(bottom_bar_);
@@ -469,8 +553,9 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, lvgl_theme->spacing(4), 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // Chat messages are created on demand in SetChatMessage and recycled afterwards
     chat_message_label_ = nullptr;
+    InitializeMessageStyles();
 
     low_battery_popup_ = lv_obj_create(screen);
     lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
@@ -499,43 +584,161 @@ void LcdDisplay::SetupUI() {
 #else
 #define  MAX_MESSAGES 20
 #endif
+
+// Message rows are tagged through user data to tell them apart from image bubbles
+static const char* const kMessageRowTag = "message";
+
+void LcdDisplay::InitializeMessageStyles() {
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+
+    lv_style_init(&message_row_style_);
+    lv_style_set_width(&message_row_style_, lv_pct(100));
+    lv_style_set_height(&message_row_style_, LV_SIZE_CONTENT);
+    lv_style_set_bg_opa(&message_row_style_, LV_OPA_TRANSP);
+    lv_style_set_border_width(&message_row_style_, 0);
+    lv_style_set_pad_all(&message_row_style_, 0);
+
+    lv_style_init(&bubble_style_);
+    lv_style_set_width(&bubble_style_, LV_SIZE_CONTENT);
+    lv_style_set_height(&bubble_style_, LV_SIZE_CONTENT);
+    lv_style_set_radius(&bubble_style_, 8);
+    lv_style_set_border_width(&bubble_style_, 0);
+    lv_style_set_pad_all(&bubble_style_, lvgl_theme->spacing(4));
+    lv_style_set_bg_opa(&bubble_style_, LV_OPA_70);
+
+    // The label wraps at the max width, so LVGL measures the text once during layout
+    lv_style_init(&message_text_style_);
+    lv_style_set_width(&message_text_style_, LV_SIZE_CONTENT);
+    lv_style_set_min_width(&message_text_style_, 20);
+    lv_style_set_max_width(&message_text_style_, LV_HOR_RES * 85 / 100 - 16);  // 85% of screen width
+
+    lv_style_init(&system_text_style_);
+    lv_style_init(&user_bubble_style_);
+    lv_style_init(&assistant_bubble_style_);
+    lv_style_init(&system_bubble_style_);
+    UpdateMessageStyles(lvgl_theme);
+}
+
+void LcdDisplay::UpdateMessageStyles(LvglTheme* lvgl_theme) {
+    lv_style_set_text_color(&message_text_style_, lvgl_theme->text_color());
+    lv_style_set_text_color(&system_text_style_, lvgl_theme->system_text_color());
+    lv_style_set_bg_color(&user_bubble_style_, lvgl_theme->user_bubble_color());
+    lv_style_set_bg_color(&assistant_bubble_style_, lvgl_theme->assistant_bubble_color());
+    lv_style_set_bg_color(&system_bubble_style_, lvgl_theme->system_bubble_color());
+}
+
+lv_obj_t* LcdDisplay::CreateMessageRow() {
+    // Row -> bubble -> label, styled only through the shared styles
+    lv_obj_t* row = lv_obj_create(content_);
+    lv_obj_remove_style_all(row);
+    lv_obj_add_style(row, &message_row_style_, 0);
+    lv_obj_remove_flag(row, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_user_data(row, (void*)kMessageRowTag);
+
+    lv_obj_t* bubble = lv_obj_create(row);
+    lv_obj_remove_style_all(bubble);
+    lv_obj_add_style(bubble, &bubble_style_, 0);
+    lv_obj_remove_flag(bubble, LV_OBJ_FLAG_SCROLLABLE);
+
+    lv_obj_t* label = lv_label_create(bubble);
+    lv_obj_add_style(label, &message_text_style_, 0);
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    return row;
+}
+
+lv_obj_t* LcdDisplay::AcquireMessageRow(bool& recycled) {
+    lv_obj_t* row = nullptr;
+    recycled = false;
+    if (!free_message_rows_.empty()) {
+        row = free_message_rows_.back();
+        free_message_rows_.pop_back();
+        lv_obj_remove_flag(row, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        // Reuse the oldest message in ring order once the pool is full
+        while (row == nullptr && lv_obj_get_child_cnt(content_) >= MAX_MESSAGES) {
+            lv_obj_t* oldest = lv_obj_get_child(content_, 0);
+            if (lv_obj_get_user_data(oldest) == kMessageRowTag) {
+                row = oldest;
+                recycled = true;
+            } else {
+                lv_obj_del(oldest);
+            }
+        }
+        if (row == nullptr) {
+            row = CreateMessageRow();
+        }
+    }
+    lv_obj_move_to_index(row, -1);
+    return row;
+}
+
+void LcdDisplay::ReleaseMessageRow(lv_obj_t* row) {
+    lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+    free_message_rows_.push_back(row);
+}
+
+lv_obj_t* LcdDisplay::GetLastMessageRow() {
+    uint32_t child_count = lv_obj_get_child_cnt(content_);
+    for (int i = child_count - 1; i >= 0; i--) {
+        lv_obj_t* child = lv_obj_get_child(content_, i);
+        if (lv_obj_has_flag(child, LV_OBJ_FLAG_HIDDEN)) {
+            continue;
+        }
+        return lv_obj_get_user_data(child) == kMessageRowTag ? child : nullptr;
+    }
+    return nullptr;
+}
+
+void LcdDisplay::SetMessageRowRole(lv_obj_t* row, const char* role) {
+    lv_obj_t* bubble = lv_obj_get_child(row, 0);
+    lv_obj_t* label = lv_obj_get_child(bubble, 0);
+    const char* previous_role = (const char*)lv_obj_get_user_data(bubble);
+    if (previous_role != nullptr && strcmp(previous_role, role) == 0) {
+        return;
+    }
+
+    lv_obj_remove_style(bubble, &user_bubble_style_, 0);
+    lv_obj_remove_style(bubble, &assistant_bubble_style_, 0);
+    lv_obj_remove_style(bubble, &system_bubble_style_, 0);
+    lv_obj_remove_style(label, &system_text_style_, 0);
+
+    // User messages are right-aligned, assistant messages left-aligned and system messages centered
+    if (strcmp(role, "user") == 0) {
+        lv_obj_add_style(bubble, &user_bubble_style_, 0);
+        lv_obj_set_user_data(bubble, (void*)"user");
+        lv_obj_align(bubble, LV_ALIGN_RIGHT_MID, 0, 0);
+    } else if (strcmp(role, "assistant") == 0) {
+        lv_obj_add_style(bubble, &assistant_bubble_style_, 0);
+        lv_obj_set_user_data(bubble, (void*)"assistant");
+        lv_obj_align(bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    } else {
+        lv_obj_add_style(bubble, &system_bubble_style_, 0);
+        lv_obj_add_style(label, &system_text_style_, 0);
+        lv_obj_set_user_data(bubble, (void*)"system");
+        lv_obj_align(bubble, LV_ALIGN_CENTER, 0, 0);
+    }
+}
+
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (content_ == nullptr) {
         return;
     }
-    
-    // Check if message count exceeds limit
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // Delete the oldest message (first child object)
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
-    }
-    
+
+    lv_obj_t* last_row = GetLastMessageRow();
+    bool is_system = strcmp(role, "system") == 0;
+    bool reuse_last = false;
+
     // Collapse system messages (if it's a system message, check if the last message is also a system message)
-    if (strcmp(role, "system") == 0) {
-        if (child_count > 0) {
-            // Get the last message container
-            lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-            if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-                // Get the bubble inside the container
-                lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-                if (last_bubble != nullptr) {
-                    // Check if bubble type is system message
-                    void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                    if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                        // If the last message is also a system message, delete it
-                        lv_obj_del(last_container);
-                    }
+    if (is_system) {
+        if (last_row != nullptr) {
+            const char* last_role = (const char*)lv_obj_get_user_data(lv_obj_get_child(last_row, 0));
+            if (last_role != nullptr && strcmp(last_role, "system") == 0) {
+                if (strlen(content) == 0) {
+                    ReleaseMessageRow(last_row);
+                    return;
                 }
+                reuse_last = true;
             }
         }
     } else {
@@ -544,147 +747,49 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     }
 
     // Avoid empty message boxes
-    if(strlen(content) == 0) {
+    if (strlen(content) == 0) {
         return;
     }
 
-    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-    auto text_font = lvgl_theme->text_font()->font();
-
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 0, 0);
-    lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // Calculate actual text width
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
-
-    // Calculate bubble width
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 85% of screen width
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // Ensure text width is not less than minimum width
-    if (text_width < min_width) {
-        text_width = min_width;
-    }
+    bool recycled = false;
+    lv_obj_t* row = reuse_last ? last_row : AcquireMessageRow(recycled);
+    SetMessageRowRole(row, role);
+    lv_obj_t* label = lv_obj_get_child(lv_obj_get_child(row, 0), 0);
+#if CONFIG_USE_DISPLAY_RENDER_STATS
+    int64_t layout_start = esp_timer_get_time();
+    lv_label_set_text(label, content);
+    lv_obj_update_layout(label);
+    LogLayoutStats(strlen(content), esp_timer_get_time() - layout_start);
+#else
+    lv_label_set_text(label, content);
+#endif
 
-    // If text width is less than max width, use text width
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
-    }
-    
-    // Set message text width
-    lv_obj_set_width(msg_text, bubble_width);  // Subtract padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
+    // Skip the animation when the list shifted because the oldest message was recycled
+    lv_obj_scroll_to_view_recursive(row, recycled ? LV_ANIM_OFF : LV_ANIM_ON);
 
-    // Set bubble width
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+    // Store reference to the latest message label
+    chat_message_label_ = label;
+}
 
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->user_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->assistant_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->system_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->system_text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // Create full-width container for system messages to ensure center alignment
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        lv_obj_set_parent(msg_bubble, container);
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+void LcdDisplay::AppendChatMessage(const char* role, const char* content) {
+    {
+        DisplayLockGuard lock(this);
+        if (content_ == nullptr) {
+            return;
+        }
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+        lv_obj_t* last_row = GetLastMessageRow();
+        if (last_row != nullptr && strcmp(role, "system") != 0 && strlen(content) > 0) {
+            const char* last_role = (const char*)lv_obj_get_user_data(lv_obj_get_child(last_row, 0));
+            if (last_role != nullptr && strcmp(last_role, role) == 0) {
+                lv_obj_t* label = lv_obj_get_child(lv_obj_get_child(last_row, 0), 0);
+                lv_label_ins_text(label, LV_LABEL_POS_LAST, content);
+                lv_obj_scroll_to_view_recursive(last_row, LV_ANIM_OFF);
+                return;
+            }
+        }
     }
-    
-    // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    SetChatMessage(role, content);
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -968,6 +1073,11 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     }
     lv_label_set_text(chat_message_label_, content);
 }
+
+void LcdDisplay::AppendChatMessage(const char* role, const char* content) {
+    // Only the latest sentence fits in the bottom bar
+    SetChatMessage(role, content);
+}
 #endif
 
 void LcdDisplay::SetEmotion(const char* emotion) {
@@ -1001,7 +1111,8 @@ void LcdDisplay::SetEmotion(const char* emotion) {
         gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
         
         if (gif_controller_->IsLoaded()) {
-            // Set up frame update callback
+            // Set up frame update callback, frames are skipped while the emoji is hidden
+            gif_controller_->SetTarget(emoji_image_);
             gif_controller_->SetFrameCallback([this]() {
                 lv_image_set_src(emoji_image_, gif_controller_->image_dsc());
             });
@@ -1093,68 +1204,20 @@ void LcdDisplay::SetTheme(Theme* theme) {
     // Set content background opacity
     lv_obj_set_style_bg_opa(content_, LV_OPA_TRANSP, 0);
 
-    // Iterate through all children of content (message containers or bubbles)
+    // Message bubbles share styles, image bubbles still carry local ones
+    UpdateMessageStyles(lvgl_theme);
+    lv_obj_report_style_change(&message_text_style_);
+    lv_obj_report_style_change(&system_text_style_);
+    lv_obj_report_style_change(&user_bubble_style_);
+    lv_obj_report_style_change(&assistant_bubble_style_);
+    lv_obj_report_style_change(&system_bubble_style_);
+
     uint32_t child_count = lv_obj_get_child_cnt(content_);
     for (uint32_t i = 0; i < child_count; i++) {
         lv_obj_t* obj = lv_obj_get_child(content_, i);
-        if (obj == nullptr) continue;
-        
-        lv_obj_t* bubble = nullptr;
-        
-        // Check if this object is a container or bubble
-        // If it's a container (user or system message), get its child as bubble
-        // If it's a bubble (assistant message), use it directly
-        if (lv_obj_get_child_cnt(obj) > 0) {
-            // Might be a container, check if it's a user or system message container
-            // User and system message containers are transparent
-            lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-            if (bg_opa == LV_OPA_TRANSP) {
-                // This is a user or system message container
-                bubble = lv_obj_get_child(obj, 0);
-            } else {
-                // This might be an assistant message bubble itself
-                bubble = obj;
-            }
-        } else {
-            // No child elements, might be other UI elements, skip
-            continue;
-        }
-        
-        if (bubble == nullptr) continue;
-        
-        // Use saved user data to identify bubble type
-        void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-        if (bubble_type_ptr != nullptr) {
-            const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-            
-            // Apply correct color based on bubble type
-            if (strcmp(bubble_type, "user") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->user_bubble_color(), 0);
-            } else if (strcmp(bubble_type, "assistant") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->assistant_bubble_color(), 0); 
-            } else if (strcmp(bubble_type, "system") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
-            } else if (strcmp(bubble_type, "image") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
-            }
-            
-            // Update border color
-            lv_obj_set_style_border_color(bubble, lvgl_theme->border_color(), 0);
-            
-            // Update text color for the message
-            if (lv_obj_get_child_cnt(bubble) > 0) {
-                lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                if (text != nullptr) {
-                    // Set text color based on bubble type
-                    if (strcmp(bubble_type, "system") == 0) {
-                        lv_obj_set_style_text_color(text, lvgl_theme->system_text_color(), 0);
-                    } else {
-                        lv_obj_set_style_text_color(text, lvgl_theme->text_color(), 0);
-                    }
-                }
-            }
-        } else {
-            ESP_LOGW(TAG, "child[%lu] Bubble type is not found", i);
+        void* bubble_type_ptr = lv_obj_get_user_data(obj);
+        if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "image") == 0) {
+            lv_obj_set_style_bg_color(obj, lvgl_theme->system_bubble_color(), 0);
         }
     }
 #else
@@ -2,6 +2,7 @@
 #define LCD_DISPLAY_H
 
 #include "lvgl_display.h"
+#include "lvgl_theme.h"
 #include "gif/lvgl_gif.h"
 
 #include <esp_lcd_panel_io.h>
@@ -10,6 +11,7 @@
 
 #include <atomic>
 #include <memory>
+#include <vector>
 
 #define PREVIEW_IMAGE_DURATION_MS 5000
 
@@ -36,7 +38,45 @@ protected:
     std::unique_ptr<LvglImage> preview_image_cached_ = nullptr;
     bool hide_subtitle_ = false;  // Control whether to hide chat messages/subtitles
 
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // Shared bubble styles, updated in place when the theme changes
+    lv_style_t message_row_style_;
+    lv_style_t bubble_style_;
+    lv_style_t user_bubble_style_;
+    lv_style_t assistant_bubble_style_;
+    lv_style_t system_bubble_style_;
+    lv_style_t message_text_style_;
+    lv_style_t system_text_style_;
+    // Hidden message rows waiting to be reused
+    std::vector<lv_obj_t*> free_message_rows_;
+
+    void InitializeMessageStyles();
+    void UpdateMessageStyles(LvglTheme* lvgl_theme);
+    lv_obj_t* CreateMessageRow();
+    lv_obj_t* AcquireMessageRow(bool& recycled);
+    lv_obj_t* GetLastMessageRow();
+    void ReleaseMessageRow(lv_obj_t* row);
+    void SetMessageRowRole(lv_obj_t* row, const char* role);
+#endif
+
+#if CONFIG_USE_DISPLAY_RENDER_STATS
+    // Accumulated over one reporting window
+    struct RenderStats {
+        int64_t window_start = 0;
+        int64_t refresh_start = 0;
+        int64_t flush_start = 0;
+        int64_t flush_wait_start = 0;
+        uint32_t frames = 0;
+        int64_t refresh_time = 0;       // REFR_START to REFR_READY, includes waiting for the panel
+        int64_t flush_time = 0;         // Handing areas to the flush callback, the transfer is async
+        int64_t flush_wait_time = 0;    // Blocked until the panel finished the previous transfer
+    } render_stats_;
+
+    void LogLayoutStats(size_t length, int64_t layout_time);
+#endif
+
     void InitializeLcdThemes();
+    void InitializeRenderStats();
     void SetupUI();
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
@@ -49,6 +89,7 @@ public:
     ~LcdDisplay();
     virtual void SetEmotion(const char* emotion) override;
     virtual void SetChatMessage(const char* role, const char* content) override; 
+    virtual void AppendChatMessage(const char* role, const char* content) override;
     virtual void SetPreviewImage(std::unique_ptr<LvglImage> image) override;
 
     // Add theme switching function
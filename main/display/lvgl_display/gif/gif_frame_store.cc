@@ -0,0 +1,263 @@
+#include "gif_frame_store.h"
+#include "gifdec.h"
+#include "memory_arena.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#define TAG "GifFrameStore"
+
+namespace {
+
+struct CacheEntry {
+    const void* gif_data;
+    std::shared_ptr<GifFrameStore> store;   // nullptr remembers GIFs that can't be cached
+    uint32_t last_used;
+};
+
+std::mutex cache_mutex;
+std::vector<CacheEntry> cache_entries;
+uint32_t use_counter = 0;
+
+void* AllocPsram(size_t size) {
+    return MemoryArena::Allocate(kMemoryDisplay, size);
+}
+
+void FreePsram(void* ptr) {
+    MemoryArena::Free(kMemoryDisplay, ptr);
+}
+
+}  // namespace
+
+std::shared_ptr<GifFrameStore> GifFrameStore::Get(const void* gif_data) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for (auto& entry : cache_entries) {
+        if (entry.gif_data == gif_data) {
+            entry.last_used = ++use_counter;
+            return entry.store;
+        }
+    }
+
+    const size_t budget = CONFIG_GIF_FRAME_CACHE_SIZE_KB * 1024;
+    int64_t start_time = esp_timer_get_time();
+    std::shared_ptr<GifFrameStore> store(new GifFrameStore());
+    if (store->Build(gif_data, budget)) {
+        ESP_LOGI(TAG, "Cached %ux%u GIF: %u frames, %u KB in PSRAM (decoder needs %u KB), built in %d ms",
+            store->width_, store->height_, (unsigned)store->frames_.size(), (unsigned)(store->memory_size_ / 1024),
+            (unsigned)(store->width_ * store->height_ * 5 / 1024), (int)((esp_timer_get_time() - start_time) / 1000));
+    } else {
+        ESP_LOGW(TAG, "GIF can't be cached, it will be decoded frame by frame");
+        store.reset();
+    }
+    cache_entries.push_back({gif_data, store, ++use_counter});
+
+    // Evict the least recently used stores nobody is playing until the cache fits its budget
+    size_t total = 0;
+    for (auto& entry : cache_entries) {
+        total += entry.store ? entry.store->memory_size_ : 0;
+    }
+    while (total > budget) {
+        auto victim = cache_entries.end();
+        for (auto it = cache_entries.begin(); it != cache_entries.end(); ++it) {
+            if (it->store && it->store.use_count() == 1 && it->store != store &&
+                (victim == cache_entries.end() || it->last_used < victim->last_used)) {
+                victim = it;
+            }
+        }
+        if (victim == cache_entries.end()) {
+            break;
+        }
+        total -= victim->store->memory_size_;
+        cache_entries.erase(victim);
+    }
+    return store;
+}
+
+GifFrameStore::~GifFrameStore() {
+    for (auto& frame : frames_) {
+        FreePsram(frame.pixels);
+    }
+    FreePsram(loop_start_.pixels);
+}
+
+bool GifFrameStore::Build(const void* gif_data, size_t budget) {
+    gd_GIF* gif = gd_open_gif_data(gif_data);
+    if (gif == nullptr) {
+        return false;
+    }
+    width_ = gif->width;
+    height_ = gif->height;
+
+    size_t canvas_bytes = (size_t)width_ * height_ * 4;
+    auto first = (uint32_t*)AllocPsram(canvas_bytes);
+    auto previous = (uint32_t*)AllocPsram(canvas_bytes);
+    auto canvas = (const uint32_t*)gif->canvas;
+    bool success = false;
+
+    if (first != nullptr && previous != nullptr && gd_get_frame(gif) == 1) {
+        loop_count_ = gif->loop_count;
+        // Stop at the trailer instead of looping so the loop point can be found
+        gif->loop_count = 1;
+        gd_render_frame(gif, gif->canvas);
+
+        Frame frame;
+        success = AddFrame(nullptr, canvas, gif->gce.delay * 10, budget, frame);
+        if (success) {
+            frames_.push_back(frame);
+            memcpy(first, canvas, canvas_bytes);
+            memcpy(previous, canvas, canvas_bytes);
+        }
+
+        int ret = 1;
+        while (success && (ret = gd_get_frame(gif)) == 1) {
+            gd_render_frame(gif, gif->canvas);
+            success = AddFrame(previous, canvas, gif->gce.delay * 10, budget, frame);
+            if (success) {
+                frames_.push_back(frame);
+                memcpy(previous, canvas, canvas_bytes);
+            }
+        }
+        success = success && ret == 0;
+
+        // Frame 0 again, this time drawn over the last frame
+        if (success && gd_get_frame(gif) == 1) {
+            gd_render_frame(gif, gif->canvas);
+            if (memcmp(first, canvas, canvas_bytes) != 0) {
+                ESP_LOGW(TAG, "First frame differs between loops");
+                success = false;
+            } else {
+                success = AddFrame(previous, canvas, frames_[0].delay_ms, budget, loop_start_);
+            }
+        } else {
+            success = false;
+        }
+    }
+
+    FreePsram(first);
+    FreePsram(previous);
+    gd_close_gif(gif);
+
+    if (success && !has_alpha_) {
+        DropAlpha();
+    }
+    return success;
+}
+
+bool GifFrameStore::AddFrame(const uint32_t* previous, const uint32_t* current, uint32_t delay_ms, size_t budget, Frame& frame) {
+    int x0 = 0, y0 = 0, x1 = width_ - 1, y1 = height_ - 1;
+    if (previous != nullptr) {
+        // Bounding box of the pixels that changed
+        x0 = width_;
+        y0 = height_;
+        x1 = -1;
+        y1 = -1;
+        for (int y = 0; y < height_; y++) {
+            const uint32_t* a = previous + y * width_;
+            const uint32_t* b = current + y * width_;
+            if (memcmp(a, b, width_ * 4) == 0) {
+                continue;
+            }
+            int left = 0;
+            while (a[left] == b[left]) {
+                left++;
+            }
+            int right = width_ - 1;
+            while (a[right] == b[right]) {
+                right--;
+            }
+            x0 = std::min(x0, left);
+            x1 = std::max(x1, right);
+            y0 = std::min(y0, y);
+            y1 = y;
+        }
+        if (x1 < 0) {
+            frame = {0, 0, 0, 0, delay_ms, nullptr};
+            return true;
+        }
+    }
+
+    uint16_t w = x1 - x0 + 1;
+    uint16_t h = y1 - y0 + 1;
+    size_t size = (size_t)w * h * 3;
+    if (memory_size_ + size > budget) {
+        ESP_LOGW(TAG, "GIF frames exceed the cache budget of %d KB", CONFIG_GIF_FRAME_CACHE_SIZE_KB);
+        return false;
+    }
+    auto pixels = (uint8_t*)AllocPsram(size);
+    if (pixels == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for GIF frame", (unsigned)size);
+        return false;
+    }
+
+    // The decoder canvas is ARGB8888, B G R A in memory
+    auto rgb = (uint16_t*)pixels;
+    auto alpha = pixels + (size_t)w * h * 2;
+    for (int y = y0; y <= y1; y++) {
+        const uint32_t* row = current + y * width_;
+        for (int x = x0; x <= x1; x++) {
+            uint32_t c = row[x];
+            *rgb++ = ((c >> 8) & 0xf800) | ((c >> 5) & 0x07e0) | ((c >> 3) & 0x001f);
+            uint8_t a = c >> 24;
+            *alpha++ = a;
+            if (a != 0xff) {
+                has_alpha_ = true;
+            }
+        }
+    }
+    memory_size_ += size;
+    frame = {(uint16_t)x0, (uint16_t)y0, w, h, delay_ms, pixels};
+    return true;
+}
+
+void GifFrameStore::DropAlpha() {
+    auto shrink = [this](Frame& frame) {
+        if (frame.pixels == nullptr) {
+            return;
+        }
+        size_t size = (size_t)frame.w * frame.h * 2;
+        auto pixels = (uint8_t*)MemoryArena::Reallocate(kMemoryDisplay, frame.pixels, size);
+        if (pixels != nullptr) {
+            frame.pixels = pixels;
+        }
+        memory_size_ -= (size_t)frame.w * frame.h;
+    };
+    for (auto& frame : frames_) {
+        shrink(frame);
+    }
+    shrink(loop_start_);
+}
+
+bool GifFrameStore::DrawFrame(size_t index, uint8_t* canvas) const {
+    return Draw(frames_[index], canvas);
+}
+
+bool GifFrameStore::DrawLoopStart(uint8_t* canvas) const {
+    return Draw(loop_start_, canvas);
+}
+
+bool GifFrameStore::Draw(const Frame& frame, uint8_t* canvas) const {
+    if (frame.w == 0) {
+        return false;
+    }
+    auto dst = (uint16_t*)canvas + frame.y * width_ + frame.x;
+    auto src = (const uint16_t*)frame.pixels;
+    for (int y = 0; y < frame.h; y++) {
+        memcpy(dst, src, frame.w * 2);
+        dst += width_;
+        src += frame.w;
+    }
+    if (has_alpha_) {
+        // RGB565A8 keeps the alpha plane after the color plane
+        auto dst_alpha = canvas + (size_t)width_ * height_ * 2 + frame.y * width_ + frame.x;
+        auto src_alpha = frame.pixels + (size_t)frame.w * frame.h * 2;
+        for (int y = 0; y < frame.h; y++) {
+            memcpy(dst_alpha, src_alpha, frame.w);
+            dst_alpha += width_;
+            src_alpha += frame.w;
+        }
+    }
+    return true;
+}
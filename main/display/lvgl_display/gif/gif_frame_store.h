@@ -0,0 +1,72 @@
+#pragma once
+
+#include <lvgl.h>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * GIF frames decoded once into the rectangles that change between frames,
+ * stored as RGB565 (plus an A8 plane when the animation has transparent pixels).
+ * Playback becomes a rectangle copy instead of LZW decoding and palette lookups
+ * on every frame. Stores live in PSRAM and are shared by every LvglGif playing
+ * the same image data.
+ */
+class GifFrameStore {
+public:
+    struct Frame {
+        uint16_t x, y, w, h;    // Changed rectangle, w is 0 when nothing changed
+        uint32_t delay_ms;      // How long the frame stays on screen
+        uint8_t* pixels;        // RGB565 rows, followed by A8 rows when the store has alpha
+    };
+
+    /**
+     * Get the store for this GIF, decoding it on first use.
+     * Returns nullptr when the GIF can't be cached, callers then decode frame by frame
+     */
+    static std::shared_ptr<GifFrameStore> Get(const void* gif_data);
+
+    GifFrameStore(const GifFrameStore&) = delete;
+    GifFrameStore& operator=(const GifFrameStore&) = delete;
+    ~GifFrameStore();
+
+    uint16_t width() const { return width_; }
+    uint16_t height() const { return height_; }
+    bool has_alpha() const { return has_alpha_; }
+    lv_color_format_t color_format() const { return has_alpha_ ? LV_COLOR_FORMAT_RGB565A8 : LV_COLOR_FORMAT_RGB565; }
+    size_t canvas_size() const { return (size_t)width_ * height_ * (has_alpha_ ? 3 : 2); }
+    size_t memory_size() const { return memory_size_; }
+
+    // Same meaning as gd_GIF::loop_count: 0 loops forever, -1 plays once, otherwise number of plays
+    int32_t loop_count() const { return loop_count_; }
+    size_t frame_count() const { return frames_.size(); }
+    uint32_t delay_ms(size_t index) const { return frames_[index].delay_ms; }
+
+    /**
+     * Draw a frame onto a canvas that shows the previous frame.
+     * Frame 0 always covers the whole canvas. Returns false if nothing changed
+     */
+    bool DrawFrame(size_t index, uint8_t* canvas) const;
+
+    /**
+     * Draw frame 0 over the last frame when the animation loops
+     */
+    bool DrawLoopStart(uint8_t* canvas) const;
+
+private:
+    GifFrameStore() = default;
+
+    uint16_t width_ = 0;
+    uint16_t height_ = 0;
+    bool has_alpha_ = false;
+    int32_t loop_count_ = -1;
+    size_t memory_size_ = 0;
+    std::vector<Frame> frames_;
+    Frame loop_start_ = {};
+
+    bool Build(const void* gif_data, size_t budget);
+    bool AddFrame(const uint32_t* previous, const uint32_t* current, uint32_t delay_ms, size_t budget, Frame& frame);
+    void DropAlpha();
+    bool Draw(const Frame& frame, uint8_t* canvas) const;
+};
@@ -0,0 +1,102 @@
+#include "gif_scheduler.h"
+#include "lvgl_gif.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <climits>
+
+#define TAG "GifScheduler"
+
+// Decode time one timer pass may use before the remaining animations wait for the next pass
+#define GIF_FRAME_BUDGET_MS 15
+#define GIF_STATS_INTERVAL_MS 60000
+
+void GifScheduler::Add(LvglGif* gif) {
+    if (std::find(gifs_.begin(), gifs_.end(), gif) == gifs_.end()) {
+        gifs_.push_back(gif);
+    }
+    if (timer_ == nullptr) {
+        timer_ = lv_timer_create([](lv_timer_t* timer) {
+            static_cast<GifScheduler*>(lv_timer_get_user_data(timer))->OnTimer();
+        }, 0, this);
+        last_report_ = lv_tick_get();
+    }
+    if (!ticking_) {
+        ScheduleNext();
+    }
+}
+
+void GifScheduler::Remove(LvglGif* gif) {
+    auto it = std::find(gifs_.begin(), gifs_.end(), gif);
+    if (it == gifs_.end()) {
+        return;
+    }
+    if (ticking_) {
+        // OnTimer is walking the list, it drops the empty slot afterwards
+        *it = nullptr;
+        return;
+    }
+    gifs_.erase(it);
+    ScheduleNext();
+}
+
+void GifScheduler::OnTimer() {
+    ticking_ = true;
+    uint32_t now = lv_tick_get();
+    size_t count = gifs_.size();
+    // Start where the last pass ran out of budget so every animation gets its turn
+    for (size_t n = 0; n < count; n++) {
+        size_t index = (next_index_ + n) % count;
+        LvglGif* gif = gifs_[index];
+        if (gif == nullptr || (int32_t)(gif->next_due_ - now) > 0) {
+            continue;
+        }
+        if (lv_tick_elaps(now) >= GIF_FRAME_BUDGET_MS) {
+            next_index_ = index;
+            break;
+        }
+        gif->Tick(now);
+    }
+    ticking_ = false;
+
+    gifs_.erase(std::remove_if(gifs_.begin(), gifs_.end(), [](LvglGif* gif) {
+        return gif == nullptr || !gif->IsPlaying();
+    }), gifs_.end());
+    if (next_index_ >= gifs_.size()) {
+        next_index_ = 0;
+    }
+
+    if (lv_tick_elaps(last_report_) >= GIF_STATS_INTERVAL_MS) {
+        last_report_ = lv_tick_get();
+        ReportStats();
+    }
+    ScheduleNext();
+}
+
+void GifScheduler::ScheduleNext() {
+    if (timer_ == nullptr) {
+        return;
+    }
+    if (gifs_.empty()) {
+        lv_timer_pause(timer_);
+        return;
+    }
+
+    uint32_t now = lv_tick_get();
+    int32_t wait = INT32_MAX;
+    for (auto gif : gifs_) {
+        wait = std::min(wait, (int32_t)(gif->next_due_ - now));
+    }
+    lv_timer_set_period(timer_, std::max<int32_t>(wait, 0));
+    lv_timer_reset(timer_);
+    lv_timer_resume(timer_);
+}
+
+void GifScheduler::ReportStats() {
+    for (auto gif : gifs_) {
+        auto& stats = gif->GetDecodeStats();
+        ESP_LOGD(TAG, "GIF %ux%u: %lu frames, %lu dropped, %lu hidden, decode avg %lu us, max %lu us",
+            gif->width(), gif->height(), stats.frames, stats.dropped, stats.hidden,
+            stats.frames > 0 ? (uint32_t)(stats.total_us / stats.frames) : 0, stats.max_us);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <lvgl.h>
+#include <vector>
+
+class LvglGif;
+
+/**
+ * Drives every playing LvglGif from one LVGL timer that wakes exactly when the
+ * next frame of any animation is due, instead of a 10 ms timer per animation.
+ * When decoding takes longer than the frame budget, the remaining animations
+ * wait for the next pass so LVGL can render in between.
+ */
+class GifScheduler {
+public:
+    static GifScheduler& GetInstance() {
+        static GifScheduler instance;
+        return instance;
+    }
+    GifScheduler(const GifScheduler&) = delete;
+    GifScheduler& operator=(const GifScheduler&) = delete;
+
+    void Add(LvglGif* gif);
+    void Remove(LvglGif* gif);
+
+private:
+    GifScheduler() = default;
+
+    lv_timer_t* timer_ = nullptr;
+    std::vector<LvglGif*> gifs_;
+    size_t next_index_ = 0;
+    bool ticking_ = false;
+    uint32_t last_report_ = 0;
+
+    void OnTimer();
+    void ScheduleNext();
+    void ReportStats();
+};
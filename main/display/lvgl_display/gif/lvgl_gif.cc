@@ -1,16 +1,51 @@
 #include "lvgl_gif.h"
+#include "gif_scheduler.h"
+#include "memory_arena.h"
 #include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <algorithm>
 #include <cstring>
 
 #define TAG "LvglGif"
 
+// GIF frames with a delay of 0 are shown for this long
+#define GIF_MIN_FRAME_DELAY_MS 10
+// Give up catching up when running later than this, the animation just continues from now
+#define GIF_MAX_CATCH_UP_MS 1000
+
 LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
-    : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
+    : gif_(nullptr), next_due_(0), frame_delay_(0), playing_(false), loaded_(false) {
     if (!img_dsc || !img_dsc->data) {
         ESP_LOGE(TAG, "Invalid image descriptor");
         return;
     }
 
+#if CONFIG_USE_GIF_FRAME_CACHE
+    frame_store_ = GifFrameStore::Get(img_dsc->data);
+    if (frame_store_) {
+        canvas_ = (uint8_t*)MemoryArena::Allocate(kMemoryDisplay, frame_store_->canvas_size());
+        if (canvas_ != nullptr) {
+            memset(&img_dsc_, 0, sizeof(img_dsc_));
+            img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+            img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
+            img_dsc_.header.cf = frame_store_->color_format();
+            img_dsc_.header.w = frame_store_->width();
+            img_dsc_.header.h = frame_store_->height();
+            img_dsc_.header.stride = frame_store_->width() * 2;
+            img_dsc_.data = canvas_;
+            img_dsc_.data_size = frame_store_->canvas_size();
+
+            frame_store_->DrawFrame(0, canvas_);
+            loop_count_ = frame_store_->loop_count();
+            loaded_ = true;
+            return;
+        }
+        ESP_LOGE(TAG, "Failed to allocate GIF canvas");
+        frame_store_.reset();
+    }
+#endif
+
     gif_ = gd_open_gif_data(img_dsc->data);
     if (!gif_) {
         ESP_LOGE(TAG, "Failed to open GIF from image descriptor");
@@ -52,61 +87,54 @@ const lv_img_dsc_t* LvglGif::image_dsc() const {
 
 // Animation control methods
 void LvglGif::Start() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot start");
         return;
     }
 
-    if (!timer_) {
-        timer_ = lv_timer_create([](lv_timer_t* timer) {
-            LvglGif* gif_obj = static_cast<LvglGif*>(lv_timer_get_user_data(timer));
-            gif_obj->NextFrame();
-        }, 10, this);
-    }
-
-    if (timer_) {
-        playing_ = true;
-        last_call_ = lv_tick_get();
-        lv_timer_resume(timer_);
-        lv_timer_reset(timer_);
-        
-        // Render first frame
-        NextFrame();
-        
-        ESP_LOGD(TAG, "GIF animation started");
-    }
+    playing_ = true;
+    next_due_ = lv_tick_get() + frame_delay_;
+    GifScheduler::GetInstance().Add(this);
+    ESP_LOGD(TAG, "GIF animation started");
 }
 
 void LvglGif::Pause() {
-    if (timer_) {
+    if (playing_) {
         playing_ = false;
-        lv_timer_pause(timer_);
+        GifScheduler::GetInstance().Remove(this);
         ESP_LOGD(TAG, "GIF animation paused");
     }
 }
 
 void LvglGif::Resume() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot resume");
         return;
     }
 
-    if (timer_) {
+    if (!playing_) {
         playing_ = true;
-        lv_timer_resume(timer_);
+        next_due_ = lv_tick_get() + frame_delay_;
+        GifScheduler::GetInstance().Add(this);
         ESP_LOGD(TAG, "GIF animation resumed");
     }
 }
 
 void LvglGif::Stop() {
-    if (timer_) {
-        playing_ = false;
-        lv_timer_pause(timer_);
+    playing_ = false;
+    GifScheduler::GetInstance().Remove(this);
+    frame_delay_ = 0;
+
+#if CONFIG_USE_GIF_FRAME_CACHE
+    if (frame_store_) {
+        rewound_ = true;
+        loop_count_ = frame_store_->loop_count();
+        ESP_LOGD(TAG, "GIF animation stopped and rewound");
     }
+#endif
 
     if (gif_) {
         gd_rewind(gif_);
-        NextFrame();
         ESP_LOGD(TAG, "GIF animation stopped and rewound");
     }
 }
@@ -120,79 +148,156 @@ bool LvglGif::IsLoaded() const {
 }
 
 int32_t LvglGif::GetLoopCount() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return -1;
     }
+#if CONFIG_USE_GIF_FRAME_CACHE
+    if (frame_store_) {
+        return loop_count_;
+    }
+#endif
     return gif_->loop_count;
 }
 
 void LvglGif::SetLoopCount(int32_t count) {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot set loop count");
         return;
     }
+#if CONFIG_USE_GIF_FRAME_CACHE
+    if (frame_store_) {
+        loop_count_ = count;
+        return;
+    }
+#endif
     gif_->loop_count = count;
 }
 
 uint16_t LvglGif::width() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->width;
+    return img_dsc_.header.w;
 }
 
 uint16_t LvglGif::height() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->height;
+    return img_dsc_.header.h;
 }
 
 void LvglGif::SetFrameCallback(std::function<void()> callback) {
     frame_callback_ = callback;
 }
 
-void LvglGif::NextFrame() {
-    if (!loaded_ || !gif_ || !playing_) {
+void LvglGif::SetTarget(lv_obj_t* target) {
+    target_ = target;
+}
+
+void LvglGif::Tick(uint32_t now) {
+    if (!loaded_ || !playing_) {
         return;
     }
 
-    // Check if enough time has passed for the next frame
-    uint32_t elapsed = lv_tick_elaps(last_call_);
-    if (elapsed < gif_->gce.delay * 10) {
+    // Nobody can see the frame, check again after one frame
+    if (target_ != nullptr && !lv_obj_is_visible(target_)) {
+        stats_.hidden++;
+        next_due_ = now + std::max<uint32_t>(frame_delay_, GIF_MIN_FRAME_DELAY_MS);
         return;
     }
 
-    last_call_ = lv_tick_get();
+    if ((int32_t)(now - next_due_) > GIF_MAX_CATCH_UP_MS) {
+        next_due_ = now;
+    }
 
-    // Get next frame
-    int has_next = gd_get_frame(gif_);
-    if (has_next == 0) {
-        // Animation finished, pause timer
-        playing_ = false;
-        if (timer_) {
-            lv_timer_pause(timer_);
+    int64_t start_time = esp_timer_get_time();
+    bool changed = false;
+    while (true) {
+        bool frame_changed = false;
+        if (!NextFrame(frame_changed)) {
+            playing_ = false;
+            ESP_LOGD(TAG, "GIF animation completed");
+            break;
         }
-        ESP_LOGD(TAG, "GIF animation completed");
+        changed = changed || frame_changed;
+        next_due_ += std::max<uint32_t>(frame_delay_, GIF_MIN_FRAME_DELAY_MS);
+        if ((int32_t)(next_due_ - now) > 0) {
+            break;
+        }
+        // Running late. Cached frames are cheap to skip through, decoded ones only slow down
+#if CONFIG_USE_GIF_FRAME_CACHE
+        if (frame_store_) {
+            stats_.dropped++;
+            continue;
+        }
+#endif
+        next_due_ = now + std::max<uint32_t>(frame_delay_, GIF_MIN_FRAME_DELAY_MS);
+        break;
+    }
+
+    uint32_t elapsed_us = esp_timer_get_time() - start_time;
+    stats_.frames++;
+    stats_.total_us += elapsed_us;
+    stats_.max_us = std::max(stats_.max_us, elapsed_us);
+
+    // Unchanged frames don't need to be redrawn
+    if (changed && frame_callback_) {
+        frame_callback_();
+    }
+}
+
+bool LvglGif::NextFrame(bool& changed) {
+#if CONFIG_USE_GIF_FRAME_CACHE
+    if (frame_store_) {
+        return NextCachedFrame(changed);
+    }
+#endif
+    changed = false;
+    if (!loaded_ || !gif_) {
+        return false;
+    }
+
+    // Get next frame
+    if (gd_get_frame(gif_) != 1) {
+        return false;
     }
 
     // Render current frame
     if (gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
-        
-        // Call frame callback if set
-        if (frame_callback_) {
-            frame_callback_();
+        changed = true;
+    }
+    frame_delay_ = gif_->gce.delay * 10;
+    return true;
+}
+
+#if CONFIG_USE_GIF_FRAME_CACHE
+bool LvglGif::NextCachedFrame(bool& changed) {
+    if (rewound_) {
+        rewound_ = false;
+        frame_index_ = 0;
+        changed = frame_store_->DrawFrame(0, canvas_);
+    } else if (frame_index_ + 1 < frame_store_->frame_count()) {
+        frame_index_++;
+        changed = frame_store_->DrawFrame(frame_index_, canvas_);
+    } else if (loop_count_ == 1 || loop_count_ < 0) {
+        changed = false;
+        return false;
+    } else {
+        if (loop_count_ > 1) {
+            loop_count_--;
         }
+        frame_index_ = 0;
+        changed = frame_store_->DrawLoopStart(canvas_);
     }
+    frame_delay_ = frame_store_->delay_ms(frame_index_);
+    return true;
 }
+#endif
 
 void LvglGif::Cleanup() {
-    // Stop and delete timer
-    if (timer_) {
-        lv_timer_delete(timer_);
-        timer_ = nullptr;
-    }
+    GifScheduler::GetInstance().Remove(this);
 
     // Close GIF decoder
     if (gif_) {
@@ -200,6 +305,14 @@ void LvglGif::Cleanup() {
         gif_ = nullptr;
     }
 
+#if CONFIG_USE_GIF_FRAME_CACHE
+    if (canvas_) {
+        MemoryArena::Free(kMemoryDisplay, canvas_);
+        canvas_ = nullptr;
+    }
+    frame_store_.reset();
+#endif
+
     playing_ = false;
     loaded_ = false;
     
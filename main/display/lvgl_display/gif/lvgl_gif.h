@@ -2,6 +2,9 @@
 
 #include "../lvgl_image.h"
 #include "gifdec.h"
+#if CONFIG_USE_GIF_FRAME_CACHE
+#include "gif_frame_store.h"
+#endif
 #include <lvgl.h>
 #include <memory>
 #include <functional>
@@ -69,30 +72,68 @@ public:
      */
     void SetFrameCallback(std::function<void()> callback);
 
+    /**
+     * Set the object showing this GIF, frames are not decoded while it is hidden or off screen
+     */
+    void SetTarget(lv_obj_t* target);
+
+    struct DecodeStats {
+        uint32_t frames = 0;        // Frames decoded and shown
+        uint32_t dropped = 0;       // Frames skipped to catch up after running late
+        uint32_t hidden = 0;        // Due frames not decoded because the target was hidden
+        uint64_t total_us = 0;
+        uint32_t max_us = 0;
+    };
+
+    /**
+     * Get decode timings since the GIF was loaded
+     */
+    const DecodeStats& GetDecodeStats() const { return stats_; }
+
 private:
+    friend class GifScheduler;
+
     // GIF decoder instance
     gd_GIF* gif_;
     
     // LVGL image descriptor
     lv_img_dsc_t img_dsc_;
     
-    // Animation timer
-    lv_timer_t* timer_;
-    
-    // Last frame update time
-    uint32_t last_call_;
+    // Tick when the next frame is due, driven by GifScheduler
+    uint32_t next_due_;
+    // How long the current frame stays on screen
+    uint32_t frame_delay_;
     
     // Animation state
     bool playing_;
     bool loaded_;
+
+    lv_obj_t* target_ = nullptr;
+    DecodeStats stats_;
     
     // Frame update callback
     std::function<void()> frame_callback_;
+
+#if CONFIG_USE_GIF_FRAME_CACHE
+    // Pre-decoded frames shared with other instances, gif_ is null when they are used
+    std::shared_ptr<GifFrameStore> frame_store_;
+    uint8_t* canvas_ = nullptr;
+    size_t frame_index_ = 0;
+    bool rewound_ = true;
+    int32_t loop_count_ = -1;
+
+    bool NextCachedFrame(bool& changed);
+#endif
     
     /**
-     * Update to next frame
+     * Show due frames, called by GifScheduler
+     */
+    void Tick(uint32_t now);
+
+    /**
+     * Update to next frame, returns false when the animation finished
      */
-    void NextFrame();
+    bool NextFrame(bool& changed);
     
     /**
      * Cleanup resources
@@ -0,0 +1,197 @@
+#include "glyph_cache.h"
+#include "memory_arena.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <cstring>
+
+#define TAG "GlyphCache"
+
+GlyphCache::GlyphCache(const lv_font_t* source, size_t size) : source_(source) {
+    cached_font_.font = *source;
+    cached_font_.font.get_glyph_dsc = GetGlyphDsc;
+    cached_font_.font.get_glyph_bitmap = GetGlyphBitmap;
+    cached_font_.cache = this;
+
+    // The advance of a kerned glyph depends on the next letter, only cache descriptors without kerning
+    if (source->get_glyph_dsc == lv_font_get_glyph_dsc_fmt_txt) {
+        auto fdsc = static_cast<const lv_font_fmt_txt_dsc_t*>(source->dsc);
+        cache_dsc_ = source->kerning == LV_FONT_KERNING_NONE || fdsc->kern_dsc == nullptr;
+    } else {
+        cache_dsc_ = source->kerning == LV_FONT_KERNING_NONE;
+    }
+
+    // A bitmap slot holds a glyph as large as the line height, twice as many descriptors
+    // as bitmaps leave room for the Latin letters and punctuation
+    slot_size_ = source->line_height * source->line_height;
+    size_t glyph_size = slot_size_ + sizeof(BitmapEntry) + 2 * sizeof(DscEntry);
+    int glyphs = size / glyph_size / kWays * kWays;
+    if (glyphs == 0) {
+        ESP_LOGW(TAG, "%u bytes can't hold a single set of %d px glyphs", size, (int)source->line_height);
+        return;
+    }
+    bitmap_sets_ = glyphs / kWays;
+    dsc_sets_ = 2 * bitmap_sets_;
+
+    auto memory = static_cast<uint8_t*>(MemoryArena::Allocate(kMemoryDisplay, glyphs * glyph_size));
+    if (memory == nullptr) {
+        ESP_LOGW(TAG, "Failed to allocate %u bytes, glyphs are read from flash", glyphs * glyph_size);
+        return;
+    }
+    dscs_ = reinterpret_cast<DscEntry*>(memory);
+    bitmaps_ = reinterpret_cast<BitmapEntry*>(dscs_ + dsc_sets_ * kWays);
+    slots_ = reinterpret_cast<uint8_t*>(bitmaps_ + bitmap_sets_ * kWays);
+    memset(memory, 0, slots_ - memory);
+    ESP_LOGI(TAG, "Caching %d glyphs of %d px in %u KB", glyphs, (int)source->line_height, glyphs * glyph_size / 1024);
+}
+
+GlyphCache::~GlyphCache() {
+    if (dscs_ != nullptr) {
+        MemoryArena::Free(kMemoryDisplay, dscs_);
+    }
+}
+
+bool GlyphCache::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    return reinterpret_cast<const CachedFont*>(font)->cache->LookupDsc(dsc, letter, letter_next);
+}
+
+const void* GlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    return reinterpret_cast<const CachedFont*>(dsc->resolved_font)->cache->LookupBitmap(dsc, draw_buf);
+}
+
+// Least recently used way of a set, an empty one first
+template <typename Entry>
+Entry* GlyphCache::Victim(Entry* set) {
+    Entry* victim = &set[0];
+    for (int i = 0; i < kWays; i++) {
+        if (set[i].age == 0) {
+            return &set[i];
+        }
+        if (set[i].age < victim->age) {
+            victim = &set[i];
+        }
+    }
+    return victim;
+}
+
+bool GlyphCache::LookupDsc(lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    // The source callbacks read the glyph tables through font->dsc, which the copy shares
+    if (!cache_dsc_ || !ok() || letter == 0) {
+        return source_->get_glyph_dsc(font(), dsc, letter, letter_next);
+    }
+
+    stats_.lookups++;
+    DscEntry* set = &dscs_[Hash(letter) % dsc_sets_ * kWays];
+    for (int i = 0; i < kWays; i++) {
+        if (set[i].letter == letter) {
+            // Keep what the caller put in the descriptor to ask for the glyph
+            lv_font_glyph_dsc_t request = *dsc;
+            *dsc = set[i].dsc;
+            dsc->resolved_font = request.resolved_font;
+            dsc->req_raw_bitmap = request.req_raw_bitmap;
+            dsc->outline_stroke_width = request.outline_stroke_width;
+            dsc->entry = request.entry;
+            set[i].age = ++clock_;
+            stats_.hits++;
+            return true;
+        }
+    }
+
+    if (!source_->get_glyph_dsc(font(), dsc, letter, letter_next)) {
+        return false;
+    }
+    DscEntry* victim = Victim(set);
+    victim->letter = letter;
+    victim->age = ++clock_;
+    victim->dsc = *dsc;
+    return true;
+}
+
+const void* GlyphCache::LookupBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    // Only the masks the renderer expands into its A8 buffer are cached, raw requests pass through
+    bool cacheable = ok() && draw_buf != nullptr && !dsc->req_raw_bitmap &&
+        dsc->format >= LV_FONT_GLYPH_FORMAT_A1 && dsc->format <= LV_FONT_GLYPH_FORMAT_A8 &&
+        (size_t)dsc->box_w * dsc->box_h <= slot_size_;
+    if (!cacheable) {
+        return source_->get_glyph_bitmap(dsc, draw_buf);
+    }
+
+    stats_.bitmap_lookups++;
+    uint32_t glyph = dsc->gid.index + 1;
+    int first = Hash(glyph) % bitmap_sets_ * kWays;
+    for (int i = first; i < first + kWays; i++) {
+        auto& entry = bitmaps_[i];
+        if (entry.glyph == glyph && entry.width == dsc->box_w && entry.height == dsc->box_h) {
+            const uint8_t* src = slots_ + i * slot_size_;
+            uint8_t* dst = static_cast<uint8_t*>(draw_buf->data);
+            for (int y = 0; y < entry.height; y++) {
+                memcpy(dst + y * draw_buf->header.stride, src + y * entry.width, entry.width);
+            }
+            entry.age = ++clock_;
+            stats_.bitmap_hits++;
+            return draw_buf;
+        }
+    }
+
+    const void* result = source_->get_glyph_bitmap(dsc, draw_buf);
+    if (result != draw_buf || draw_buf->header.cf != LV_COLOR_FORMAT_A8) {
+        return result;
+    }
+    BitmapEntry* victim = Victim(&bitmaps_[first]);
+    victim->glyph = glyph;
+    victim->age = ++clock_;
+    victim->width = dsc->box_w;
+    victim->height = dsc->box_h;
+    uint8_t* dst = slots_ + (victim - bitmaps_) * slot_size_;
+    const uint8_t* src = static_cast<const uint8_t*>(draw_buf->data);
+    for (int y = 0; y < victim->height; y++) {
+        memcpy(dst + y * victim->width, src + y * draw_buf->header.stride, victim->width);
+    }
+    return result;
+}
+
+void GlyphCache::Prewarm(const char* text, size_t size) {
+    if (!ok()) {
+        return;
+    }
+
+    // A private scratch buffer, the LVGL heap is not ours to use outside the display lock
+    size_t scratch_size = 2 * slot_size_;
+    auto scratch = static_cast<uint8_t*>(heap_caps_malloc(scratch_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (scratch == nullptr) {
+        return;
+    }
+
+    // Stop short of the capacity, so later entries rarely push the more frequent ones out of their set
+    int64_t start_time = esp_timer_get_time();
+    int limit = bitmap_sets_ * kWays * 3 / 4;
+    int count = 0;
+    uint32_t offset = 0;
+    while (offset < size && count < limit) {
+        uint32_t letter = lv_text_encoded_next(text, &offset);
+        if (letter == 0) {
+            break;
+        }
+        if (letter <= ' ') {
+            continue;
+        }
+        lv_font_glyph_dsc_t dsc = {};
+        if (!GetGlyphDsc(font(), &dsc, letter, 0)) {
+            continue;
+        }
+        dsc.resolved_font = font();
+        uint32_t stride = lv_draw_buf_width_to_stride(dsc.box_w, LV_COLOR_FORMAT_A8);
+        lv_draw_buf_t draw_buf;
+        if (dsc.box_w == 0 || dsc.box_h == 0 || stride * dsc.box_h > scratch_size ||
+            lv_draw_buf_init(&draw_buf, dsc.box_w, dsc.box_h, LV_COLOR_FORMAT_A8, stride, scratch, scratch_size) != LV_RESULT_OK) {
+            continue;
+        }
+        LookupBitmap(&dsc, &draw_buf);
+        count++;
+    }
+    heap_caps_free(scratch);
+
+    stats_ = {};
+    ESP_LOGI(TAG, "Prewarmed %d glyphs in %lld ms", count, (esp_timer_get_time() - start_time) / 1000);
+}
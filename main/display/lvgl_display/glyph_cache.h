@@ -0,0 +1,77 @@
+#pragma once
+
+#include <lvgl.h>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Keeps the most recently used glyphs of a bitmap font in PSRAM: their descriptors, so
+ * layout skips the cmap search, and their bitmaps expanded to the A8 masks the LVGL
+ * renderer draws, so drawing skips reading and unpacking the glyph from flash. font()
+ * is a copy of the source font whose glyph callbacks go through the cache.
+ */
+class GlyphCache {
+public:
+    struct Stats {
+        uint32_t lookups;
+        uint32_t hits;
+        uint32_t bitmap_lookups;
+        uint32_t bitmap_hits;
+    };
+
+    GlyphCache(const lv_font_t* source, size_t size);
+    ~GlyphCache();
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    // False when the cache memory could not be allocated, use the source font then
+    bool ok() const { return dscs_ != nullptr; }
+    const lv_font_t* font() const { return &cached_font_.font; }
+
+    // Fills the cache from UTF-8 text of characters ordered by frequency, before the font is in use
+    void Prewarm(const char* text, size_t size);
+    Stats GetStats() const { return stats_; }
+
+private:
+    static constexpr int kWays = 4;
+
+    // Standard layout so the font pointer LVGL hands back leads to the cache
+    struct CachedFont {
+        lv_font_t font;
+        GlyphCache* cache;
+    };
+
+    struct DscEntry {
+        uint32_t letter;        // 0 for an empty way
+        uint32_t age;
+        lv_font_glyph_dsc_t dsc;
+    };
+
+    struct BitmapEntry {
+        uint32_t glyph;         // Glyph index plus one, 0 for an empty way
+        uint32_t age;
+        uint16_t width;
+        uint16_t height;
+    };
+
+    const lv_font_t* source_;
+    CachedFont cached_font_;
+    bool cache_dsc_ = false;
+    int dsc_sets_ = 0;
+    int bitmap_sets_ = 0;
+    size_t slot_size_ = 0;
+    uint32_t clock_ = 0;
+    DscEntry* dscs_ = nullptr;
+    BitmapEntry* bitmaps_ = nullptr;
+    uint8_t* slots_ = nullptr;
+    Stats stats_ = {};
+
+    static uint32_t Hash(uint32_t key) { return key * 2654435761u; }
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+
+    bool LookupDsc(lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    const void* LookupBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+    template <typename Entry>
+    static Entry* Victim(Entry* set);
+};
@@ -3,6 +3,7 @@
 #include <esp_log.h>
 #include <stddef.h>
 #include <string.h>
+#include <algorithm>
 #include <utility>
 
 #include "esp_jpeg_common.h"
@@ -13,6 +14,7 @@
 #include "driver/jpeg_encode.h"
 #endif
 #include "image_to_jpeg.h"
+#include "pixel_ops.h"
 
 #define TAG "image_to_jpeg"
 
@@ -27,14 +29,6 @@ static void* malloc_psram(size_t size) {
 #endif
 }
 
-static __always_inline uint8_t expand_5_to_8(uint8_t v) {
-    return (uint8_t)((v << 3) | (v >> 2));
-}
-
-static __always_inline uint8_t expand_6_to_8(uint8_t v) {
-    return (uint8_t)((v << 2) | (v >> 4));
-}
-
 static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
                                              jpeg_pixel_format_t* out_fmt, int* out_size) {
     // GRAY 直接作为 JPEG_PIXEL_FORMAT_GRAY 输入
@@ -261,10 +255,7 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
         uint16_t* buf = (uint16_t*)malloc_psram(sz);
         if (!buf)
             return NULL;
-        const uint16_t* bsrc = (const uint16_t*)src;
-        for (int i = 0; i < sz / 2; i++) {
-            buf[i] = __builtin_bswap16(bsrc[i]);
-        }
+        pixel_swap_bytes16(buf, (const uint16_t*)src, sz / 2);
         if (out_fmt)
             *out_fmt = JPEG_ENCODE_IN_FORMAT_YUV422;
         if (out_size)
@@ -465,3 +456,135 @@ bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t hei
 #endif
     return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg);
 }
+
+bool image_to_jpeg_stripes(uint16_t width, uint16_t height, v4l2_pix_fmt_t format, uint8_t quality,
+                           jpg_stripe_cb stripe_cb, void* stripe_arg, jpg_out_cb cb, void* arg,
+                           size_t* peak_memory) {
+    if (quality < 1)
+        quality = 1;
+    if (quality > 100)
+        quality = 100;
+
+    esp_imgfx_pixel_fmt_t in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
+    bool need_convert = true;
+    switch (format) {
+        case V4L2_PIX_FMT_RGB565:
+            in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
+            break;
+        case V4L2_PIX_FMT_RGB565X:
+            in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_BE;
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            need_convert = false;
+            break;
+        default:
+            ESP_LOGE(TAG, "unsupported stripe format: 0x%08lx", format);
+            return false;
+    }
+
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    cfg.width = width;
+    cfg.height = height;
+    cfg.src_type = JPEG_PIXEL_FORMAT_YCbYCr;
+    cfg.subsampling = JPEG_SUBSAMPLE_420;
+    cfg.quality = quality;
+    cfg.rotate = JPEG_ROTATE_0D;
+    cfg.task_enable = false;
+
+    jpeg_enc_handle_t h = NULL;
+    jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
+        return false;
+    }
+
+    // 编码器每次处理一个 MCU 行，YCbYCr 每像素 2 字节
+    int block_size = jpeg_enc_get_block_size(h);
+    size_t row_bytes = (size_t)width * 2;
+    uint16_t block_lines = block_size / row_bytes;
+    // 输出缓冲区按最坏情况预留，首块还包含 JPEG 头部
+    int out_cap = block_size * 2 + 1024;
+
+    uint8_t* block = (uint8_t*)jpeg_calloc_align(block_size, 16);
+    uint8_t* stripe = need_convert ? (uint8_t*)jpeg_calloc_align(block_size, 16) : block;
+    uint8_t* outbuf = (uint8_t*)malloc_psram(out_cap);
+    esp_imgfx_color_convert_handle_t convert_handle = nullptr;
+    bool ok = block != nullptr && stripe != nullptr && outbuf != nullptr;
+    if (!ok) {
+        ESP_LOGE(TAG, "alloc stripe buffers failed");
+    }
+
+    if (ok && need_convert) {
+        esp_imgfx_color_convert_cfg_t convert_cfg = {
+            .in_res = {.width = static_cast<int16_t>(width),
+                        .height = static_cast<int16_t>(block_lines)},
+            .in_pixel_fmt = in_pixel_fmt,
+            .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
+            .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
+        };
+        if (esp_imgfx_color_convert_open(&convert_cfg, &convert_handle) != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
+            ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
+            ok = false;
+        }
+    }
+
+    size_t offset = 0;
+    for (uint16_t y = 0; ok && y < height; y += block_lines) {
+        uint16_t lines = std::min<int>(block_lines, height - y);
+        if (!stripe_cb(stripe_arg, y, lines, stripe)) {
+            ESP_LOGE(TAG, "stripe source failed at line %u", y);
+            ok = false;
+            break;
+        }
+        // 最后一个 MCU 行不足时重复最后一行
+        for (uint16_t l = lines; l < block_lines; l++) {
+            memcpy(stripe + l * row_bytes, stripe + (lines - 1) * row_bytes, row_bytes);
+        }
+        if (need_convert) {
+            esp_imgfx_data_t convert_input_data = {
+                .data = stripe,
+                .data_len = static_cast<uint32_t>(block_size),
+            };
+            esp_imgfx_data_t convert_output_data = {
+                .data = block,
+                .data_len = static_cast<uint32_t>(block_size),
+            };
+            if (esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data) != ESP_IMGFX_ERR_OK) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
+                ok = false;
+                break;
+            }
+        }
+
+        int out_len = 0;
+        ret = jpeg_enc_process_with_block(h, block, block_size, outbuf, out_cap, &out_len);
+        if (ret < JPEG_ERR_OK) {
+            ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
+            ok = false;
+            break;
+        }
+        if (out_len > 0) {
+            cb(arg, offset, outbuf, (size_t)out_len);
+            offset += out_len;
+        }
+    }
+    if (ok) {
+        cb(arg, offset, NULL, 0);  // 结束信号
+    }
+
+    if (peak_memory) {
+        *peak_memory = block_size + (need_convert ? block_size : 0) + out_cap;
+    }
+    if (convert_handle) {
+        esp_imgfx_color_convert_close(convert_handle);
+    }
+    jpeg_enc_close(h);
+    if (stripe && stripe != block) {
+        jpeg_free_align(stripe);
+    }
+    if (block) {
+        jpeg_free_align(block);
+    }
+    free(outbuf);
+    return ok;
+}
@@ -63,6 +63,36 @@ bool image_to_jpeg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height
 bool image_to_jpeg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, 
                       v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void *arg);
 
+// 条带输入回调函数类型
+// arg: 用户自定义参数, y: 起始行, lines: 行数, buf: 输出缓冲区（width * lines 个像素，无行填充）
+// 返回: 成功返回 true
+typedef bool (*jpg_stripe_cb)(void *arg, uint16_t y, uint16_t lines, uint8_t *buf);
+
+/**
+ * @brief 按条带将图像编码为JPEG（流式版本）
+ *
+ * 每次只向 stripe_cb 请求一个 MCU 行高度的条带，转换后交给编码器，
+ * 编码输出随即通过 cb 交给调用者，峰值内存与图像高度无关：
+ * - 适合大分辨率屏幕截图等无法一次性准备整帧数据的场景
+ * - 仅使用软件编码器
+ * - 输出回调的 index 为当前数据块在 JPEG 中的偏移，结束时以 data 为 NULL、len 为 0 调用
+ *
+ * @param width       图像宽度
+ * @param height      图像高度
+ * @param format      条带格式 (V4L2_PIX_FMT_RGB565, V4L2_PIX_FMT_RGB565X, V4L2_PIX_FMT_YUYV)
+ * @param quality     JPEG质量 (1-100)
+ * @param stripe_cb   条带输入回调函数
+ * @param stripe_arg  传递给条带回调函数的用户参数
+ * @param cb          输出回调函数
+ * @param arg         传递给输出回调函数的用户参数
+ * @param peak_memory 可为 NULL，返回条带与输出缓冲区占用的字节数
+ *
+ * @return true 成功, false 失败
+ */
+bool image_to_jpeg_stripes(uint16_t width, uint16_t height, v4l2_pix_fmt_t format, uint8_t quality,
+                           jpg_stripe_cb stripe_cb, void *stripe_arg, jpg_out_cb cb, void *arg,
+                           size_t *peak_memory);
+
 #ifdef __cplusplus
 }
 #endif
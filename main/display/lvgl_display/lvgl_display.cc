@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <font_awesome.h>
+#include <lvgl_private.h>
 
 #include "lvgl_display.h"
 #include "board.h"
@@ -41,6 +42,7 @@ LvglDisplay::LvglDisplay() {
 }
 
 LvglDisplay::~LvglDisplay() {
+    ui_updates_.Stop();
     if (notification_timer_ != nullptr) {
         esp_timer_stop(notification_timer_);
         esp_timer_delete(notification_timer_);
@@ -205,6 +207,23 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
 void LvglDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
 }
 
+// The callback runs from lv_timer_handler, with the LVGL lock already held
+void LvglDisplay::RunOnUiTask(void (*callback)(void* arg), void* arg) {
+    {
+        DisplayLockGuard lock(this);
+        if (lv_async_call(callback, arg) == LV_RESULT_OK) {
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "Failed to post to the LVGL task, running in place");
+    callback(arg);
+}
+
+void LvglDisplay::CancelOnUiTask(void (*callback)(void* arg), void* arg) {
+    DisplayLockGuard lock(this);
+    lv_async_call_cancel(callback, arg);
+}
+
 void LvglDisplay::SetPowerSaveMode(bool on) {
     if (on) {
         SetChatMessage("system", "");
@@ -215,42 +234,109 @@ void LvglDisplay::SetPowerSaveMode(bool on) {
     }
 }
 
-bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
 #if CONFIG_LV_USE_SNAPSHOT
-    DisplayLockGuard lock(this);
+// The only place touching LVGL internals: a copy of what lv_snapshot_take_to_draw_buf does in
+// LVGL 9.3, limited to an area of the object. Check it against lv_snapshot.c when LVGL moves.
+#if LVGL_VERSION_MAJOR != 9 || LVGL_VERSION_MINOR != 3
+#error "RedrawArea mirrors the LVGL 9.3 lv_snapshot internals, review it for this version"
+#endif
+static void RedrawArea(lv_obj_t* obj, const lv_area_t& area, lv_draw_buf_t* draw_buf) {
+    lv_layer_t layer;
+    lv_memzero(&layer, sizeof(layer));
+    layer.draw_buf = draw_buf;
+    layer.buf_area = area;
+    layer.color_format = draw_buf->header.cf;
+    layer._clip_area = area;
+    layer.phy_clip_area = area;
+#if LV_DRAW_TRANSFORM_USE_MATRIX
+    lv_matrix_identity(&layer.matrix);
+#endif
 
-    lv_obj_t* screen = lv_screen_active();
-    lv_draw_buf_t* draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
-    if (draw_buffer == nullptr) {
-        ESP_LOGE(TAG, "Failed to take snapshot, draw_buffer is nullptr");
-        return false;
+    lv_display_t* display = lv_obj_get_display(obj);
+    lv_display_t* display_old = lv_refr_get_disp_refreshing();
+    lv_layer_t* layer_old = display->layer_head;
+    display->layer_head = &layer;
+    lv_refr_set_disp_refreshing(display);
+    lv_obj_redraw(&layer, obj);
+    while (layer.draw_task_head) {
+        lv_draw_dispatch_wait_for_request();
+        lv_draw_dispatch();
     }
+    display->layer_head = layer_old;
+    lv_refr_set_disp_refreshing(display_old);
+}
 
-    // swap bytes
-    uint16_t* data = (uint16_t*)draw_buffer->data;
-    size_t pixel_count = draw_buffer->data_size / 2;
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = __builtin_bswap16(data[i]);
-    }
+// Render rows [y, y + lines) of the screen into buf
+static void RenderScreenStripe(lv_obj_t* screen, int32_t y, int32_t lines, uint8_t* buf) {
+    int32_t width = lv_obj_get_width(screen);
+    lv_draw_buf_t draw_buf;
+    lv_draw_buf_init(&draw_buf, width, lines, LV_COLOR_FORMAT_RGB565, width * 2, buf, width * lines * 2);
+    lv_draw_buf_clear(&draw_buf, nullptr);
 
-    // Clear output string and use callback version to avoid pre-allocating large memory blocks
+    lv_area_t area;
+    lv_obj_get_coords(screen, &area);
+    area.y1 += y;
+    area.y2 = area.y1 + lines - 1;
+    RedrawArea(screen, area, &draw_buf);
+}
+#endif
+
+bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
     jpeg_data.clear();
+    return SnapshotToJpeg([&jpeg_data](const void* data, size_t len) {
+        jpeg_data.append(static_cast<const char*>(data), len);
+    }, quality);
+}
 
-    // Use callback-based JPEG encoder to further save memory
-    bool ret = image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w, draw_buffer->header.h, V4L2_PIX_FMT_RGB565, quality,
-        [](void *arg, size_t index, const void *data, size_t len) -> size_t {
-        std::string* output = static_cast<std::string*>(arg);
-        if (data && len > 0) {
-            output->append(static_cast<const char*>(data), len);
-        }
-        return len;
-    }, &jpeg_data);
+bool LvglDisplay::SnapshotToJpeg(const std::function<void(const void* data, size_t len)>& sink, int quality) {
+#if CONFIG_LV_USE_SNAPSHOT
+    struct SnapshotContext {
+        LvglDisplay* display;
+        lv_obj_t* screen;
+        const std::function<void(const void*, size_t)>* sink;
+        size_t total;
+    } context = { this, nullptr, &sink, 0 };
+
+    uint16_t width, height;
+    {
+        DisplayLockGuard lock(this);
+        context.screen = lv_screen_active();
+        width = lv_obj_get_width(context.screen);
+        height = lv_obj_get_height(context.screen);
+    }
+
+    // Only one MCU row of pixels exists at a time. The display is locked per stripe,
+    // so the UI keeps running while the JPEG is being uploaded
+    size_t peak_memory = 0;
+    int64_t start_time = esp_timer_get_time();
+    // LVGL renders native little endian RGB565, read as big endian it matches what the encoder expects
+    bool ret = image_to_jpeg_stripes(width, height, V4L2_PIX_FMT_RGB565X, quality,
+        [](void* arg, uint16_t y, uint16_t lines, uint8_t* buf) -> bool {
+            auto context = static_cast<SnapshotContext*>(arg);
+            DisplayLockGuard lock(context->display);
+            // The screen captured at the start may be deleted by now, don't touch it
+            if (lv_screen_active() != context->screen) {
+                ESP_LOGW(TAG, "Screen changed during snapshot, aborted");
+                return false;
+            }
+            RenderScreenStripe(context->screen, y, lines, buf);
+            return true;
+        }, &context,
+        [](void* arg, size_t index, const void* data, size_t len) -> size_t {
+            auto context = static_cast<SnapshotContext*>(arg);
+            if (data && len > 0) {
+                (*context->sink)(data, len);
+                context->total += len;
+            }
+            return len;
+        }, &context, &peak_memory);
     if (!ret) {
         ESP_LOGE(TAG, "Failed to convert image to JPEG");
+        return false;
     }
-
-    lv_draw_buf_destroy(draw_buffer);
-    return ret;
+    ESP_LOGI(TAG, "Snapshot %ux%u encoded to %u bytes in %d ms, peak buffer memory %u bytes",
+        width, height, (unsigned)context.total, (int)((esp_timer_get_time() - start_time) / 1000), (unsigned)peak_memory);
+    return true;
 #else
     ESP_LOGE(TAG, "LV_USE_SNAPSHOT is not enabled");
     return false;
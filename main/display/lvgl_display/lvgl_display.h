@@ -11,6 +11,7 @@
 
 #include <string>
 #include <chrono>
+#include <functional>
 
 class LvglDisplay : public Display {
 public:
@@ -23,7 +24,11 @@ public:
     virtual void SetPreviewImage(std::unique_ptr<LvglImage> image);
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
+    virtual void RunOnUiTask(void (*callback)(void* arg), void* arg) override;
+    virtual void CancelOnUiTask(void (*callback)(void* arg), void* arg) override;
     virtual bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
+    // Encode the screen stripe by stripe, JPEG data goes to sink as soon as it is produced
+    virtual bool SnapshotToJpeg(const std::function<void(const void* data, size_t len)>& sink, int quality = 80);
 
 protected:
     esp_pm_lock_handle_t pm_lock_ = nullptr;
@@ -1,13 +1,36 @@
 #include "lvgl_font.h"
+#include "glyph_cache.h"
 #include <cbin_font.h>
 
 
-LvglCBinFont::LvglCBinFont(void* data) {
+LvglCBinFont::LvglCBinFont(void* data, bool use_glyph_cache) {
     font_ = cbin_font_create(static_cast<uint8_t*>(data));
+#if CONFIG_USE_GLYPH_CACHE
+    if (font_ != nullptr && use_glyph_cache) {
+        glyph_cache_ = std::make_unique<GlyphCache>(font_, CONFIG_GLYPH_CACHE_SIZE_KB * 1024);
+        if (!glyph_cache_->ok()) {
+            glyph_cache_.reset();
+        }
+    }
+#endif
 }
 
 LvglCBinFont::~LvglCBinFont() {
+    glyph_cache_.reset();
     if (font_ != nullptr) {
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+const lv_font_t* LvglCBinFont::font() const {
+    if (glyph_cache_) {
+        return glyph_cache_->font();
+    }
+    return font_;
+}
+
+void LvglCBinFont::Prewarm(const char* text, size_t size) {
+    if (glyph_cache_) {
+        glyph_cache_->Prewarm(text, size);
+    }
+}
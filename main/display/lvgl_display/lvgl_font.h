@@ -1,11 +1,15 @@
 #pragma once
 
 #include <lvgl.h>
+#include <memory>
 
+class GlyphCache;
 
 class LvglFont {
 public:
     virtual const lv_font_t* font() const = 0;
+    // Glyph cache in front of the font, if any
+    virtual const GlyphCache* glyph_cache() const { return nullptr; }
     virtual ~LvglFont() = default;
 };
 
@@ -22,10 +26,15 @@ private:
 
 class LvglCBinFont : public LvglFont {
 public:
-    LvglCBinFont(void* data);
+    // Renderers other than LVGL's own can opt out of the glyph cache
+    LvglCBinFont(void* data, bool use_glyph_cache = true);
     virtual ~LvglCBinFont();
-    virtual const lv_font_t* font() const override { return font_; }
+    virtual const lv_font_t* font() const override;
+    virtual const GlyphCache* glyph_cache() const override { return glyph_cache_.get(); }
+    // Caches the glyphs of a UTF-8 list of characters ordered by frequency, call before the font is in use
+    void Prewarm(const char* text, size_t size);
 
 private:
     lv_font_t* font_;
+    std::unique_ptr<GlyphCache> glyph_cache_;
 };
@@ -0,0 +1,168 @@
+#include "pixel_ops.h"
+
+// Lets a 16-bit pixel buffer be read and written as 32-bit words
+typedef uint32_t __attribute__((may_alias)) pixel_word_t;
+
+static inline uint32_t swap_bytes_in_halves(uint32_t v) {
+    return ((v & 0x00ff00ffu) << 8) | ((v >> 8) & 0x00ff00ffu);
+}
+
+void pixel_swap_bytes16(uint16_t* dst, const uint16_t* src, size_t count) {
+    size_t i = 0;
+    // The word loop needs both buffers to share the same alignment
+    if ((((uintptr_t)dst ^ (uintptr_t)src) & 3) == 0) {
+        if (((uintptr_t)src & 3) != 0 && count > 0) {
+            dst[0] = __builtin_bswap16(src[0]);
+            i = 1;
+        }
+        auto s = reinterpret_cast<const pixel_word_t*>(src + i);
+        auto d = reinterpret_cast<pixel_word_t*>(dst + i);
+        size_t words = (count - i) / 2;
+        size_t w = 0;
+        for (; w + 4 <= words; w += 4) {
+            uint32_t a = s[w + 0];
+            uint32_t b = s[w + 1];
+            uint32_t c = s[w + 2];
+            uint32_t e = s[w + 3];
+            d[w + 0] = swap_bytes_in_halves(a);
+            d[w + 1] = swap_bytes_in_halves(b);
+            d[w + 2] = swap_bytes_in_halves(c);
+            d[w + 3] = swap_bytes_in_halves(e);
+        }
+        for (; w < words; w++) {
+            d[w] = swap_bytes_in_halves(s[w]);
+        }
+        i += words * 2;
+    }
+    for (; i < count; i++) {
+        dst[i] = __builtin_bswap16(src[i]);
+    }
+}
+
+void pixel_downscale16(uint16_t* dst, int dst_width, int dst_height,
+                       const uint16_t* src, int src_width, int factor) {
+    for (int y = 0; y < dst_height; y++) {
+        const uint16_t* row = src + (size_t)y * factor * src_width;
+        for (int x = 0, sx = 0; x < dst_width; x++, sx += factor) {
+            *dst++ = row[sx];
+        }
+    }
+}
+
+static inline uint8_t clamp_u8(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// Full range BT.601 (JFIF), the same interpretation the JPEG encoder gives YUYV frames
+static inline uint16_t yuv_to_rgb565(int y, int r_offset, int g_offset, int b_offset) {
+    y <<= 8;
+    uint8_t r = clamp_u8((y + r_offset) >> 8);
+    uint8_t g = clamp_u8((y + g_offset) >> 8);
+    uint8_t b = clamp_u8((y + b_offset) >> 8);
+    return (uint16_t)(((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3));
+}
+
+void pixel_yuyv_to_rgb565(uint16_t* dst, int dst_width, int dst_height,
+                          const uint8_t* src, int src_width, int factor) {
+    for (int y = 0; y < dst_height; y++) {
+        const uint8_t* row = src + (size_t)y * factor * src_width * 2;
+        for (int x = 0, sx = 0; x < dst_width; sx += factor) {
+            // Chroma is shared by each pair of source pixels
+            const uint8_t* pair = row + (sx & ~1) * 2;
+            int u = pair[1] - 128;
+            int v = pair[3] - 128;
+            int r_offset = 359 * v + 128;
+            int g_offset = -88 * u - 183 * v + 128;
+            int b_offset = 454 * u + 128;
+            if (factor == 1) {
+                *dst++ = yuv_to_rgb565(pair[0], r_offset, g_offset, b_offset);
+                if (++x < dst_width) {
+                    *dst++ = yuv_to_rgb565(pair[2], r_offset, g_offset, b_offset);
+                    x++;
+                    sx++;
+                }
+            } else {
+                *dst++ = yuv_to_rgb565(pair[(sx & 1) * 2], r_offset, g_offset, b_offset);
+                x++;
+            }
+        }
+    }
+}
+
+void pixel_rgb888_to_rgb565(uint16_t* dst, int dst_width, int dst_height,
+                            const uint8_t* src, int src_width, int factor) {
+    for (int y = 0; y < dst_height; y++) {
+        const uint8_t* p = src + (size_t)y * factor * src_width * 3;
+        for (int x = 0; x < dst_width; x++, p += factor * 3) {
+            *dst++ = (uint16_t)(((p[0] & 0xf8) << 8) | ((p[1] & 0xfc) << 3) | (p[2] >> 3));
+        }
+    }
+}
+
+static inline uint32_t abs_diff(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+static inline uint32_t is_clipped(uint32_t luma) {
+    return luma <= 8 || luma >= 247;
+}
+
+void pixel_luma_stats8(const uint8_t* src, int width, int height, int pixel_stride, int row_step,
+                       pixel_luma_stats_t* stats) {
+    uint32_t samples = 0, sum = 0, gradient = 0, clipped = 0;
+    for (int y = 0; y < height; y += row_step) {
+        const uint8_t* row = src + (size_t)y * width * pixel_stride;
+        uint32_t prev = row[0];
+        int x = 0;
+        if (pixel_stride == 2 && ((uintptr_t)row & 3) == 0) {
+            // YUYV: one word holds the luma of two pixels
+            auto words = reinterpret_cast<const pixel_word_t*>(row);
+            for (; x + 2 <= width; x += 2) {
+                uint32_t w = words[x / 2];
+                uint32_t y0 = w & 0xff;
+                uint32_t y1 = (w >> 16) & 0xff;
+                gradient += abs_diff(y0, prev) + abs_diff(y1, y0);
+                sum += y0 + y1;
+                clipped += is_clipped(y0) + is_clipped(y1);
+                prev = y1;
+            }
+        }
+        for (; x < width; x++) {
+            uint32_t v = row[x * pixel_stride];
+            gradient += abs_diff(v, prev);
+            sum += v;
+            clipped += is_clipped(v);
+            prev = v;
+        }
+        samples += width;
+    }
+    stats->samples += samples;
+    stats->sum += sum;
+    stats->gradient += gradient;
+    stats->clipped += clipped;
+}
+
+void pixel_luma_stats565(const uint16_t* src, int width, int height, bool big_endian, int row_step,
+                         pixel_luma_stats_t* stats) {
+    uint32_t samples = 0, sum = 0, gradient = 0, clipped = 0;
+    for (int y = 0; y < height; y += row_step) {
+        const uint16_t* row = src + (size_t)y * width;
+        uint32_t prev = 0;
+        for (int x = 0; x < width; x++) {
+            uint32_t pixel = big_endian ? __builtin_bswap16(row[x]) : row[x];
+            uint32_t v = ((pixel >> 5) & 0x3f) << 2;
+            if (x == 0) {
+                prev = v;
+            }
+            gradient += abs_diff(v, prev);
+            sum += v;
+            clipped += is_clipped(v);
+            prev = v;
+        }
+        samples += width;
+    }
+    stats->samples += samples;
+    stats->sum += sum;
+    stats->gradient += gradient;
+    stats->clipped += clipped;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Small pixel kernels shared by the snapshot, JPEG and camera preview paths.
+// They work a 32-bit word (two pixels) at a time whenever alignment allows.
+
+// Swap the bytes of every 16-bit pixel, dst may be the same buffer as src
+void pixel_swap_bytes16(uint16_t* dst, const uint16_t* src, size_t count);
+
+// Downscale 16-bit pixels (RGB565) by an integer factor, picking the nearest pixel.
+// dst is dst_width * dst_height pixels, src rows are src_width pixels.
+void pixel_downscale16(uint16_t* dst, int dst_width, int dst_height,
+                       const uint16_t* src, int src_width, int factor);
+
+// Convert YUYV (Y0 U Y1 V) to little endian RGB565 while downscaling by an integer factor.
+// Factor 1 converts at full size. Same dst and src layout as pixel_downscale16.
+void pixel_yuyv_to_rgb565(uint16_t* dst, int dst_width, int dst_height,
+                          const uint8_t* src, int src_width, int factor);
+
+// Convert RGB888 (R G B bytes) to little endian RGB565 while downscaling by an integer factor.
+// Same dst and src layout as pixel_downscale16.
+void pixel_rgb888_to_rgb565(uint16_t* dst, int dst_width, int dst_height,
+                            const uint8_t* src, int src_width, int factor);
+
+// Luma statistics used to pick the sharpest, best exposed frame of a burst
+typedef struct {
+    uint32_t samples;   // Number of luma samples taken
+    uint32_t sum;       // Sum of the samples
+    uint32_t gradient;  // Sum of absolute differences between horizontal neighbours
+    uint32_t clipped;   // Samples that are nearly black or nearly white
+} pixel_luma_stats_t;
+
+// Accumulate luma statistics of every row_step-th row into stats.
+// Luma is one byte every pixel_stride bytes: 1 for GREY, 2 for YUYV (src pointing at Y0).
+void pixel_luma_stats8(const uint8_t* src, int width, int height, int pixel_stride, int row_step,
+                       pixel_luma_stats_t* stats);
+
+// Same as pixel_luma_stats8 for RGB565 pixels, using the green channel as luma
+void pixel_luma_stats565(const uint16_t* src, int width, int height, bool big_endian, int row_step,
+                         pixel_luma_stats_t* stats);
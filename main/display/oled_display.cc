@@ -84,6 +84,7 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
 }
 
 OledDisplay::~OledDisplay() {
+    ui_updates_.Stop();
     if (content_ != nullptr) {
         lv_obj_del(content_);
     }
@@ -33,6 +33,7 @@ public:
     ~OledDisplay();
 
     virtual void SetChatMessage(const char* role, const char* content) override;
+    virtual int subtitle_batch_ms() const override { return CONFIG_SUBTITLE_BATCH_MS; }
     virtual void SetEmotion(const char* emotion) override;
     virtual void SetTheme(Theme* theme) override;
 };
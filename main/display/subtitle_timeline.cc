@@ -0,0 +1,152 @@
+#include "subtitle_timeline.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+
+// Latin sentences need a space in between, CJK text is joined directly
+static bool NeedsSpace(char last, char next) {
+    return last != '\0' && (uint8_t)last < 0x80 && last != ' ' &&
+        (uint8_t)next < 0x80 && next != ' ';
+}
+
+static void AppendText(std::string& text, char last, const std::string& sentence) {
+    if (sentence.empty()) {
+        return;
+    }
+    if (NeedsSpace(text.empty() ? last : text.back(), sentence.front())) {
+        text += ' ';
+    }
+    text += sentence;
+}
+
+void SubtitleTimeline::AddSink(int batch_ms, SinkCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sinks_.push_back({batch_ms, std::move(callback)});
+}
+
+void SubtitleTimeline::Start() {
+    std::vector<Update> updates;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Whatever the previous turn did not get to show is shown before the new one replaces it
+        FlushAll(updates);
+        NextTurn();
+        finished_ = false;
+        for (auto& sink : sinks_) {
+            sink.new_turn = true;
+        }
+    }
+    for (auto& update : updates) {
+        update.callback(update.text, update.new_turn);
+    }
+}
+
+void SubtitleTimeline::Finish() {
+    std::vector<Update> updates;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+        // Nothing more arrives to batch with the text already revealed
+        Pump(updates, true);
+    }
+    for (auto& update : updates) {
+        update.callback(update.text, update.new_turn);
+    }
+}
+
+void SubtitleTimeline::Clear() {
+    std::vector<Update> updates;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Playback may have been cut short (aborted, decoder reset), the text is still shown
+        FlushAll(updates);
+        NextTurn();
+    }
+    for (auto& update : updates) {
+        update.callback(update.text, update.new_turn);
+    }
+}
+
+void SubtitleTimeline::AddSentence(const std::string& text) {
+    std::vector<Update> updates;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sentences_.push_back({received_ms_, text});
+        Pump(updates);
+    }
+    for (auto& update : updates) {
+        update.callback(update.text, update.new_turn);
+    }
+}
+
+uint32_t SubtitleTimeline::NextAudioPosition(int duration_ms, uint32_t& turn) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    turn = turn_;
+    return received_ms_ + duration_ms;
+}
+
+void SubtitleTimeline::AddAudio(uint32_t turn, uint32_t position_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The turn changed while the packet was being queued
+    if (turn != turn_) {
+        return;
+    }
+    received_ms_ = position_ms;
+}
+
+void SubtitleTimeline::OnPlayback(uint32_t turn, uint32_t position_ms) {
+    std::vector<Update> updates;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Late packets of an earlier turn, their positions say nothing about this one
+        if (turn != turn_ || position_ms > received_ms_) {
+            return;
+        }
+        played_ms_ = position_ms;
+        Pump(updates);
+    }
+    for (auto& update : updates) {
+        update.callback(update.text, update.new_turn);
+    }
+}
+
+void SubtitleTimeline::NextTurn() {
+    turn_ = turn_ == UINT32_MAX ? 1 : turn_ + 1;
+    received_ms_ = 0;
+    played_ms_ = 0;
+}
+
+void SubtitleTimeline::FlushAll(std::vector<Update>& updates) {
+    played_ms_ = received_ms_;
+    for (auto& sentence : sentences_) {
+        played_ms_ = std::max(played_ms_, sentence.position_ms);
+    }
+    Pump(updates, true);
+}
+
+void SubtitleTimeline::Pump(std::vector<Update>& updates, bool flush) {
+    while (!sentences_.empty() && sentences_.front().position_ms <= played_ms_) {
+        for (auto& sink : sinks_) {
+            AppendText(sink.pending, sink.new_turn ? '\0' : sink.last_char, sentences_.front().text);
+        }
+        sentences_.pop_front();
+    }
+
+    // Everything of a finished turn has been played, nothing more will be batched with it
+    bool drained = flush || (finished_ && sentences_.empty() && played_ms_ >= received_ms_);
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    for (auto& sink : sinks_) {
+        if (sink.pending.empty()) {
+            continue;
+        }
+        if (!drained && sink.batch_ms > 0 && now_ms - sink.last_flush_ms < sink.batch_ms) {
+            continue;
+        }
+        sink.last_char = sink.pending.back();
+        updates.push_back({sink.callback, std::move(sink.pending), sink.new_turn});
+        sink.pending.clear();
+        sink.new_turn = false;
+        sink.last_flush_ms = now_ms;
+    }
+}
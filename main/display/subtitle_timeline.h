@@ -0,0 +1,80 @@
+#ifndef SUBTITLE_TIMELINE_H
+#define SUBTITLE_TIMELINE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Shows TTS sentences when their audio is played rather than when the text arrives.
+ *
+ * Every sentence is keyed by the position of the TTS stream it starts at, which is the
+ * total duration of the audio packets received before it. Packets carry the position
+ * they end at (AudioStreamPacket::stream_position_ms) through decoding, and the output
+ * task reports it back once the packet has been played, revealing the sentences it
+ * reached. Positions restart at every turn, so packets also carry the turn they belong to
+ * (stream_turn) and positions reported for an earlier turn are ignored.
+ *
+ * Revealed text goes to sinks. A sink with a batch interval collects the sentences
+ * revealed within the interval into one update, so slow panels redraw once per visible
+ * change instead of once per sentence. The first update of a turn has new_turn set, later
+ * ones carry the separating space so they can be appended as they are.
+ */
+class SubtitleTimeline {
+public:
+    using SinkCallback = std::function<void(const std::string& text, bool new_turn)>;
+
+    // Sinks are added once at startup, batch_ms 0 updates on every sentence
+    void AddSink(int batch_ms, SinkCallback callback);
+
+    // A new TTS turn, what is left of the previous one is shown at once
+    void Start();
+    // The server finished sending the turn, revealed text is sent out without waiting for
+    // the batch interval and the rest follows playback
+    void Finish();
+    // Playback is over, shows the sentences it did not reach and resets the stream
+    void Clear();
+
+    void AddSentence(const std::string& text);
+    // Returns the stream position at the end of an audio packet of the given duration and
+    // the turn it belongs to
+    uint32_t NextAudioPosition(int duration_ms, uint32_t& turn) const;
+    void AddAudio(uint32_t turn, uint32_t position_ms);
+    void OnPlayback(uint32_t turn, uint32_t position_ms);
+
+private:
+    struct Sentence {
+        uint32_t position_ms;
+        std::string text;
+    };
+    struct Sink {
+        int batch_ms;
+        SinkCallback callback;
+        std::string pending;
+        int64_t last_flush_ms = 0;
+        char last_char = '\0';
+        bool new_turn = true;
+    };
+    struct Update {
+        SinkCallback callback;
+        std::string text;
+        bool new_turn;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Sink> sinks_;
+    std::deque<Sentence> sentences_;
+    uint32_t turn_ = 1;  // Never 0, which marks audio outside of the TTS stream
+    uint32_t received_ms_ = 0;
+    uint32_t played_ms_ = 0;
+    bool finished_ = false;
+
+    void Pump(std::vector<Update>& updates, bool flush = false);
+    void FlushAll(std::vector<Update>& updates);
+    void NextTurn();
+};
+
+#endif // SUBTITLE_TIMELINE_H
@@ -0,0 +1,132 @@
+#include "ui_update_channel.h"
+#include "display.h"
+
+#include <esp_log.h>
+#include <freertos/task.h>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#define TAG "UiUpdateChannel"
+
+UiUpdateChannel::UiUpdateChannel(Display* display, int interval_ms)
+    : display_(display), interval_ms_(interval_ms) {
+}
+
+UiUpdateChannel::~UiUpdateChannel() {
+    Stop();
+}
+
+void UiUpdateChannel::OnTimer(void* arg) {
+    auto channel = static_cast<UiUpdateChannel*>(arg);
+    portENTER_CRITICAL(&channel->lock_);
+    bool stopped = channel->stopped_;
+    channel->posting_ = !stopped;
+    portEXIT_CRITICAL(&channel->lock_);
+    if (stopped) {
+        return;
+    }
+
+    // Applying a slot may lay out a long message, which belongs on the display task
+    channel->display_->RunOnUiTask(DrainOnUiTask, channel);
+
+    portENTER_CRITICAL(&channel->lock_);
+    channel->posting_ = false;
+    portEXIT_CRITICAL(&channel->lock_);
+}
+
+void UiUpdateChannel::DrainOnUiTask(void* arg) {
+    static_cast<UiUpdateChannel*>(arg)->Drain();
+}
+
+void UiUpdateChannel::Post(UiSlot slot, const char* format, ...) {
+    char text[kMaxTextLength];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    bool arm;
+    portENTER_CRITICAL(&lock_);
+    if (stopped_) {
+        portEXIT_CRITICAL(&lock_);
+        return;
+    }
+    memcpy(slots_[slot].text, text, sizeof(text));
+    slots_[slot].dirty = true;
+    arm = !armed_;
+    armed_ = true;
+    portEXIT_CRITICAL(&lock_);
+
+    // Later posts within the interval only replace the text
+    if (!arm) {
+        return;
+    }
+    // Only the poster that armed gets here until the drain, so creating the timer cannot race
+    if (timer_ == nullptr) {
+        esp_timer_create_args_t timer_args = {
+            .callback = OnTimer,
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "ui_update_timer",
+            .skip_unhandled_events = true,
+        };
+        if (esp_timer_create(&timer_args, &timer_) != ESP_OK) {
+            timer_ = nullptr;
+        }
+    }
+    if (timer_ == nullptr || esp_timer_start_once(timer_, interval_ms_ * 1000) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to start the update timer");
+        portENTER_CRITICAL(&lock_);
+        armed_ = false;
+        portEXIT_CRITICAL(&lock_);
+    }
+}
+
+void UiUpdateChannel::Stop() {
+    portENTER_CRITICAL(&lock_);
+    bool stopped = stopped_;
+    stopped_ = true;
+    portEXIT_CRITICAL(&lock_);
+    if (stopped) {
+        return;
+    }
+
+    if (timer_ != nullptr) {
+        esp_timer_stop(timer_);
+        // A callback already past the stopped_ check is still queueing its drain
+        while (true) {
+            portENTER_CRITICAL(&lock_);
+            bool posting = posting_;
+            portEXIT_CRITICAL(&lock_);
+            if (!posting) {
+                break;
+            }
+            vTaskDelay(1);
+        }
+        esp_timer_delete(timer_);
+        timer_ = nullptr;
+    }
+    display_->CancelOnUiTask(DrainOnUiTask, this);
+}
+
+void UiUpdateChannel::Drain() {
+    Slot slots[kUiSlotCount];
+    portENTER_CRITICAL(&lock_);
+    memcpy(slots, slots_, sizeof(slots));
+    for (auto& slot : slots_) {
+        slot.dirty = false;
+    }
+    armed_ = false;
+    portEXIT_CRITICAL(&lock_);
+
+    if (slots[kUiSlotStatus].dirty) {
+        display_->SetStatus(slots[kUiSlotStatus].text);
+    }
+    if (slots[kUiSlotChatMessage].dirty) {
+        display_->SetChatMessage("system", slots[kUiSlotChatMessage].text);
+    }
+    if (slots[kUiSlotNotification].dirty) {
+        display_->ShowNotification(slots[kUiSlotNotification].text);
+    }
+}
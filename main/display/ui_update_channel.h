@@ -0,0 +1,56 @@
+#ifndef UI_UPDATE_CHANNEL_H
+#define UI_UPDATE_CHANNEL_H
+
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+
+class Display;
+
+enum UiSlot {
+    kUiSlotStatus,
+    kUiSlotChatMessage,
+    kUiSlotNotification,
+    kUiSlotCount
+};
+
+/*
+ * Latest-value UI updates for long-running operations such as OTA and asset downloads.
+ * Each slot keeps only the newest text, posting copies it into a fixed buffer without
+ * allocating, and a timer hands the dirty slots to the display task at most once per
+ * interval, so a burst of progress callbacks costs a single redraw. The timer is only
+ * created by the first post, most displays never get one.
+ */
+class UiUpdateChannel {
+public:
+    static constexpr size_t kMaxTextLength = 64;
+
+    UiUpdateChannel(Display* display, int interval_ms = 200);
+    ~UiUpdateChannel();
+
+    // Safe to call from any task
+    void Post(UiSlot slot, const char* format, ...) __attribute__((format(printf, 3, 4)));
+    // Drop pending updates and cancel a drain queued on the display task. The display calls
+    // this before tearing down what Drain touches, later posts are ignored.
+    void Stop();
+
+private:
+    struct Slot {
+        char text[kMaxTextLength];
+        bool dirty;
+    };
+
+    Display* display_;
+    int interval_ms_;
+    esp_timer_handle_t timer_ = nullptr;
+    portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+    Slot slots_[kUiSlotCount] = {};
+    bool armed_ = false;
+    bool posting_ = false;  // The timer is handing a drain to the display task
+    bool stopped_ = false;
+
+    static void OnTimer(void* arg);
+    static void DrainOnUiTask(void* arg);
+    void Drain();
+};
+
+#endif // UI_UPDATE_CHANNEL_H
@@ -0,0 +1,342 @@
+#include "heap_profiler.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#define TAG "HeapProfiler"
+
+#define SITE_COUNT      CONFIG_HEAP_PROFILER_SITES
+#define BLOCK_COUNT     CONFIG_HEAP_PROFILER_TRACKED_BLOCKS
+#define OTHER_SITE      0   // Shared by the call sites that don't fit in the table
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+void* __real_heap_caps_malloc(size_t size, uint32_t caps);
+void* __real_heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void* __real_heap_caps_realloc(void* ptr, size_t size, uint32_t caps);
+void __real_heap_caps_free(void* ptr);
+void* __real__Znwj(size_t size);
+void* __real__Znaj(size_t size);
+}
+
+namespace {
+
+struct Site {
+    uint32_t pc;
+    uint32_t live_bytes;
+    uint32_t live_blocks;
+    uint32_t total_allocs;
+    uint32_t last_allocs[HeapProfiler::kConsumerCount];   // total_allocs at each consumer's previous dump
+};
+
+struct Block {
+    void* ptr;
+    uint32_t size;
+    uint16_t site;
+};
+
+Site* sites = nullptr;
+Block* blocks = nullptr;
+volatile bool started = false;
+uint32_t untracked_blocks = 0;
+int64_t last_dump_time[HeapProfiler::kConsumerCount] = {};
+portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Call site of the operator new being served, so the inner malloc is charged to its caller
+__thread uint32_t new_caller_pc = 0;
+
+IRAM_ATTR inline uint32_t Hash(uintptr_t key, uint32_t count) {
+    return (uint32_t)((key >> 2) * 2654435761u) % count;
+}
+
+IRAM_ATTR uint16_t FindSite(uint32_t pc) {
+    uint32_t index = 1 + Hash(pc, SITE_COUNT - 1);
+    for (int probe = 1; probe < SITE_COUNT; probe++) {
+        auto& site = sites[index];
+        if (site.pc == pc) {
+            return index;
+        }
+        if (site.pc == 0) {
+            site.pc = pc;
+            return index;
+        }
+        index = index + 1 < SITE_COUNT ? index + 1 : 1;
+    }
+    return OTHER_SITE;
+}
+
+IRAM_ATTR void InsertBlock(void* ptr, uint32_t size, uint16_t site) {
+    uint32_t index = Hash((uintptr_t)ptr, BLOCK_COUNT);
+    for (int probe = 0; probe < BLOCK_COUNT; probe++) {
+        auto& block = blocks[index];
+        if (block.ptr == nullptr) {
+            block = {ptr, size, site};
+            return;
+        }
+        index = (index + 1) % BLOCK_COUNT;
+    }
+    untracked_blocks++;
+}
+
+// Removes the block and returns it, backward shift deletion keeps the probe chains intact
+IRAM_ATTR bool RemoveBlock(void* ptr, Block& removed) {
+    uint32_t index = Hash((uintptr_t)ptr, BLOCK_COUNT);
+    for (int probe = 0; probe < BLOCK_COUNT; probe++) {
+        if (blocks[index].ptr == nullptr) {
+            return false;
+        }
+        if (blocks[index].ptr == ptr) {
+            removed = blocks[index];
+            uint32_t hole = index;
+            uint32_t next = (index + 1) % BLOCK_COUNT;
+            while (blocks[next].ptr != nullptr) {
+                uint32_t home = Hash((uintptr_t)blocks[next].ptr, BLOCK_COUNT);
+                // Move the entry back if its home slot is not between the hole and itself
+                bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+                if (movable) {
+                    blocks[hole] = blocks[next];
+                    hole = next;
+                }
+                next = (next + 1) % BLOCK_COUNT;
+            }
+            blocks[hole].ptr = nullptr;
+            return true;
+        }
+        index = (index + 1) % BLOCK_COUNT;
+    }
+    return false;
+}
+
+IRAM_ATTR void Track(void* ptr, size_t size, uint32_t pc) {
+    if (!started || ptr == nullptr) {
+        return;
+    }
+    if (new_caller_pc != 0) {
+        pc = new_caller_pc;
+        new_caller_pc = 0;
+    }
+    portENTER_CRITICAL_SAFE(&lock);
+    uint16_t index = FindSite(pc);
+    auto& site = sites[index];
+    site.live_bytes += size;
+    site.live_blocks++;
+    site.total_allocs++;
+    InsertBlock(ptr, size, index);
+    portEXIT_CRITICAL_SAFE(&lock);
+}
+
+IRAM_ATTR void Untrack(void* ptr) {
+    if (!started || ptr == nullptr) {
+        return;
+    }
+    Block block;
+    portENTER_CRITICAL_SAFE(&lock);
+    if (RemoveBlock(ptr, block)) {
+        auto& site = sites[block.site];
+        site.live_bytes -= block.size;
+        site.live_blocks--;
+    }
+    portEXIT_CRITICAL_SAFE(&lock);
+}
+
+IRAM_ATTR inline uint32_t CallerPc(void* return_address) {
+    return esp_cpu_process_stack_pc((uintptr_t)return_address);
+}
+
+struct CapsInfo {
+    const char* name;
+    uint32_t caps;
+};
+
+const CapsInfo kCapsList[] = {
+    { "internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+    { "dma",      MALLOC_CAP_DMA },
+    { "spiram",   MALLOC_CAP_SPIRAM },
+};
+
+// Copies the busiest sites out of the lock sorted by live bytes, returns how many were copied.
+// The copies carry the consumer's previous baseline, which moves on to the current count.
+int Snapshot(Site* top, int count, uint32_t& untracked, HeapProfiler::Consumer consumer) {
+    portENTER_CRITICAL(&lock);
+    int n = 0;
+    for (int i = 0; i < SITE_COUNT; i++) {
+        auto& site = sites[i];
+        if (site.pc != 0 || (i == OTHER_SITE && site.total_allocs > 0)) {
+            // Insertion into the short sorted list, no allocation while holding the lock
+            int pos = n < count ? n++ : count;
+            while (pos > 0 && top[pos - 1].live_bytes < site.live_bytes) {
+                if (pos < count) {
+                    top[pos] = top[pos - 1];
+                }
+                pos--;
+            }
+            if (pos < count) {
+                top[pos] = site;
+            }
+        }
+        site.last_allocs[consumer] = site.total_allocs;
+    }
+    untracked = untracked_blocks;
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
+
+}  // namespace
+
+extern "C" {
+
+void* IRAM_ATTR __wrap_malloc(size_t size) {
+    void* ptr = __real_malloc(size);
+    Track(ptr, size, CallerPc(__builtin_return_address(0)));
+    return ptr;
+}
+
+void* IRAM_ATTR __wrap_calloc(size_t n, size_t size) {
+    void* ptr = __real_calloc(n, size);
+    Track(ptr, n * size, CallerPc(__builtin_return_address(0)));
+    return ptr;
+}
+
+void* IRAM_ATTR __wrap_realloc(void* ptr, size_t size) {
+    void* new_ptr = __real_realloc(ptr, size);
+    if (new_ptr != nullptr || size == 0) {
+        Untrack(ptr);
+        Track(new_ptr, size, CallerPc(__builtin_return_address(0)));
+    }
+    return new_ptr;
+}
+
+void IRAM_ATTR __wrap_free(void* ptr) {
+    Untrack(ptr);
+    __real_free(ptr);
+}
+
+void* IRAM_ATTR __wrap_heap_caps_malloc(size_t size, uint32_t caps) {
+    void* ptr = __real_heap_caps_malloc(size, caps);
+    Track(ptr, size, CallerPc(__builtin_return_address(0)));
+    return ptr;
+}
+
+void* IRAM_ATTR __wrap_heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    void* ptr = __real_heap_caps_calloc(n, size, caps);
+    Track(ptr, n * size, CallerPc(__builtin_return_address(0)));
+    return ptr;
+}
+
+void* IRAM_ATTR __wrap_heap_caps_realloc(void* ptr, size_t size, uint32_t caps) {
+    void* new_ptr = __real_heap_caps_realloc(ptr, size, caps);
+    if (new_ptr != nullptr || size == 0) {
+        Untrack(ptr);
+        Track(new_ptr, size, CallerPc(__builtin_return_address(0)));
+    }
+    return new_ptr;
+}
+
+void IRAM_ATTR __wrap_heap_caps_free(void* ptr) {
+    Untrack(ptr);
+    __real_heap_caps_free(ptr);
+}
+
+void* IRAM_ATTR __wrap__Znwj(size_t size) {
+    new_caller_pc = CallerPc(__builtin_return_address(0));
+    void* ptr = __real__Znwj(size);
+    new_caller_pc = 0;
+    return ptr;
+}
+
+void* IRAM_ATTR __wrap__Znaj(size_t size) {
+    new_caller_pc = CallerPc(__builtin_return_address(0));
+    void* ptr = __real__Znaj(size);
+    new_caller_pc = 0;
+    return ptr;
+}
+
+}  // extern "C"
+
+void HeapProfiler::Start() {
+    if (started) {
+        return;
+    }
+    // The tables themselves are not tracked. They are updated from the allocators, which may
+    // run while the cache is disabled, so they can't live in PSRAM.
+    uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    sites = (Site*)__real_heap_caps_calloc(SITE_COUNT, sizeof(Site), caps);
+    blocks = (Block*)__real_heap_caps_calloc(BLOCK_COUNT, sizeof(Block), caps);
+    if (sites == nullptr || blocks == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the profiler tables");
+        __real_heap_caps_free(sites);
+        __real_heap_caps_free(blocks);
+        return;
+    }
+    for (auto& time : last_dump_time) {
+        time = esp_timer_get_time();
+    }
+    started = true;
+    ESP_LOGI(TAG, "Tracking up to %d call sites and %d live blocks", SITE_COUNT, BLOCK_COUNT);
+}
+
+cJSON* HeapProfiler::GetHotspotsJson(int top, Consumer consumer) {
+    auto json = cJSON_CreateObject();
+    if (!started) {
+        cJSON_AddStringToObject(json, "error", "Heap profiler is not running");
+        return json;
+    }
+
+    top = std::clamp(top, 1, 64);
+    Site snapshot[64];
+    uint32_t untracked;
+    int count = Snapshot(snapshot, top, untracked, consumer);
+    int64_t now = esp_timer_get_time();
+    float elapsed_s = (now - last_dump_time[consumer]) / 1000000.0f;
+    last_dump_time[consumer] = now;
+
+    cJSON_AddNumberToObject(json, "interval_s", elapsed_s);
+    cJSON_AddNumberToObject(json, "untracked_blocks", untracked);
+    auto sites_json = cJSON_AddArrayToObject(json, "sites");
+    for (int i = 0; i < count; i++) {
+        auto& site = snapshot[i];
+        char pc[12];
+        snprintf(pc, sizeof(pc), "0x%08lx", site.pc);
+        auto item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "pc", site.pc == 0 ? "other" : pc);
+        cJSON_AddNumberToObject(item, "live_bytes", site.live_bytes);
+        cJSON_AddNumberToObject(item, "live_blocks", site.live_blocks);
+        cJSON_AddNumberToObject(item, "allocs_per_s", elapsed_s > 0 ? (site.total_allocs - site.last_allocs[consumer]) / elapsed_s : 0);
+        cJSON_AddItemToArray(sites_json, item);
+    }
+
+    auto heaps = cJSON_AddArrayToObject(json, "heaps");
+    for (auto& caps : kCapsList) {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, caps.caps);
+        auto item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "caps", caps.name);
+        cJSON_AddNumberToObject(item, "free", info.total_free_bytes);
+        cJSON_AddNumberToObject(item, "largest_free_block", info.largest_free_block);
+        cJSON_AddNumberToObject(item, "min_free", info.minimum_free_bytes);
+        cJSON_AddNumberToObject(item, "free_blocks", info.free_blocks);
+        cJSON_AddItemToArray(heaps, item);
+    }
+    return json;
+}
+
+void HeapProfiler::PrintHotspots(int top) {
+    auto json = GetHotspotsJson(top, kConsumerLog);
+    auto text = cJSON_PrintUnformatted(json);
+    if (text != nullptr) {
+        // One line per dump so scripts/heap_hotspots.py can pick it out of a log
+        ESP_LOGI(TAG, "HEAP_HOTSPOTS %s", text);
+        cJSON_free(text);
+    }
+    cJSON_Delete(json);
+}
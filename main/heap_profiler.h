@@ -0,0 +1,32 @@
+#ifndef _HEAP_PROFILER_H_
+#define _HEAP_PROFILER_H_
+
+#include <cJSON.h>
+
+/*
+ * Attributes heap usage to the code that allocates it. In this build mode malloc, calloc,
+ * realloc, free, their heap_caps variants and operator new are wrapped at link time. Each
+ * allocation is tagged with its return address, and two fixed open addressing tables keep
+ * the live bytes per call site and the owner of each live block. The wrappers and the
+ * tables stay in internal RAM, as the allocators can run while the flash cache is off.
+ *
+ * Allocations made before Start are not tracked. Dumps carry raw code addresses,
+ * symbolize them with scripts/heap_hotspots.py and the firmware ELF.
+ */
+class HeapProfiler {
+public:
+    // Each reader of the allocation rates keeps its own baseline
+    enum Consumer {
+        kConsumerLog,
+        kConsumerMcp,
+        kConsumerCount
+    };
+
+    static void Start();
+    // The top call sites by live bytes with their allocation rate since this consumer's
+    // previous dump, and the free size and largest free block per heap capability
+    static cJSON* GetHotspotsJson(int top, Consumer consumer);
+    static void PrintHotspots(int top);
+};
+
+#endif // _HEAP_PROFILER_H_
@@ -1,16 +1,29 @@
 #include "circular_strip.h"
 #include "application.h"
 #include <esp_log.h>
+#include <soc/soc_caps.h>
+#include <algorithm>
 
 #define TAG "CircularStrip"
 
-#define BLINK_INFINITE -1
+static bool SameColor(const StripColor& a, const StripColor& b) {
+    return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+static StripColor MixColor(StripColor low, StripColor high, uint8_t level) {
+    return {
+        (uint8_t)(low.red + (high.red - low.red) * level / 255),
+        (uint8_t)(low.green + (high.green - low.green) * level / 255),
+        (uint8_t)(low.blue + (high.blue - low.blue) * level / 255),
+    };
+}
 
 CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds) {
     // If the gpio is not connected, you should use NoLed class
     assert(gpio != GPIO_NUM_NC);
 
     colors_.resize(max_leds_);
+    shown_.resize(max_leds_);
 
     led_strip_config_t strip_config = {};
     strip_config.strip_gpio_num = gpio;
@@ -20,28 +33,24 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
 
     led_strip_rmt_config_t rmt_config = {};
     rmt_config.resolution_hz = 10 * 1000 * 1000; // 10MHz
-
+#if SOC_RMT_SUPPORT_DMA
+    // Let DMA feed the whole frame instead of refilling the RMT memory from the ISR
+    rmt_config.mem_block_symbols = 1024;
+    rmt_config.flags.with_dma = true;
+    if (led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_) != ESP_OK) {
+        ESP_LOGW(TAG, "RMT DMA channel unavailable, falling back to the ISR refill");
+        rmt_config.mem_block_symbols = 0;
+        rmt_config.flags.with_dma = false;
+        ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
+    }
+#else
     ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
+#endif
     led_strip_clear(led_strip_);
-
-    esp_timer_create_args_t strip_timer_args = {
-        .callback = [](void *arg) {
-            auto strip = static_cast<CircularStrip*>(arg);
-            std::lock_guard<std::mutex> lock(strip->mutex_);
-            if (strip->strip_callback_ != nullptr) {
-                strip->strip_callback_();
-            }
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "strip_timer",
-        .skip_unhandled_events = false,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&strip_timer_args, &strip_timer_));
 }
 
 CircularStrip::~CircularStrip() {
-    esp_timer_stop(strip_timer_);
+    LedEffectEngine::GetInstance().Detach(this);
     if (led_strip_ != nullptr) {
         led_strip_del(led_strip_);
     }
@@ -50,130 +59,152 @@ CircularStrip::~CircularStrip() {
 
 void CircularStrip::SetAllColor(StripColor color) {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
+    StopEffect();
     for (int i = 0; i < max_leds_; i++) {
         colors_[i] = color;
-        led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
     }
-    led_strip_refresh(led_strip_);
+    PushFrame();
 }
 
 void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
+    StopEffect();
     colors_[index] = color;
-    led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
-    led_strip_refresh(led_strip_);
+    PushFrame();
 }
 
 void CircularStrip::Blink(StripColor color, int interval_ms) {
-    for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = color;
-    }
-    StartStripTask(interval_ms, [this]() {
-        static bool on = true;
-        if (on) {
-            for (int i = 0; i < max_leds_; i++) {
-                led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-            }
-            led_strip_refresh(led_strip_);
-        } else {
-            led_strip_clear(led_strip_);
-        }
-        on = !on;
-    });
+    std::lock_guard<std::mutex> lock(mutex_);
+    palette_ = { color, StripColor() };
+    StartEffect(kEffectBlink, interval_ms);
 }
 
 void CircularStrip::FadeOut(int interval_ms) {
-    StartStripTask(interval_ms, [this]() {
-        bool all_off = true;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i].red /= 2;
-            colors_[i].green /= 2;
-            colors_[i].blue /= 2;
-            if (colors_[i].red != 0 || colors_[i].green != 0 || colors_[i].blue != 0) {
-                all_off = false;
-            }
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        if (all_off) {
-            led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
-        } else {
-            led_strip_refresh(led_strip_);
-        }
-    });
+    std::lock_guard<std::mutex> lock(mutex_);
+    StartEffect(kEffectFadeOut, interval_ms);
 }
 
 void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
-    StartStripTask(interval_ms, [this, low, high]() {
-        static bool increase = true;
-        static StripColor color = low;
-        if (increase) {
-            if (color.red < high.red) {
-                color.red++;
-            }
-            if (color.green < high.green) {
-                color.green++;
-            }
-            if (color.blue < high.blue) {
-                color.blue++;
-            }
-            if (color.red == high.red && color.green == high.green && color.blue == high.blue) {
-                increase = false;
-            }
-        } else {
-            if (color.red > low.red) {
-                color.red--;
+    std::lock_guard<std::mutex> lock(mutex_);
+    palette_.resize(LedEffectEngine::kBreatheSteps);
+    for (int i = 0; i < LedEffectEngine::kBreatheSteps; i++) {
+        palette_[i] = MixColor(low, high, LedEffectEngine::BreatheLevel(i));
+    }
+    StartEffect(kEffectBreathe, interval_ms);
+}
+
+void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    palette_.assign(max_leds_, low);
+    for (int j = 0; j < length && j < max_leds_; j++) {
+        palette_[j] = high;
+    }
+    StartEffect(kEffectScroll, interval_ms);
+}
+
+void CircularStrip::FollowVoice(int interval_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StripColor color = { default_brightness_, low_brightness_, low_brightness_ };
+    StripColor bright = { (uint8_t)std::min(255, default_brightness_ * 2), low_brightness_, low_brightness_ };
+    palette_ = { color, bright };
+    StartEffect(kEffectVoice, interval_ms);
+}
+
+// Caller holds mutex_
+void CircularStrip::StartEffect(Effect effect, int interval_ms) {
+    if (led_strip_ == nullptr) {
+        return;
+    }
+    effect_ = effect;
+    interval_ticks_ = LedEffectEngine::IntervalTicks(interval_ms);
+    countdown_ = interval_ticks_;
+    step_ = 0;
+    // Fading starts from whatever is shown, the other effects show their first frame right away
+    if (effect != kEffectFadeOut) {
+        RenderFrame();
+        PushFrame();
+    }
+    LedEffectEngine::GetInstance().Attach(this);
+}
+
+// Caller holds mutex_
+void CircularStrip::StopEffect() {
+    if (effect_ != kEffectNone) {
+        effect_ = kEffectNone;
+        LedEffectEngine::GetInstance().Detach(this);
+    }
+}
+
+void CircularStrip::OnEffectTick(uint32_t tick) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (effect_ == kEffectNone || --countdown_ > 0) {
+        return;
+    }
+    countdown_ = interval_ticks_;
+    step_++;
+    RenderFrame();
+    PushFrame();
+}
+
+// Fills colors_ with the frame of the current step, caller holds mutex_
+void CircularStrip::RenderFrame() {
+    switch (effect_) {
+        case kEffectBlink:
+        case kEffectBreathe: {
+            auto& color = palette_[step_ % palette_.size()];
+            for (int i = 0; i < max_leds_; i++) {
+                colors_[i] = color;
             }
-            if (color.green > low.green) {
-                color.green--;
+            break;
+        }
+        case kEffectScroll:
+            for (int i = 0; i < max_leds_; i++) {
+                colors_[i] = palette_[(i - step_ % max_leds_ + max_leds_) % max_leds_];
             }
-            if (color.blue > low.blue) {
-                color.blue--;
+            break;
+        case kEffectFadeOut: {
+            bool all_off = true;
+            for (int i = 0; i < max_leds_; i++) {
+                colors_[i].red /= 2;
+                colors_[i].green /= 2;
+                colors_[i].blue /= 2;
+                if (colors_[i].red != 0 || colors_[i].green != 0 || colors_[i].blue != 0) {
+                    all_off = false;
+                }
             }
-            if (color.red == low.red && color.green == low.green && color.blue == low.blue) {
-                increase = true;
+            if (all_off) {
+                StopEffect();
             }
+            break;
         }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
+        case kEffectVoice: {
+            // Brighten the ring while the VAD hears speech. The mic array is linear and only
+            // resolves +-60 degrees, so it cannot point at a spot on a 360 degree ring.
+            auto& app = Application::GetInstance();
+            bool speaking = app.IsVoiceDetected();
+            for (int i = 0; i < max_leds_; i++) {
+                colors_[i] = palette_[speaking ? 1 : 0];
+            }
+            break;
         }
-        led_strip_refresh(led_strip_);
-    });
+        default:
+            break;
+    }
 }
 
-void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
+// Sends the pixels that changed since the last refresh, caller holds mutex_
+void CircularStrip::PushFrame() {
+    bool changed = false;
     for (int i = 0; i < max_leds_; i++) {
-        colors_[i] = low;
-    }
-    StartStripTask(interval_ms, [this, low, high, length]() {
-        static int offset = 0;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i] = low;
-        }
-        for (int j = 0; j < length; j++) {
-            int i = (offset + j) % max_leds_;
-            colors_[i] = high;
-        }
-        for (int i = 0; i < max_leds_; i++) {
+        if (!SameColor(colors_[i], shown_[i])) {
             led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
+            shown_[i] = colors_[i];
+            changed = true;
         }
+    }
+    if (changed) {
         led_strip_refresh(led_strip_);
-        offset = (offset + 1) % max_leds_;
-    });
-}
-
-void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
-    if (led_strip_ == nullptr) {
-        return;
     }
-
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    
-    strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
@@ -206,6 +237,8 @@ void CircularStrip::OnStateChanged() {
             break;
         }
         case kDeviceStateListening:
+            FollowVoice(50);
+            break;
         case kDeviceStateAudioTesting: {
             StripColor color = { default_brightness_, low_brightness_, low_brightness_ };
             SetAllColor(color);
@@ -2,6 +2,7 @@
 #define _CIRCULAR_STRIP_H_
 
 #include "led.h"
+#include "led_effect_engine.h"
 #include <driver/gpio.h>
 #include <led_strip.h>
 #include <esp_timer.h>
@@ -16,7 +17,7 @@ struct StripColor {
     uint8_t red = 0, green = 0, blue = 0;
 };
 
-class CircularStrip : public Led {
+class CircularStrip : public Led, public LedEffectEngine::Client {
 public:
     CircularStrip(gpio_num_t gpio, uint8_t max_leds);
     virtual ~CircularStrip();
@@ -29,23 +30,41 @@ public:
     void Breathe(StripColor low, StripColor high, int interval_ms);
     void Scroll(StripColor low, StripColor high, int length, int interval_ms);
 
+    void OnEffectTick(uint32_t tick) override;
+
 private:
+    enum Effect {
+        kEffectNone,
+        kEffectBlink,
+        kEffectBreathe,
+        kEffectScroll,
+        kEffectFadeOut,
+        kEffectVoice,
+    };
+
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     led_strip_handle_t led_strip_ = nullptr;
     int max_leds_ = 0;
+    // The frame being rendered and the one on the strip, only differing pixels are pushed
     std::vector<StripColor> colors_;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
-    esp_timer_handle_t strip_timer_ = nullptr;
-    std::function<void()> strip_callback_ = nullptr;
+    std::vector<StripColor> shown_;
+    // Precomputed per effect: the blink on and off colors, one breathing period, or the
+    // scroll pattern at offset 0
+    std::vector<StripColor> palette_;
+    Effect effect_ = kEffectNone;
+    int interval_ticks_ = 1;
+    int countdown_ = 0;
+    int step_ = 0;
 
     uint8_t default_brightness_ = DEFAULT_BRIGHTNESS;
     uint8_t low_brightness_ = LOW_BRIGHTNESS;
 
-    void StartStripTask(int interval_ms, std::function<void()> cb);
-    void Rainbow(StripColor low, StripColor high, int interval_ms);
+    void StartEffect(Effect effect, int interval_ms);
+    void StopEffect();
+    void RenderFrame();
+    void PushFrame();
     void FadeOut(int interval_ms);
+    void FollowVoice(int interval_ms);
 };
 
 #endif // _CIRCULAR_STRIP_H_
@@ -2,12 +2,12 @@
 #include "application.h"
 #include "device_state.h"
 #include <esp_log.h>
+#include <algorithm>
 
 #define TAG "GpioLed"
 
 #define DEFAULT_BRIGHTNESS 50
 #define HIGH_BRIGHTNESS 100
-#define LOW_BRIGHTNESS 10
 
 #define IDLE_BRIGHTNESS 5
 #define SPEAKING_BRIGHTNESS 75
@@ -22,9 +22,11 @@
 #define LEDC_LS_CH0_CHANNEL    LEDC_CHANNEL_0
 
 #define LEDC_DUTY              (8191)
-#define LEDC_FADE_TIME    (1000)
 // GPIO_LED
 
+// One breathing period is kBreatheSteps of this, about two seconds
+#define BREATHE_STEP_MS        30
+
 GpioLed::GpioLed(gpio_num_t gpio)
         : GpioLed(gpio, 0, LEDC_LS_TIMER, LEDC_LS_CH0_CHANNEL) {
 }
@@ -61,45 +63,17 @@ GpioLed::GpioLed(gpio_num_t gpio, int output_invert, ledc_timer_t timer_num, led
     // Set LED Controller with previously prepared configuration
     ledc_channel_config(&ledc_channel_);
 
-    // Initialize fade service.
-    ledc_fade_func_install(0);
-
-    // When the callback registered by ledc_cb_degister is called, run led ->OnFadeEnd()
-    ledc_cbs_t ledc_callbacks = {
-        .fade_cb = FadeCallback
-    };
-    ledc_cb_register(ledc_channel_.speed_mode, ledc_channel_.channel, &ledc_callbacks, this);
-
-    esp_timer_create_args_t blink_timer_args = {
-        .callback = [](void *arg) {
-            auto led = static_cast<GpioLed*>(arg);
-            led->OnBlinkTimer();
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "Blink Timer",
-        .skip_unhandled_events = false,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&blink_timer_args, &blink_timer_));
-
     ledc_initialized_ = true;
 }
 
 GpioLed::~GpioLed() {
-    esp_timer_stop(blink_timer_);
-    if (ledc_initialized_) {
-        ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-        ledc_fade_func_uninstall();
-    }
+    LedEffectEngine::GetInstance().Detach(this);
 }
 
 
+// Brightness is a linear duty in percent, the state constants are tuned for it
 void GpioLed::SetBrightness(uint8_t brightness) {
-    if (brightness == 100) {
-        duty_ = LEDC_DUTY;
-    } else {
-        duty_ = brightness * LEDC_DUTY / 100;
-    }
+    duty_ = std::min<int>(brightness, 100) * LEDC_DUTY / 100;
 }
 
 void GpioLed::TurnOn() {
@@ -108,10 +82,8 @@ void GpioLed::TurnOn() {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
-    ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-    ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, duty_);
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    StopEffect();
+    SetDuty(duty_);
 }
 
 void GpioLed::TurnOff() {
@@ -120,10 +92,8 @@ void GpioLed::TurnOff() {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
-    ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-    ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, 0);
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    StopEffect();
+    SetDuty(0);
 }
 
 void GpioLed::BlinkOnce() {
@@ -131,72 +101,74 @@ void GpioLed::BlinkOnce() {
 }
 
 void GpioLed::Blink(int times, int interval_ms) {
-    StartBlinkTask(times, interval_ms);
+    std::lock_guard<std::mutex> lock(mutex_);
+    blink_counter_ = times * 2;
+    StartEffect(kEffectBlink, interval_ms);
 }
 
 void GpioLed::StartContinuousBlink(int interval_ms) {
-    StartBlinkTask(BLINK_INFINITE, interval_ms);
+    Blink(BLINK_INFINITE, interval_ms);
 }
 
-void GpioLed::StartBlinkTask(int times, int interval_ms) {
-    if (!ledc_initialized_) {
-        return;
-    }
-
+void GpioLed::StartBreathe() {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
-    ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-
-    blink_counter_ = times * 2;
-    blink_interval_ms_ = interval_ms;
-    esp_timer_start_periodic(blink_timer_, interval_ms * 1000);
+    StartEffect(kEffectBreathe, BREATHE_STEP_MS);
 }
 
-void GpioLed::OnBlinkTimer() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    blink_counter_--;
-    if (blink_counter_ & 1) {
-        ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, duty_);
-    } else {
-        ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, 0);
-
-        if (blink_counter_ == 0) {
-            esp_timer_stop(blink_timer_);
-        }
+// Caller holds mutex_
+void GpioLed::StartEffect(Effect effect, int interval_ms) {
+    if (!ledc_initialized_) {
+        return;
+    }
+    effect_ = effect;
+    interval_ticks_ = LedEffectEngine::IntervalTicks(interval_ms);
+    countdown_ = interval_ticks_;
+    step_ = 0;
+    LedEffectEngine::GetInstance().Attach(this);
+}
+
+// Caller holds mutex_
+void GpioLed::StopEffect() {
+    if (effect_ != kEffectNone) {
+        effect_ = kEffectNone;
+        LedEffectEngine::GetInstance().Detach(this);
     }
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
 }
 
-void GpioLed::StartFadeTask() {
-    if (!ledc_initialized_) {
+// Only touches the LEDC registers when the duty changes
+void GpioLed::SetDuty(uint32_t duty) {
+    if (duty == shown_duty_) {
         return;
     }
-
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(blink_timer_);
-    ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-    fade_up_ = true;
-    ledc_set_fade_with_time(ledc_channel_.speed_mode,
-                            ledc_channel_.channel, LEDC_DUTY, LEDC_FADE_TIME);
-    ledc_fade_start(ledc_channel_.speed_mode,
-                    ledc_channel_.channel, LEDC_FADE_NO_WAIT);
+    shown_duty_ = duty;
+    ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, duty);
+    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
 }
 
-void GpioLed::OnFadeEnd() {
+void GpioLed::OnEffectTick(uint32_t tick) {
     std::lock_guard<std::mutex> lock(mutex_);
-    fade_up_ = !fade_up_;
-    ledc_set_fade_with_time(ledc_channel_.speed_mode,
-                            ledc_channel_.channel, fade_up_ ? LEDC_DUTY : 0, LEDC_FADE_TIME);
-    ledc_fade_start(ledc_channel_.speed_mode,
-                    ledc_channel_.channel, LEDC_FADE_NO_WAIT);
-}
-
-bool IRAM_ATTR GpioLed::FadeCallback(const ledc_cb_param_t *param, void *user_arg) {
-    if (param->event == LEDC_FADE_END_EVT) {
-        auto led = static_cast<GpioLed*>(user_arg);
-        led->OnFadeEnd();
+    if (effect_ == kEffectNone || --countdown_ > 0) {
+        return;
+    }
+    countdown_ = interval_ticks_;
+
+    if (effect_ == kEffectBlink) {
+        blink_counter_--;
+        if (blink_counter_ & 1) {
+            SetDuty(duty_);
+        } else {
+            SetDuty(0);
+            if (blink_counter_ == 0) {
+                StopEffect();
+            }
+        }
+    } else {
+        // The peak follows the VAD while listening, gamma is only in the breathing curve
+        auto& app = Application::GetInstance();
+        uint8_t peak = app.IsVoiceDetected() ? HIGH_BRIGHTNESS : DEFAULT_BRIGHTNESS;
+        uint32_t peak_duty = peak * LEDC_DUTY / 100;
+        SetDuty(peak_duty * LedEffectEngine::BreatheLevel(++step_) / 255);
     }
-    return true;
 }
 
 void GpioLed::OnStateChanged() {
@@ -222,13 +194,8 @@ void GpioLed::OnStateChanged() {
             break;
         case kDeviceStateListening:
         case kDeviceStateAudioTesting:
-            if (app.IsVoiceDetected()) {
-                SetBrightness(HIGH_BRIGHTNESS);
-            } else {
-                SetBrightness(LOW_BRIGHTNESS);
-            }
             // TurnOn();
-            StartFadeTask();
+            StartBreathe();
             break;
         case kDeviceStateSpeaking:
             SetBrightness(SPEAKING_BRIGHTNESS);
@@ -4,13 +4,14 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include "led.h"
+#include "led_effect_engine.h"
 #include <driver/gpio.h>
 #include <driver/ledc.h>
 #include <esp_timer.h>
 #include <atomic>
 #include <mutex>
 
-class GpioLed : public Led {
+class GpioLed : public Led, public LedEffectEngine::Client {
  public:
     GpioLed(gpio_num_t gpio);
     GpioLed(gpio_num_t gpio, int output_invert);
@@ -22,26 +23,34 @@ class GpioLed : public Led {
     void TurnOff();
     void SetBrightness(uint8_t brightness);
 
+    void OnEffectTick(uint32_t tick) override;
+
  private:
+    enum Effect {
+        kEffectNone,
+        kEffectBlink,
+        kEffectBreathe,
+    };
+
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     ledc_channel_config_t ledc_channel_ = {0};
     bool ledc_initialized_ = false;
     uint32_t duty_ = 0;
+    uint32_t shown_duty_ = 0;
+    Effect effect_ = kEffectNone;
     int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
-    esp_timer_handle_t blink_timer_ = nullptr;
-    bool fade_up_ = true;
+    int interval_ticks_ = 1;
+    int countdown_ = 0;
+    int step_ = 0;
 
-    void StartBlinkTask(int times, int interval_ms);
-    void OnBlinkTimer();
+    void StartEffect(Effect effect, int interval_ms);
+    void StopEffect();
+    void SetDuty(uint32_t duty);
 
     void BlinkOnce();
     void Blink(int times, int interval_ms);
     void StartContinuousBlink(int interval_ms);
-    void StartFadeTask();
-    void OnFadeEnd();
-    static bool IRAM_ATTR FadeCallback(const ledc_cb_param_t *param, void *user_arg);
+    void StartBreathe();
 };
 
 #endif  // _GPIO_LED_H_
@@ -0,0 +1,91 @@
+#include "led_effect_engine.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "LedEffectEngine"
+
+// (1 - cos(2 * pi * step / kBreatheSteps)) / 2 with a 2.2 gamma, so the fade looks even
+const uint8_t LedEffectEngine::kBreatheTable[kBreatheSteps] = {
+      0,   0,   0,   0,   0,   1,   1,   2,   4,   6,   9,  14,  19,  26,  34,  44,
+     55,  68,  82,  97, 113, 130, 147, 164, 180, 196, 210, 223, 234, 243, 250, 254,
+    255, 254, 250, 243, 234, 223, 210, 196, 180, 164, 147, 130, 113,  97,  82,  68,
+     55,  44,  34,  26,  19,  14,   9,   6,   4,   2,   1,   1,   0,   0,   0,   0,};
+
+LedEffectEngine::LedEffectEngine() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<LedEffectEngine*>(arg)->OnTick();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "led_effects",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+}
+
+LedEffectEngine::~LedEffectEngine() {
+    esp_timer_stop(timer_);
+    esp_timer_delete(timer_);
+}
+
+int LedEffectEngine::IntervalTicks(int interval_ms) {
+    return std::max(1, (interval_ms + kTickMs / 2) / kTickMs);
+}
+
+void LedEffectEngine::Attach(Client* client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (std::find(clients_.begin(), clients_.end(), client) == clients_.end()) {
+        if (clients_.size() >= kMaxClients) {
+            ESP_LOGW(TAG, "Too many animated LEDs, max %d", kMaxClients);
+            return;
+        }
+        clients_.push_back(client);
+    }
+    if (!running_) {
+        running_ = true;
+        esp_timer_start_periodic(timer_, kTickMs * 1000);
+    }
+}
+
+void LedEffectEngine::Detach(Client* client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clients_.erase(std::remove(clients_.begin(), clients_.end(), client), clients_.end());
+}
+
+void LedEffectEngine::OnTick() {
+    // Clients run outside the lock, they take their own lock and Detach themselves when done
+    Client* clients[kMaxClients];
+    int count;
+    uint32_t tick;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (clients_.empty()) {
+            esp_timer_stop(timer_);
+            running_ = false;
+            if (busy_ticks_ > 0) {
+                ESP_LOGI(TAG, "Idle after %lu ticks, tick cost avg %lu us max %lu us", busy_ticks_,
+                    (uint32_t)(busy_time_us_ / busy_ticks_), (uint32_t)max_tick_us_);
+            }
+            busy_ticks_ = 0;
+            busy_time_us_ = 0;
+            max_tick_us_ = 0;
+            return;
+        }
+        count = std::min<int>(clients_.size(), kMaxClients);
+        std::copy_n(clients_.begin(), count, clients);
+        tick = ++tick_;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        clients[i]->OnEffectTick(tick);
+    }
+    int64_t cost = esp_timer_get_time() - start_time;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    busy_ticks_++;
+    busy_time_us_ += cost;
+    max_tick_us_ = std::max(max_tick_us_, cost);
+}
@@ -0,0 +1,65 @@
+#ifndef _LED_EFFECT_ENGINE_H_
+#define _LED_EFFECT_ENGINE_H_
+
+#include <esp_timer.h>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Drives the animations of every LED from one periodic esp_timer. The timer only runs
+ * while at least one client is animating. Clients keep their precomputed frames and are
+ * expected to push a frame to the hardware only when it differs from the one shown.
+ */
+class LedEffectEngine {
+public:
+    static constexpr int kTickMs = 10;
+    // Steps of one breathing period in BreatheLevel
+    static constexpr int kBreatheSteps = 64;
+
+    class Client {
+    public:
+        virtual ~Client() = default;
+        // Runs on the esp_timer task every kTickMs until the client detaches. A tick may still
+        // arrive right after Detach and should then do nothing.
+        virtual void OnEffectTick(uint32_t tick) = 0;
+    };
+
+    static LedEffectEngine& GetInstance() {
+        static LedEffectEngine instance;
+        return instance;
+    }
+    LedEffectEngine(const LedEffectEngine&) = delete;
+    LedEffectEngine& operator=(const LedEffectEngine&) = delete;
+
+    // Adds the client if needed, safe to call while holding the client's own lock and from OnEffectTick
+    void Attach(Client* client);
+    void Detach(Client* client);
+
+    // Gamma corrected raised cosine over one breathing period, 0 to 255 and back
+    static uint8_t BreatheLevel(int step) { return kBreatheTable[step % kBreatheSteps]; }
+    // Intervals are rounded to whole ticks, at least one
+    static int IntervalTicks(int interval_ms);
+
+private:
+    LedEffectEngine();
+    ~LedEffectEngine();
+
+    static constexpr int kMaxClients = 8;
+    static const uint8_t kBreatheTable[kBreatheSteps];
+
+    std::mutex mutex_;
+    std::vector<Client*> clients_;
+    esp_timer_handle_t timer_ = nullptr;
+    bool running_ = false;
+    uint32_t tick_ = 0;
+
+    // Cost of the ticks since the engine started, logged when it goes idle
+    uint32_t busy_ticks_ = 0;
+    int64_t busy_time_us_ = 0;
+    int64_t max_tick_us_ = 0;
+
+    void OnTick();
+};
+
+#endif // _LED_EFFECT_ENGINE_H_
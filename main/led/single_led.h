@@ -2,30 +2,32 @@
 #define _SINGLE_LED_H_
 
 #include "led.h"
+#include "led_effect_engine.h"
 #include <driver/gpio.h>
 #include <led_strip.h>
 #include <esp_timer.h>
 #include <atomic>
 #include <mutex>
 
-class SingleLed : public Led {
+class SingleLed : public Led, public LedEffectEngine::Client {
 public:
     SingleLed(gpio_num_t gpio);
     virtual ~SingleLed();
 
     void OnStateChanged() override;
+    void OnEffectTick(uint32_t tick) override;
 
 private:
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     led_strip_handle_t led_strip_ = nullptr;
     uint8_t r_ = 0, g_ = 0, b_ = 0;
+    bool blinking_ = false;
     int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
-    esp_timer_handle_t blink_timer_ = nullptr;
+    int interval_ticks_ = 1;
+    int countdown_ = 0;
 
     void StartBlinkTask(int times, int interval_ms);
-    void OnBlinkTimer();
+    void StopBlink();
 
     void BlinkOnce();
     void Blink(int times, int interval_ms);
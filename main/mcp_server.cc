@@ -15,6 +15,9 @@
 #include "oled_display.h"
 #include "board.h"
 #include "settings.h"
+#include "task_profiler.h"
+#include "memory_arena.h"
+#include "heap_profiler.h"
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
 
@@ -30,6 +33,15 @@ McpServer::~McpServer() {
     tools_.clear();
 }
 
+void McpServer::RegisterMessageHandler() {
+    Application::GetInstance().RegisterMessageHandler("mcp", [this](const cJSON* root) {
+        auto payload = cJSON_GetObjectItem(root, "payload");
+        if (cJSON_IsObject(payload)) {
+            ParseMessage(payload);
+        }
+    });
+}
+
 void McpServer::AddCommonTools() {
     // *Important* To speed up the response time, we add the common tools to the beginning of
     // the tools list to utilize the prompt cache.
@@ -170,6 +182,34 @@ void McpServer::AddUserOnlyTools() {
             return true;
         });
 
+    AddUserOnlyTool("self.get_memory_report",
+        "Get the free size, largest free block and low water mark of each memory arena, and the usage of each subsystem against its budget",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return MemoryArena::GetReportJson();
+        });
+
+#if CONFIG_USE_TASK_PROFILER
+    AddUserOnlyTool("self.get_task_stats",
+        "Get the CPU usage and minimum free stack of every task over the latest sampling window",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return TaskProfiler::GetInstance().GetStatsJson();
+        });
+#endif
+
+#if CONFIG_USE_HEAP_PROFILER
+    AddUserOnlyTool("self.get_heap_hotspots",
+        "Get the call sites holding the most heap memory with their allocation rate since the previous call, "
+        "and the free size and largest free block of each heap. Addresses are decoded offline against the firmware ELF.",
+        PropertyList({
+            Property("top", kPropertyTypeInteger, 10, 1, 64)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return HeapProfiler::GetHotspotsJson(properties["top"].value<int>(), HeapProfiler::kConsumerMcp);
+        });
+#endif
+
     // Display control
 #ifdef HAVE_LVGL
     auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
@@ -198,18 +238,12 @@ void McpServer::AddUserOnlyTools() {
                 auto url = properties["url"].value<std::string>();
                 auto quality = properties["quality"].value<int>();
 
-                std::string jpeg_data;
-                if (!display->SnapshotToJpeg(jpeg_data, quality)) {
-                    throw std::runtime_error("Failed to snapshot screen");
-                }
-
-                ESP_LOGI(TAG, "Upload snapshot %u bytes to %s", jpeg_data.size(), url.c_str());
-                
                 // 构造multipart/form-data请求体
                 std::string boundary = "----ESP32_SCREEN_SNAPSHOT_BOUNDARY";
                 
                 auto http = Board::GetInstance().GetNetwork()->CreateHttp(3);
                 http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
+                http->SetHeader("Transfer-Encoding", "chunked");
                 if (!http->Open("POST", url)) {
                     throw std::runtime_error("Failed to open URL: " + url);
                 }
@@ -223,8 +257,17 @@ void McpServer::AddUserOnlyTools() {
                     http->Write(file_header.c_str(), file_header.size());
                 }
 
-                // JPEG数据
-                http->Write((const char*)jpeg_data.data(), jpeg_data.size());
+                // JPEG数据，边编码边上传
+                size_t jpeg_size = 0;
+                bool encoded = display->SnapshotToJpeg([&http, &jpeg_size](const void* data, size_t len) {
+                    http->Write(static_cast<const char*>(data), len);
+                    jpeg_size += len;
+                }, quality);
+                if (!encoded) {
+                    http->Close();
+                    throw std::runtime_error("Failed to snapshot screen");
+                }
+                ESP_LOGI(TAG, "Uploaded snapshot %u bytes to %s", jpeg_size, url.c_str());
 
                 {
                     // multipart尾部
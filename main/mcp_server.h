@@ -325,6 +325,8 @@ public:
     void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+    // Route the server's "mcp" messages to ParseMessage
+    void RegisterMessageHandler();
 
 private:
     McpServer();
@@ -0,0 +1,225 @@
+#include "memory_arena.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_memory_utils.h>
+#include <freertos/FreeRTOS.h>
+#include <cstring>
+
+#define TAG "MemoryArena"
+
+#define INTERNAL_RESERVE_SIZE (CONFIG_MEMORY_INTERNAL_RESERVE_KB * 1024)
+
+#if CONFIG_USE_GIF_FRAME_CACHE
+#define GIF_CACHE_KB CONFIG_GIF_FRAME_CACHE_SIZE_KB
+#else
+#define GIF_CACHE_KB 0
+#endif
+#if CONFIG_USE_GLYPH_CACHE
+#define GLYPH_CACHE_KB CONFIG_GLYPH_CACHE_SIZE_KB
+#else
+#define GLYPH_CACHE_KB 0
+#endif
+#define DISPLAY_BUDGET ((GIF_CACHE_KB + GLYPH_CACHE_KB + 1024) * 1024)
+
+struct ArenaInfo {
+    const char* name;
+    uint32_t caps;
+};
+
+struct ClientInfo {
+    const char* name;
+    MemoryArenaId arena;
+    size_t budget;
+};
+
+struct ClientUsage {
+    size_t in_use;
+    size_t peak;
+    uint32_t failures;
+};
+
+static const ArenaInfo kArenas[] = {
+    { "internal_fast", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+    { "psram_bulk",    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT },
+};
+static_assert(sizeof(kArenas) / sizeof(kArenas[0]) == kArenaCount, "One entry per MemoryArenaId");
+
+// Indexed by MemoryClient
+static const ClientInfo kClients[] = {
+    { "system",    kArenaInternalFast, 8 * 1024 },      // Task profiler snapshots
+    { "wake_word", kArenaPsramBulk,    32 * 1024 },     // Wake word encoder task stack
+    { "display",   kArenaPsramBulk,    DISPLAY_BUDGET },// GIF frame and glyph caches, build scratch and canvases
+    { "camera",    kArenaPsramBulk,    64 * 1024 },     // JPEG chunk pool of the explain upload
+};
+static_assert(sizeof(kClients) / sizeof(kClients[0]) == kMemoryClientCount, "One entry per MemoryClient");
+
+static ClientUsage usage_[kMemoryClientCount];
+static portMUX_TYPE usage_lock_ = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t GetCaps(MemoryArenaId arena, size_t size) {
+    if (arena == kArenaPsramBulk) {
+#if CONFIG_SPIRAM
+        return kArenas[kArenaPsramBulk].caps;
+#else
+        arena = kArenaInternalFast;
+#endif
+    }
+    if (arena == kArenaInternalFast &&
+        heap_caps_get_free_size(MALLOC_CAP_INTERNAL) < size + INTERNAL_RESERVE_SIZE) {
+#if CONFIG_SPIRAM
+        return kArenas[kArenaPsramBulk].caps;
+#else
+        return 0;
+#endif
+    }
+    return kArenas[arena].caps;
+}
+
+static bool Charge(MemoryClient client, size_t old_size, size_t new_size) {
+    auto& info = kClients[client];
+    bool ok = true;
+    portENTER_CRITICAL(&usage_lock_);
+    auto& usage = usage_[client];
+    if (usage.in_use - old_size + new_size > info.budget) {
+        usage.failures++;
+        ok = false;
+    } else {
+        usage.in_use = usage.in_use - old_size + new_size;
+        if (usage.in_use > usage.peak) {
+            usage.peak = usage.in_use;
+        }
+    }
+    portEXIT_CRITICAL(&usage_lock_);
+    if (!ok) {
+        ESP_LOGE(TAG, "%s would exceed its budget of %u bytes with %u more", info.name, info.budget, new_size - old_size);
+    }
+    return ok;
+}
+
+static void Fail(MemoryClient client, size_t size) {
+    portENTER_CRITICAL(&usage_lock_);
+    usage_[client].failures++;
+    portEXIT_CRITICAL(&usage_lock_);
+    ESP_LOGE(TAG, "Failed to allocate %u bytes for %s", size, kClients[client].name);
+}
+
+void* MemoryArena::Allocate(MemoryClient client, size_t size) {
+    uint32_t caps = GetCaps(kClients[client].arena, size);
+    if (caps == 0 || !Charge(client, 0, size)) {
+        return nullptr;
+    }
+    void* ptr = heap_caps_malloc(size, caps);
+    if (ptr == nullptr) {
+        Charge(client, size, 0);
+        Fail(client, size);
+        return nullptr;
+    }
+    // The heap may round up, account what the block really holds
+    size_t allocated = heap_caps_get_allocated_size(ptr);
+    if (allocated != size) {
+        portENTER_CRITICAL(&usage_lock_);
+        usage_[client].in_use += allocated - size;
+        portEXIT_CRITICAL(&usage_lock_);
+    }
+    return ptr;
+}
+
+void* MemoryArena::Reallocate(MemoryClient client, void* ptr, size_t size) {
+    if (ptr == nullptr) {
+        return Allocate(client, size);
+    }
+    size_t old_size = heap_caps_get_allocated_size(ptr);
+    if (size > old_size && !Charge(client, 0, size - old_size)) {
+        return nullptr;
+    }
+    // Stay in the region the block already lives in
+    uint32_t caps = esp_ptr_external_ram(ptr) ? kArenas[kArenaPsramBulk].caps : kArenas[kArenaInternalFast].caps;
+    void* new_ptr = heap_caps_realloc(ptr, size, caps);
+    if (new_ptr == nullptr) {
+        if (size > old_size) {
+            Charge(client, size - old_size, 0);
+        }
+        Fail(client, size);
+        return nullptr;
+    }
+    // in_use counts the larger of the old and the requested size for this block so far
+    size_t new_size = heap_caps_get_allocated_size(new_ptr);
+    portENTER_CRITICAL(&usage_lock_);
+    auto& usage = usage_[client];
+    usage.in_use = usage.in_use - (size > old_size ? size : old_size) + new_size;
+    if (usage.in_use > usage.peak) {
+        usage.peak = usage.in_use;
+    }
+    portEXIT_CRITICAL(&usage_lock_);
+    return new_ptr;
+}
+
+void MemoryArena::Free(MemoryClient client, void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    size_t size = heap_caps_get_allocated_size(ptr);
+    heap_caps_free(ptr);
+    portENTER_CRITICAL(&usage_lock_);
+    usage_[client].in_use -= size;
+    portEXIT_CRITICAL(&usage_lock_);
+}
+
+cJSON* MemoryArena::GetReportJson() {
+    auto json = cJSON_CreateObject();
+    auto arenas = cJSON_AddArrayToObject(json, "arenas");
+    for (int i = 0; i < kArenaCount; i++) {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, kArenas[i].caps);
+        size_t free_size = info.total_free_bytes;
+        auto arena = cJSON_CreateObject();
+        cJSON_AddStringToObject(arena, "name", kArenas[i].name);
+        cJSON_AddNumberToObject(arena, "total", info.total_free_bytes + info.total_allocated_bytes);
+        cJSON_AddNumberToObject(arena, "free", free_size);
+        cJSON_AddNumberToObject(arena, "min_free", info.minimum_free_bytes);
+        cJSON_AddNumberToObject(arena, "largest_free_block", info.largest_free_block);
+        // Share of the free memory that can't be handed out as one block
+        cJSON_AddNumberToObject(arena, "fragmentation_percent",
+            free_size > 0 ? 100 - info.largest_free_block * 100 / free_size : 0);
+        cJSON_AddItemToArray(arenas, arena);
+    }
+
+    ClientUsage usage[kMemoryClientCount];
+    portENTER_CRITICAL(&usage_lock_);
+    memcpy(usage, usage_, sizeof(usage));
+    portEXIT_CRITICAL(&usage_lock_);
+
+    auto clients = cJSON_AddArrayToObject(json, "clients");
+    for (int i = 0; i < kMemoryClientCount; i++) {
+        auto client = cJSON_CreateObject();
+        cJSON_AddStringToObject(client, "name", kClients[i].name);
+        cJSON_AddStringToObject(client, "arena", kArenas[kClients[i].arena].name);
+        cJSON_AddNumberToObject(client, "in_use", usage[i].in_use);
+        cJSON_AddNumberToObject(client, "peak", usage[i].peak);
+        cJSON_AddNumberToObject(client, "budget", kClients[i].budget);
+        cJSON_AddNumberToObject(client, "failures", usage[i].failures);
+        cJSON_AddItemToArray(clients, client);
+    }
+    return json;
+}
+
+void MemoryArena::PrintReport() {
+    for (int i = 0; i < kArenaCount; i++) {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, kArenas[i].caps);
+        size_t free_size = info.total_free_bytes;
+        ESP_LOGI(TAG, "%-13s free %7u min %7u largest %7u fragmentation %u%%", kArenas[i].name,
+            free_size, info.minimum_free_bytes, info.largest_free_block,
+            free_size > 0 ? 100 - info.largest_free_block * 100 / free_size : 0);
+    }
+
+    ClientUsage usage[kMemoryClientCount];
+    portENTER_CRITICAL(&usage_lock_);
+    memcpy(usage, usage_, sizeof(usage));
+    portEXIT_CRITICAL(&usage_lock_);
+    for (int i = 0; i < kMemoryClientCount; i++) {
+        ESP_LOGI(TAG, "%-9s %-13s in use %7u peak %7u budget %7u failures %lu", kClients[i].name,
+            kArenas[kClients[i].arena].name, usage[i].in_use, usage[i].peak, kClients[i].budget, usage[i].failures);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef _MEMORY_ARENA_H_
+#define _MEMORY_ARENA_H_
+
+#include <cJSON.h>
+#include <cstddef>
+
+enum MemoryArenaId {
+    kArenaInternalFast,     // Internal SRAM for hot data that must not live in PSRAM
+    kArenaPsramBulk,        // Large buffers, internal SRAM only when the chip has no PSRAM
+    kArenaCount
+};
+
+enum MemoryClient {
+    kMemorySystem,
+    kMemoryWakeWord,
+    kMemoryDisplay,
+    kMemoryCamera,
+    kMemoryClientCount
+};
+
+/*
+ * Allocation of the large long-lived buffers by subsystem. Every client has an arena and
+ * a budget in the table in memory_arena.cc; allocations over budget fail right away
+ * instead of starving the rest of the system hours later. Internal SRAM below
+ * MEMORY_INTERNAL_RESERVE_KB is never handed out, it stays for the DMA buffers that
+ * drivers, Wi-Fi and esp_lvgl_port allocate themselves; requests move to PSRAM instead
+ * when the chip has it.
+ */
+class MemoryArena {
+public:
+    static void* Allocate(MemoryClient client, size_t size);
+    static void* Reallocate(MemoryClient client, void* ptr, size_t size);
+    static void Free(MemoryClient client, void* ptr);
+
+    // Free size, largest block and low water mark of each arena, usage and peak per client
+    static cJSON* GetReportJson();
+    static void PrintReport();
+};
+
+#endif // _MEMORY_ARENA_H_
@@ -0,0 +1,53 @@
+#include "message_dispatcher.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "MessageDispatcher"
+
+std::string_view MessageDispatcher::GetString(const cJSON* object, const char* key) {
+    auto item = cJSON_GetObjectItem(object, key);
+    if (!cJSON_IsString(item)) {
+        return {};
+    }
+    return item->valuestring;
+}
+
+MessageDispatcher::Entry* MessageDispatcher::Find(std::string_view type) {
+    uint32_t hash = Hash(type);
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), hash, HashLess);
+    for (; it != entries_.end() && it->hash == hash; ++it) {
+        if (it->type == type) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+void MessageDispatcher::Register(std::string_view type, Handler handler) {
+    auto entry = Find(type);
+    if (entry != nullptr) {
+        ESP_LOGW(TAG, "Replacing handler of message type %.*s", (int)type.size(), type.data());
+        entry->handler = std::move(handler);
+        return;
+    }
+    uint32_t hash = Hash(type);
+    auto position = std::lower_bound(entries_.begin(), entries_.end(), hash, HashLess);
+    entries_.insert(position, {hash, std::string(type), std::move(handler)});
+}
+
+bool MessageDispatcher::Dispatch(const cJSON* root) {
+    auto type = GetString(root, "type");
+    if (type.empty()) {
+        ESP_LOGW(TAG, "Message without type");
+        return false;
+    }
+
+    auto entry = Find(type);
+    if (entry != nullptr) {
+        entry->handler(root);
+        return true;
+    }
+    ESP_LOGW(TAG, "Unknown message type: %.*s", (int)type.size(), type.data());
+    return false;
+}
@@ -0,0 +1,53 @@
+#ifndef MESSAGE_DISPATCHER_H
+#define MESSAGE_DISPATCHER_H
+
+#include <cJSON.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Routes incoming server JSON messages to the handler registered for their "type".
+ * The table is kept sorted by a 32-bit FNV-1a hash of the type and binary searched. A hash
+ * hit is confirmed against the stored type string, so a colliding unknown type never
+ * reaches a handler.
+ *
+ * Handlers run on the network task with the message parsed once by the protocol. String
+ * views returned by GetString point into that parse and are only valid during the call.
+ */
+class MessageDispatcher {
+public:
+    using Handler = std::function<void(const cJSON* root)>;
+
+    static constexpr uint32_t Hash(std::string_view text) {
+        uint32_t hash = 2166136261u;
+        for (char c : text) {
+            hash = (hash ^ (uint8_t)c) * 16777619u;
+        }
+        return hash;
+    }
+
+    // String member of an object, empty if missing or not a string
+    static std::string_view GetString(const cJSON* object, const char* key);
+
+    // Register the handler for a message type, replacing any earlier one
+    void Register(std::string_view type, Handler handler);
+    // Returns false if no handler is registered for the message type
+    bool Dispatch(const cJSON* root);
+
+private:
+    struct Entry {
+        uint32_t hash;
+        std::string type;
+        Handler handler;
+    };
+
+    static bool HashLess(const Entry& entry, uint32_t hash) { return entry.hash < hash; }
+    Entry* Find(std::string_view type);
+    // Sorted by hash
+    std::vector<Entry> entries_;
+};
+
+#endif // MESSAGE_DISPATCHER_H
@@ -37,7 +37,9 @@ private:
 
     std::string publish_topic_;
 
-    std::mutex channel_mutex_;
+    // The client and the UDP channel are replaced on the open channel task while the main
+    // loop sends, both are only swapped and used under the lock
+    mutable std::mutex channel_mutex_;
     std::unique_ptr<Mqtt> mqtt_;
     std::unique_ptr<Udp> udp_;
     mbedtls_aes_context aes_ctx_;
@@ -1,6 +1,9 @@
 #include "protocol.h"
+#include "task_registry.h"
 
 #include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 #define TAG "Protocol"
 
@@ -32,6 +35,34 @@ void Protocol::OnDisconnected(std::function<void()> callback) {
     on_disconnected_ = callback;
 }
 
+bool Protocol::OpenAudioChannelAsync(std::function<void(bool opened)> callback) {
+    bool expected = false;
+    if (!channel_opening_.compare_exchange_strong(expected, true)) {
+        ESP_LOGW(TAG, "Audio channel is already opening");
+        return false;
+    }
+
+    on_open_complete_ = std::move(callback);
+    // The stack has to hold a TLS handshake, like the main event loop it relieves
+    auto ret = TaskRegistry::Create(kTaskOpenChannel, [](void* arg) {
+        auto protocol = (Protocol*)arg;
+        bool opened = protocol->OpenAudioChannel();
+        auto callback = std::move(protocol->on_open_complete_);
+        protocol->channel_opening_ = false;
+        if (callback) {
+            callback(opened);
+        }
+        vTaskDelete(NULL);
+    }, this);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create open channel task");
+        on_open_complete_ = nullptr;
+        channel_opening_ = false;
+        return false;
+    }
+    return true;
+}
+
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
     if (on_network_error_ != nullptr) {
@@ -73,11 +104,31 @@ void Protocol::SendStopListening() {
     SendText(message);
 }
 
+// Tell the server that audio from start_ms (since listening started) was silent and not sent,
+// so the missing packets are not taken for network loss. Only servers that advertise
+// "silence" in the features of their hello understand this message.
+void Protocol::SendVoiceGap(uint32_t start_ms, uint32_t duration_ms) {
+    if (!server_silence_supported_) {
+        return;
+    }
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"listen\",\"state\":\"silence\"";
+    message += ",\"start_ms\":" + std::to_string(start_ms) + ",\"duration_ms\":" + std::to_string(duration_ms) + "}";
+    SendText(message);
+}
+
 void Protocol::SendMcpMessage(const std::string& payload) {
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":" + payload + "}";
     SendText(message);
 }
 
+void Protocol::ParseServerFeatures(const cJSON* root) {
+    server_silence_supported_ = false;
+    auto features = cJSON_GetObjectItem(root, "features");
+    if (cJSON_IsObject(features)) {
+        server_silence_supported_ = cJSON_IsTrue(cJSON_GetObjectItem(features, "silence"));
+    }
+}
+
 bool Protocol::IsTimeout() const {
     const int kTimeoutSeconds = 120;
     auto now = std::chrono::steady_clock::now();
@@ -6,11 +6,19 @@
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <atomic>
 
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    // Silence the voice gate dropped right before this packet, see Protocol::SendVoiceGap
+    uint32_t gap_start_ms = 0;
+    uint32_t gap_ms = 0;
+    // Position in the TTS stream at the end of this packet and the turn it counts from,
+    // 0 for audio outside of it
+    uint32_t stream_position_ms = 0;
+    uint32_t stream_turn = 0;
     std::vector<uint8_t> payload;
 };
 
@@ -65,12 +73,17 @@ public:
 
     virtual bool Start() = 0;
     virtual bool OpenAudioChannel() = 0;
+    // Run OpenAudioChannel on a worker task, so the caller never waits for the server hello.
+    // The callback runs on that task with the result. Returns false if an open is in progress.
+    bool OpenAudioChannelAsync(std::function<void(bool opened)> callback);
+    bool IsAudioChannelOpening() const { return channel_opening_; }
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
     virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
+    virtual void SendVoiceGap(uint32_t start_ms, uint32_t duration_ms);
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
 
@@ -82,15 +95,20 @@ protected:
     std::function<void(const std::string& message)> on_network_error_;
     std::function<void()> on_connected_;
     std::function<void()> on_disconnected_;
+    std::function<void(bool opened)> on_open_complete_;
+    std::atomic<bool> channel_opening_ = false;
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
-    bool error_occurred_ = false;
+    std::atomic<bool> error_occurred_ = false;
+    // Set from the server hello, see SendVoiceGap
+    bool server_silence_supported_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
     virtual bool SendText(const std::string& text) = 0;
     virtual void SetError(const std::string& message);
+    void ParseServerFeatures(const cJSON* root);
     virtual bool IsTimeout() const;
 };
 
@@ -3,6 +3,7 @@
 #include "system_info.h"
 #include "application.h"
 #include "settings.h"
+#include "task_registry.h"
 
 #include <cstring>
 #include <cJSON.h>
@@ -14,27 +15,155 @@
 
 WebsocketProtocol::WebsocketProtocol() {
     event_group_handle_ = xEventGroupCreate();
+
+    // Reload the cached url and token when the OTA config changes them
+    Settings::OnChanged([this](const std::string& ns, const std::string& key) {
+        if (ns == "websocket") {
+            settings_loaded_ = false;
+        }
+    });
+
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_CHANNEL
+    esp_timer_create_args_t keep_alive_timer_args = {
+        .callback = [](void* arg) {
+            WebsocketProtocol* protocol = (WebsocketProtocol*)arg;
+            protocol->StartKeepAlive();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ws_keep_alive",
+        .skip_unhandled_events = true
+    };
+    esp_timer_create(&keep_alive_timer_args, &keep_alive_timer_);
+#endif
 }
 
 WebsocketProtocol::~WebsocketProtocol() {
+    if (keep_alive_timer_ != nullptr) {
+        esp_timer_stop(keep_alive_timer_);
+        esp_timer_delete(keep_alive_timer_);
+    }
+    ReplaceWebSocket(nullptr);
     vEventGroupDelete(event_group_handle_);
 }
 
 bool WebsocketProtocol::Start() {
-    // Only connect to server when audio channel is needed
+    LoadSettings();
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_CHANNEL
+    // Warm up the connection in the background of the first keep-alive tick,
+    // so the first wake word does not pay for the TLS handshake either
+    esp_timer_start_periodic(keep_alive_timer_, CONFIG_WEBSOCKET_KEEP_ALIVE_INTERVAL * 1000000LL);
+    StartKeepAlive();
+#endif
+    // Otherwise only connect to server when audio channel is needed
     return true;
 }
 
+// Returns true when the settings were (re)loaded. A change arriving while reading them clears
+// the flag again, so it is picked up by the next call.
+bool WebsocketProtocol::LoadSettings() {
+    if (settings_loaded_.exchange(true)) {
+        return false;
+    }
+
+    Settings settings("websocket", false);
+    std::string url = settings.GetString("url");
+    std::string token = settings.GetString("token");
+    int version = settings.GetInt("version");
+    if (version != 0) {
+        version_ = version;
+    }
+
+    // If token not has a space, add "Bearer " prefix
+    if (!token.empty() && token.find(" ") == std::string::npos) {
+        token = "Bearer " + token;
+    }
+    std::lock_guard<std::mutex> lock(websocket_mutex_);
+    url_ = std::move(url);
+    token_ = std::move(token);
+    return true;
+}
+
+// The reconnect does a TLS handshake and waits up to 10 s for the server hello, so it runs on
+// a short-lived task rather than the main event loop. The new connection is published under
+// websocket_mutex_ by Connect.
+void WebsocketProtocol::StartKeepAlive() {
+    bool expected = false;
+    if (!keep_alive_running_.compare_exchange_strong(expected, true)) {
+        return;
+    }
+    auto ret = TaskRegistry::Create(kTaskKeepAlive, [](void* arg) {
+        auto protocol = (WebsocketProtocol*)arg;
+        protocol->KeepAlive();
+        protocol->keep_alive_running_ = false;
+        vTaskDelete(NULL);
+    }, this);
+    if (ret != pdPASS) {
+        keep_alive_running_ = false;
+    }
+}
+
+void WebsocketProtocol::KeepAlive() {
+    // An audio channel being opened owns the connection, the next tick looks again
+    std::unique_lock<std::mutex> connect_lock(connect_mutex_, std::try_to_lock);
+    if (!connect_lock.owns_lock()) {
+        return;
+    }
+
+    // Only keep a warm connection while nobody is using the channel
+    if (channel_opened_) {
+        return;
+    }
+
+    auto state = Application::GetInstance().GetDeviceState();
+    if (state == kDeviceStateUpgrading) {
+        // Release the TLS session memory for the firmware download
+        ReplaceWebSocket(nullptr);
+        return;
+    }
+    if (state != kDeviceStateIdle) {
+        return;
+    }
+
+    // A connection made with the previous url or token is dropped
+    if (LoadSettings()) {
+        ReplaceWebSocket(nullptr);
+    }
+    {
+        std::lock_guard<std::mutex> lock(websocket_mutex_);
+        if (websocket_ != nullptr && websocket_->IsConnected()) {
+            websocket_->Ping();
+            return;
+        }
+    }
+
+    ESP_LOGI(TAG, "Warming up websocket connection");
+    int64_t start_time = esp_timer_get_time();
+    if (Connect(false)) {
+        ESP_LOGI(TAG, "Websocket connection is warm, took %d ms", (int)((esp_timer_get_time() - start_time) / 1000));
+    } else {
+        // Retry silently on the next tick, errors are reported when the channel is opened
+        ReplaceWebSocket(nullptr);
+    }
+}
+
 bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+    std::lock_guard<std::mutex> lock(websocket_mutex_);
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
 
+    if (first_packet_pending_) {
+        first_packet_pending_ = false;
+        ESP_LOGI(TAG, "First audio packet sent %d ms after opening the channel",
+            (int)((esp_timer_get_time() - open_start_time_) / 1000));
+    }
+
     if (version_ == 2) {
         std::string serialized;
         serialized.resize(sizeof(BinaryProtocol2) + packet->payload.size());
         auto bp2 = (BinaryProtocol2*)serialized.data();
-        bp2->version = htons(version_);
+        bp2->version = htons(version_.load());
         bp2->type = 0;
         bp2->reserved = 0;
         bp2->timestamp = htonl(packet->timestamp);
@@ -58,57 +187,106 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
 }
 
 bool WebsocketProtocol::SendText(const std::string& text) {
-    if (websocket_ == nullptr || !websocket_->IsConnected()) {
-        return false;
-    }
-
-    if (!websocket_->Send(text)) {
-        ESP_LOGE(TAG, "Failed to send text: %s", text.c_str());
-        SetError(Lang::Strings::SERVER_ERROR);
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(websocket_mutex_);
+        if (websocket_ == nullptr || !websocket_->IsConnected()) {
+            return false;
+        }
+        if (websocket_->Send(text)) {
+            return true;
+        }
     }
 
-    return true;
+    ESP_LOGE(TAG, "Failed to send text: %s", text.c_str());
+    SetError(Lang::Strings::SERVER_ERROR);
+    return false;
 }
 
 bool WebsocketProtocol::IsAudioChannelOpened() const {
-    return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
+    std::lock_guard<std::mutex> lock(websocket_mutex_);
+    return channel_opened_ && websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
-    websocket_.reset();
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_CHANNEL
+    bool connected;
+    {
+        std::lock_guard<std::mutex> lock(websocket_mutex_);
+        connected = websocket_ != nullptr && websocket_->IsConnected();
+    }
+    if (channel_opened_ && connected && !error_occurred_) {
+        // End the current turn but keep the connection warm for the next wake
+        channel_opened_ = false;
+        SendAbortSpeaking(kAbortReasonNone);
+        SendStopListening();
+        if (on_audio_channel_closed_ != nullptr) {
+            on_audio_channel_closed_();
+        }
+        return;
+    }
+#endif
+    channel_opened_ = false;
+    ReplaceWebSocket(nullptr);
 }
 
 bool WebsocketProtocol::OpenAudioChannel() {
-    Settings settings("websocket", false);
-    std::string url = settings.GetString("url");
-    std::string token = settings.GetString("token");
-    int version = settings.GetInt("version");
-    if (version != 0) {
-        version_ = version;
+    open_start_time_ = esp_timer_get_time();
+    first_packet_pending_ = true;
+    error_occurred_ = false;
+    // Wait for a keep-alive reconnect in flight, its connection is then reused
+    std::lock_guard<std::mutex> connect_lock(connect_mutex_);
+    bool reloaded = LoadSettings();
+
+    bool warm = false;
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_CHANNEL
+    {
+        std::lock_guard<std::mutex> lock(websocket_mutex_);
+        warm = !reloaded && websocket_ != nullptr && websocket_->IsConnected();
+    }
+#endif
+    if (warm) {
+        ESP_LOGI(TAG, "Resuming warm websocket session: %s", session_id_.c_str());
+        last_incoming_time_ = std::chrono::steady_clock::now();
+    } else if (!Connect(true)) {
+        return false;
     }
 
-    error_occurred_ = false;
+    channel_opened_ = true;
+    ESP_LOGI(TAG, "Audio channel opened in %d ms", (int)((esp_timer_get_time() - open_start_time_) / 1000));
+    if (on_audio_channel_opened_ != nullptr) {
+        on_audio_channel_opened_();
+    }
+
+    return true;
+}
+
+bool WebsocketProtocol::Connect(bool report_error) {
+    // Drop the old connection first, senders see no connection until the new one is ready
+    ReplaceWebSocket(nullptr);
+
+    // The settings may be reloaded by another task, work on a copy
+    std::string url, token;
+    {
+        std::lock_guard<std::mutex> lock(websocket_mutex_);
+        url = url_;
+        token = token_;
+    }
 
     auto network = Board::GetInstance().GetNetwork();
-    websocket_ = network->CreateWebSocket(1);
-    if (websocket_ == nullptr) {
+    auto websocket = network->CreateWebSocket(1);
+    if (websocket == nullptr) {
         ESP_LOGE(TAG, "Failed to create websocket");
         return false;
     }
 
     if (!token.empty()) {
-        // If token not has a space, add "Bearer " prefix
-        if (token.find(" ") == std::string::npos) {
-            token = "Bearer " + token;
-        }
-        websocket_->SetHeader("Authorization", token.c_str());
+        websocket->SetHeader("Authorization", token.c_str());
     }
-    websocket_->SetHeader("Protocol-Version", std::to_string(version_).c_str());
-    websocket_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    websocket_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    websocket->SetHeader("Protocol-Version", std::to_string(version_.load()).c_str());
+    websocket->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    websocket->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
 
-    websocket_->OnData([this](const char* data, size_t len, bool binary) {
+    websocket->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
             if (on_incoming_audio_ != nullptr) {
                 if (version_ == 2) {
@@ -164,23 +342,37 @@ bool WebsocketProtocol::OpenAudioChannel() {
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
-    websocket_->OnDisconnected([this]() {
+    websocket->OnDisconnected([this]() {
         ESP_LOGI(TAG, "Websocket disconnected");
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_CHANNEL
+        // A warm idle connection dropping is not a state change, the next tick reconnects
+        if (!channel_opened_) {
+            return;
+        }
+#endif
+        channel_opened_ = false;
         if (on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
     });
 
-    ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
-    if (!websocket_->Connect(url.c_str())) {
-        ESP_LOGE(TAG, "Failed to connect to websocket server, code=%d", websocket_->GetLastError());
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+    ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_.load());
+    if (!websocket->Connect(url.c_str())) {
+        ESP_LOGE(TAG, "Failed to connect to websocket server, code=%d", websocket->GetLastError());
+        if (report_error) {
+            SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+        }
         return false;
     }
 
     // Send hello message to describe the client
+    xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
     auto message = GetHelloMessage();
-    if (!SendText(message)) {
+    if (!websocket->Send(message)) {
+        ESP_LOGE(TAG, "Failed to send hello message");
+        if (report_error) {
+            SetError(Lang::Strings::SERVER_ERROR);
+        }
         return false;
     }
 
@@ -188,17 +380,26 @@ bool WebsocketProtocol::OpenAudioChannel() {
     EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
     if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
         ESP_LOGE(TAG, "Failed to receive server hello");
-        SetError(Lang::Strings::SERVER_TIMEOUT);
+        if (report_error) {
+            SetError(Lang::Strings::SERVER_TIMEOUT);
+        }
         return false;
     }
 
-    if (on_audio_channel_opened_ != nullptr) {
-        on_audio_channel_opened_();
-    }
-
+    ReplaceWebSocket(std::move(websocket));
     return true;
 }
 
+void WebsocketProtocol::ReplaceWebSocket(std::unique_ptr<WebSocket> websocket) {
+    std::unique_ptr<WebSocket> old;
+    {
+        std::lock_guard<std::mutex> lock(websocket_mutex_);
+        old = std::move(websocket_);
+        websocket_ = std::move(websocket);
+    }
+    // The old connection is closed outside the lock, its disconnect callback may take a while
+}
+
 std::string WebsocketProtocol::GetHelloMessage() {
     // keys: message type, version, audio_params (format, sample_rate, channels)
     cJSON* root = cJSON_CreateObject();
@@ -237,6 +438,8 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
+    ParseServerFeatures(root);
+
     auto audio_params = cJSON_GetObjectItem(root, "audio_params");
     if (cJSON_IsObject(audio_params)) {
         auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
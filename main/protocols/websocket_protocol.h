@@ -1,12 +1,16 @@
+
 #ifndef _WEBSOCKET_PROTOCOL_H_
 #define _WEBSOCKET_PROTOCOL_H_
 
-
 #include "protocol.h"
 
 #include <web_socket.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <esp_timer.h>
+
+#include <mutex>
+#include <atomic>
 
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
@@ -23,9 +27,34 @@ public:
 
 private:
     EventGroupHandle_t event_group_handle_;
+    // Connect runs on the open channel task while the main loop sends, a new connection is
+    // built aside and only published under the lock
+    mutable std::mutex websocket_mutex_;
     std::unique_ptr<WebSocket> websocket_;
-    int version_ = 1;
-
+    std::atomic<int> version_ = 1;
+
+    // Cached copy of the "websocket" settings namespace, url_ and token_ are guarded by
+    // websocket_mutex_. Settings::OnChanged clears settings_loaded_ from the writing task.
+    std::string url_;
+    std::string token_;
+    std::atomic<bool> settings_loaded_ = false;
+
+    // The websocket may stay connected while idle, so the channel state is tracked separately
+    std::atomic<bool> channel_opened_ = false;
+    esp_timer_handle_t keep_alive_timer_ = nullptr;
+    // Keep-alive reconnects run on their own task, serialized with OpenAudioChannel
+    std::atomic<bool> keep_alive_running_ = false;
+    std::mutex connect_mutex_;
+
+    // Latency measurement from the open request to the first uplink audio packet
+    int64_t open_start_time_ = 0;
+    bool first_packet_pending_ = false;
+
+    bool LoadSettings();
+    bool Connect(bool report_error);
+    void ReplaceWebSocket(std::unique_ptr<WebSocket> websocket);
+    void StartKeepAlive();
+    void KeepAlive();
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
@@ -1,88 +1,379 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
+namespace {
+
+enum EntryType {
+    kEntryAbsent,
+    kEntryString,
+    kEntryInt,
+    kEntryBool,
+};
+
+struct Entry {
+    EntryType type = kEntryAbsent;
+    std::string string_value;
+    int32_t int_value = 0;
+    bool dirty = false;
+};
+
+struct PendingWrite {
+    std::string key;
+    Entry entry;
+};
+
+// Keys read back right after a reboot or deep sleep wake, or that identify the device.
+// They are committed at once so a power cut right after the write cannot lose them.
+static const struct {
+    const char* ns;
+    const char* key;
+} kWriteThroughKeys[] = {
+    { "board", "uuid" },
+    { "board", "sleep_flag" },
+};
+
+// Namespaces that other components also write through the NVS API directly (esp-wifi-connect
+// keeps its SSID list in "wifi"). They are read from flash every time and written through.
+static const char* const kUncachedNamespaces[] = {
+    "wifi",
+};
+
+static bool IsUncached(const std::string& ns) {
+    for (auto name : kUncachedNamespaces) {
+        if (ns == name) {
+            return true;
+        }
+    }
+    return false;
 }
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+static bool IsWriteThrough(const std::string& ns, const std::string& key) {
+    if (IsUncached(ns)) {
+        return true;
+    }
+    for (auto& item : kWriteThroughKeys) {
+        if (ns == item.ns && key == item.key) {
+            return true;
         }
-        nvs_close(nvs_handle_);
     }
+    return false;
 }
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+struct Namespace {
+    nvs_handle_t read_handle = 0;
+    bool erase_all = false;     // Pending nvs_erase_all, uncached keys read as absent
+    uint32_t erase_count = 0;   // Tells a flush whether EraseAll was called again meanwhile
+    bool dirty = false;
+    std::map<std::string, Entry> entries;
+};
+
+class SettingsCache {
+public:
+    static SettingsCache& GetInstance() {
+        static SettingsCache instance;
+        return instance;
     }
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+    std::recursive_mutex mutex_;
+    std::map<std::string, Namespace> namespaces_;
+    std::vector<std::function<void(const std::string&, const std::string&)>> callbacks_;
+
+    Entry& Lookup(const std::string& ns, const std::string& key) {
+        auto& space = namespaces_[ns];
+        auto it = space.entries.find(key);
+        if (it != space.entries.end()) {
+            // Someone else may have written an uncached namespace since, read it again
+            if (!IsUncached(ns) || it->second.dirty) {
+                return it->second;
+            }
+            space.entries.erase(it);
+        }
+
+        auto& entry = space.entries[key];
+        if (space.erase_all) {
+            return entry;
+        }
+        if (space.read_handle == 0 && nvs_open(ns.c_str(), NVS_READONLY, &space.read_handle) != ESP_OK) {
+            space.read_handle = 0;
+            return entry;
+        }
+
+        nvs_type_t type;
+        if (nvs_find_key(space.read_handle, key.c_str(), &type) != ESP_OK) {
+            return entry;
+        }
+        if (type == NVS_TYPE_STR) {
+            size_t length = 0;
+            if (nvs_get_str(space.read_handle, key.c_str(), nullptr, &length) == ESP_OK) {
+                entry.string_value.resize(length);
+                ESP_ERROR_CHECK(nvs_get_str(space.read_handle, key.c_str(), entry.string_value.data(), &length));
+                while (!entry.string_value.empty() && entry.string_value.back() == '\0') {
+                    entry.string_value.pop_back();
+                }
+                entry.type = kEntryString;
+            }
+        } else if (type == NVS_TYPE_I32) {
+            if (nvs_get_i32(space.read_handle, key.c_str(), &entry.int_value) == ESP_OK) {
+                entry.type = kEntryInt;
+            }
+        } else if (type == NVS_TYPE_U8) {
+            uint8_t value;
+            if (nvs_get_u8(space.read_handle, key.c_str(), &value) == ESP_OK) {
+                entry.int_value = value;
+                entry.type = kEntryBool;
+            }
+        }
+        return entry;
+    }
+
+    void Store(const std::string& ns, const std::string& key, EntryType type, const std::string& string_value, int32_t int_value) {
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            auto& entry = Lookup(ns, key);
+            if (entry.type == type && entry.string_value == string_value && entry.int_value == int_value) {
+                return;
+            }
+            entry.type = type;
+            entry.string_value = string_value;
+            entry.int_value = int_value;
+            entry.dirty = true;
+            namespaces_[ns].dirty = true;
+        }
+        if (IsWriteThrough(ns, key)) {
+            Flush();
+        } else {
+            ScheduleCommit();
+        }
+        NotifyChanged(ns, key);
+    }
+
+    void EraseAll(const std::string& ns) {
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            auto& space = namespaces_[ns];
+            space.entries.clear();
+            space.erase_all = true;
+            space.erase_count++;
+            space.dirty = true;
+        }
+        if (IsUncached(ns)) {
+            Flush();
+        } else {
+            ScheduleCommit();
+        }
+        NotifyChanged(ns, "");
+    }
+
+    // The dirty entries are copied under the lock and written outside of it, so readers don't
+    // wait for the flash. Runs on the esp_timer task too, so errors are logged and retried.
+    void Flush() {
+        std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+        esp_timer_stop(commit_timer_);
+
+        struct Pending {
+            std::string ns;
+            bool erase_all;
+            uint32_t erase_count;
+            std::vector<PendingWrite> writes;
+        };
+        std::vector<Pending> pending;
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            for (auto& [ns, space] : namespaces_) {
+                if (!space.dirty) {
+                    continue;
+                }
+                Pending item = { ns, space.erase_all, space.erase_count, {} };
+                for (auto& [key, entry] : space.entries) {
+                    if (entry.dirty) {
+                        item.writes.push_back({ key, entry });
+                        entry.dirty = false;
+                    }
+                }
+                space.dirty = false;
+                pending.push_back(std::move(item));
+            }
+        }
+
+        bool failed = false;
+        for (auto& item : pending) {
+            esp_err_t err = Commit(item.ns, item.erase_all, item.writes);
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            auto& space = namespaces_[item.ns];
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to commit namespace %s: %s", item.ns.c_str(), esp_err_to_name(err));
+                // Mark the entries again, unless EraseAll dropped them meanwhile
+                for (auto& write : item.writes) {
+                    auto it = space.entries.find(write.key);
+                    if (it != space.entries.end()) {
+                        it->second.dirty = true;
+                    }
+                }
+                space.dirty = true;
+                failed = true;
+                continue;
+            }
+            // Until now uncached keys had to read as absent
+            if (item.erase_all && space.erase_count == item.erase_count) {
+                space.erase_all = false;
+            }
+            ESP_LOGI(TAG, "Committed %u change(s) to namespace %s", item.writes.size() + (item.erase_all ? 1 : 0), item.ns.c_str());
+
+            // The namespace may not have existed when it was first read
+            if (space.read_handle == 0) {
+                nvs_open(item.ns.c_str(), NVS_READONLY, &space.read_handle);
+            }
+        }
+        if (failed) {
+            ScheduleCommit();
+        }
+    }
+
+private:
+    esp_timer_handle_t commit_timer_ = nullptr;
+    // Serializes flushes, the cache lock is only held to copy and mark entries
+    std::mutex flush_mutex_;
+
+    static esp_err_t Commit(const std::string& ns, bool erase_all, const std::vector<PendingWrite>& writes) {
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (erase_all) {
+            err = nvs_erase_all(handle);
+        }
+        for (auto it = writes.begin(); err == ESP_OK && it != writes.end(); ++it) {
+            auto& key = it->key;
+            auto& entry = it->entry;
+            switch (entry.type) {
+                case kEntryString:
+                    err = nvs_set_str(handle, key.c_str(), entry.string_value.c_str());
+                    break;
+                case kEntryInt:
+                    err = nvs_set_i32(handle, key.c_str(), entry.int_value);
+                    break;
+                case kEntryBool:
+                    err = nvs_set_u8(handle, key.c_str(), entry.int_value ? 1 : 0);
+                    break;
+                case kEntryAbsent:
+                    err = nvs_erase_key(handle, key.c_str());
+                    if (err == ESP_ERR_NVS_NOT_FOUND) {
+                        err = ESP_OK;
+                    }
+                    break;
+            }
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+        return err;
     }
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    SettingsCache() {
+        esp_timer_create_args_t commit_timer_args = {
+            .callback = [](void* arg) {
+                ((SettingsCache*)arg)->Flush();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "settings_commit",
+            .skip_unhandled_events = true
+        };
+        esp_timer_create(&commit_timer_args, &commit_timer_);
+
+        // Make sure nothing is lost on esp_restart()
+        esp_register_shutdown_handler([]() {
+            SettingsCache::GetInstance().Flush();
+        });
+    }
+
+    void ScheduleCommit() {
+        // Restart the timer so a burst of writes ends up in a single commit
+        esp_timer_stop(commit_timer_);
+        esp_timer_start_once(commit_timer_, SETTINGS_COMMIT_DELAY_MS * 1000);
+    }
+
+    void NotifyChanged(const std::string& ns, const std::string& key) {
+        std::vector<std::function<void(const std::string&, const std::string&)>> callbacks;
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            callbacks = callbacks_;
+        }
+        for (auto& callback : callbacks) {
+            callback(ns, key);
+        }
+    }
+};
+
+} // namespace
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+Settings::~Settings() {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    auto& cache = SettingsCache::GetInstance();
+    std::lock_guard<std::recursive_mutex> lock(cache.mutex_);
+    auto& entry = cache.Lookup(ns_, key);
+    if (entry.type != kEntryString) {
+        return default_value;
     }
-    return value;
+    return entry.string_value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingsCache::GetInstance().Store(ns_, key, kEntryString, value, 0);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
+    auto& cache = SettingsCache::GetInstance();
+    std::lock_guard<std::recursive_mutex> lock(cache.mutex_);
+    auto& entry = cache.Lookup(ns_, key);
+    if (entry.type != kEntryInt) {
         return default_value;
     }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value;
+    return entry.int_value;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingsCache::GetInstance().Store(ns_, key, kEntryInt, "", value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
+    auto& cache = SettingsCache::GetInstance();
+    std::lock_guard<std::recursive_mutex> lock(cache.mutex_);
+    auto& entry = cache.Lookup(ns_, key);
+    if (entry.type != kEntryBool) {
         return default_value;
     }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value != 0;
+    return entry.int_value != 0;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        SettingsCache::GetInstance().Store(ns_, key, kEntryBool, "", value ? 1 : 0);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,10 +381,7 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsCache::GetInstance().Store(ns_, key, kEntryAbsent, "", 0);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,8 +389,18 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsCache::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
+
+void Settings::Flush() {
+    SettingsCache::GetInstance().Flush();
+}
+
+void Settings::OnChanged(std::function<void(const std::string& ns, const std::string& key)> callback) {
+    auto& cache = SettingsCache::GetInstance();
+    std::lock_guard<std::recursive_mutex> lock(cache.mutex_);
+    cache.callbacks_.push_back(callback);
+}
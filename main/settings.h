@@ -2,8 +2,18 @@
 #define SETTINGS_H
 
 #include <string>
+#include <functional>
 #include <nvs_flash.h>
 
+// Writes are kept in memory and committed to NVS in one batch after this delay
+#define SETTINGS_COMMIT_DELAY_MS 3000
+
+// Settings is a light view over a process-wide cache of NVS namespaces.
+// Each key is read from flash at most once, writes are coalesced and committed
+// by a debounce timer, on Flush(), or right before the chip restarts. Deep sleep
+// does not run the shutdown handlers, so call Flush() before esp_deep_sleep_start()
+// or before cutting the power latch. A few critical keys are written through, and
+// namespaces that other components write directly (e.g. "wifi") are not cached.
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
@@ -18,11 +28,14 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Commit all pending writes now, e.g. before deep sleep or on a power loss warning
+    static void Flush();
+    // Called with the namespace and key after a value is changed or erased
+    static void OnChanged(std::function<void(const std::string& ns, const std::string& key)> callback);
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
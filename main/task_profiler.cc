@@ -0,0 +1,107 @@
+#include "task_profiler.h"
+#include "task_registry.h"
+#include "memory_arena.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "TaskProfiler"
+
+void TaskProfiler::Start(int interval_ms) {
+    if (task_handle_ != nullptr) {
+        return;
+    }
+    previous_ = (TaskStatus_t*)MemoryArena::Allocate(kMemorySystem, sizeof(TaskStatus_t) * kMaxTasks);
+    current_ = (TaskStatus_t*)MemoryArena::Allocate(kMemorySystem, sizeof(TaskStatus_t) * kMaxTasks);
+    if (previous_ == nullptr || current_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate task state buffers");
+        MemoryArena::Free(kMemorySystem, previous_);
+        MemoryArena::Free(kMemorySystem, current_);
+        previous_ = current_ = nullptr;
+        return;
+    }
+
+    interval_ms_ = interval_ms;
+    previous_count_ = uxTaskGetSystemState(previous_, kMaxTasks, &previous_run_time_);
+    TaskRegistry::Create(kTaskProfiler, [](void* arg) {
+        ((TaskProfiler*)arg)->ProfilerTask();
+        vTaskDelete(NULL);
+    }, this, &task_handle_);
+}
+
+void TaskProfiler::ProfilerTask() {
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(interval_ms_));
+        Sample();
+    }
+}
+
+void TaskProfiler::Sample() {
+    configRUN_TIME_COUNTER_TYPE run_time;
+    UBaseType_t count = uxTaskGetSystemState(current_, kMaxTasks, &run_time);
+    if (count == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, sampling skipped", kMaxTasks);
+        return;
+    }
+
+    // Run time counters are in microseconds and keep running on every core
+    uint64_t elapsed = (uint64_t)(run_time - previous_run_time_) * CONFIG_FREERTOS_NUMBER_OF_CORES;
+    if (elapsed > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_count_ = 0;
+        for (UBaseType_t i = 0; i < count; i++) {
+            auto& task = current_[i];
+            configRUN_TIME_COUNTER_TYPE last_counter = 0;
+            for (UBaseType_t j = 0; j < previous_count_; j++) {
+                if (previous_[j].xHandle == task.xHandle) {
+                    last_counter = previous_[j].ulRunTimeCounter;
+                    break;
+                }
+            }
+
+            auto& stats = stats_[stats_count_++];
+            strncpy(stats.name, task.pcTaskName, sizeof(stats.name) - 1);
+            stats.name[sizeof(stats.name) - 1] = '\0';
+            stats.priority = task.uxCurrentPriority;
+            stats.cpu_permille = (uint64_t)(task.ulRunTimeCounter - last_counter) * 1000 / elapsed;
+            stats.stack_free_min = task.usStackHighWaterMark * sizeof(StackType_t);
+        }
+        std::sort(stats_, stats_ + stats_count_, [](const TaskStats& a, const TaskStats& b) {
+            return a.cpu_permille > b.cpu_permille;
+        });
+        window_ms_ = (run_time - previous_run_time_) / 1000;
+    }
+
+    std::swap(previous_, current_);
+    previous_count_ = count;
+    previous_run_time_ = run_time;
+}
+
+cJSON* TaskProfiler::GetStatsJson() {
+    auto json = cJSON_CreateObject();
+    std::lock_guard<std::mutex> lock(mutex_);
+    cJSON_AddNumberToObject(json, "window_ms", window_ms_);
+    cJSON_AddNumberToObject(json, "cores", CONFIG_FREERTOS_NUMBER_OF_CORES);
+    auto tasks = cJSON_AddArrayToObject(json, "tasks");
+    for (int i = 0; i < stats_count_; i++) {
+        auto& stats = stats_[i];
+        auto task = cJSON_CreateObject();
+        cJSON_AddStringToObject(task, "name", stats.name);
+        cJSON_AddNumberToObject(task, "priority", stats.priority);
+        cJSON_AddNumberToObject(task, "cpu_percent", stats.cpu_permille / 10.0);
+        cJSON_AddNumberToObject(task, "stack_free_min", stats.stack_free_min);
+        cJSON_AddItemToArray(tasks, task);
+    }
+    return json;
+}
+
+void TaskProfiler::PrintStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ESP_LOGI(TAG, "%d tasks over %lu ms", stats_count_, window_ms_);
+    for (int i = 0; i < stats_count_; i++) {
+        auto& stats = stats_[i];
+        ESP_LOGI(TAG, "| %-16s | prio %2u | %3lu.%lu%% | stack free %5lu",
+            stats.name, stats.priority, stats.cpu_permille / 10, stats.cpu_permille % 10, stats.stack_free_min);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef _TASK_PROFILER_H_
+#define _TASK_PROFILER_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cJSON.h>
+
+#include <mutex>
+
+/*
+ * Samples the CPU share and stack high water mark of every task in the background.
+ * The task state buffers are allocated once at Start, each sample only diffs the run
+ * time counters against the previous one, so it can stay enabled while tuning the
+ * placement in TaskRegistry.
+ */
+class TaskProfiler {
+public:
+    static constexpr int kMaxTasks = 48;
+
+    static TaskProfiler& GetInstance() {
+        static TaskProfiler instance;
+        return instance;
+    }
+    TaskProfiler(const TaskProfiler&) = delete;
+    TaskProfiler& operator=(const TaskProfiler&) = delete;
+
+    void Start(int interval_ms);
+    // Tasks of the latest sample, busiest first
+    cJSON* GetStatsJson();
+    void PrintStats();
+
+private:
+    struct TaskStats {
+        char name[configMAX_TASK_NAME_LEN];
+        UBaseType_t priority;
+        uint32_t cpu_permille;      // Share of all cores over the interval
+        uint32_t stack_free_min;    // Bytes never touched since the task started
+    };
+
+    TaskProfiler() = default;
+
+    int interval_ms_ = 0;
+    TaskHandle_t task_handle_ = nullptr;
+    TaskStatus_t* previous_ = nullptr;
+    TaskStatus_t* current_ = nullptr;
+    UBaseType_t previous_count_ = 0;
+    configRUN_TIME_COUNTER_TYPE previous_run_time_ = 0;
+
+    std::mutex mutex_;
+    TaskStats stats_[kMaxTasks];
+    int stats_count_ = 0;
+    uint32_t window_ms_ = 0;
+
+    void ProfilerTask();
+    void Sample();
+};
+
+#endif // _TASK_PROFILER_H_
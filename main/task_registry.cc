@@ -0,0 +1,49 @@
+#include "task_registry.h"
+
+#include <esp_log.h>
+
+#define TAG "TaskRegistry"
+
+#if CONFIG_USE_AUDIO_PROCESSOR
+#define AUDIO_INPUT_STACK_SIZE  (2048 * 3)
+#define AUDIO_OUTPUT_STACK_SIZE (2048 * 2)
+#else
+#define AUDIO_INPUT_STACK_SIZE  (2048 * 2)
+#define AUDIO_OUTPUT_STACK_SIZE 2048
+#endif
+
+// The AFE runs its own tasks on core 1 (afe_perferred_core), so it is fed from core 0.
+// Everything else is left to the scheduler on every target.
+#if CONFIG_USE_AUDIO_PROCESSOR && !CONFIG_FREERTOS_UNICORE
+#define AUDIO_INPUT_CORE        0
+#else
+#define AUDIO_INPUT_CORE        tskNO_AFFINITY
+#endif
+
+// Indexed by TaskId
+static const TaskPlan kTaskPlans[] = {
+    { "main_event_loop",     2048 * 4,                3, tskNO_AFFINITY },
+    { "audio_input",         AUDIO_INPUT_STACK_SIZE,  8, AUDIO_INPUT_CORE },
+    { "audio_output",        AUDIO_OUTPUT_STACK_SIZE, 4, tskNO_AFFINITY },
+    { "opus_codec",          2048 * 13,               2, tskNO_AFFINITY },
+    { "audio_communication", 4096,                    3, tskNO_AFFINITY },
+    { "audio_detection",     4096,                    3, tskNO_AFFINITY },
+    { "epd_mgr",             4096,                    4, tskNO_AFFINITY },
+    { "open_channel",        2048 * 4,                4, tskNO_AFFINITY },
+    { "ws_keep_alive",       2048 * 4,                2, tskNO_AFFINITY },
+    { "task_profiler",       3072,                    1, tskNO_AFFINITY },
+};
+static_assert(sizeof(kTaskPlans) / sizeof(kTaskPlans[0]) == kTaskCount, "One plan per TaskId");
+
+const TaskPlan& TaskRegistry::GetPlan(TaskId id) {
+    return kTaskPlans[id];
+}
+
+BaseType_t TaskRegistry::Create(TaskId id, TaskFunction_t function, void* arg, TaskHandle_t* handle) {
+    auto& plan = kTaskPlans[id];
+    auto ret = xTaskCreatePinnedToCore(function, plan.name, plan.stack_size, arg, plan.priority, handle, plan.core_id);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task %s (stack %lu)", plan.name, plan.stack_size);
+    }
+    return ret;
+}
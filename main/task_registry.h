@@ -0,0 +1,39 @@
+#ifndef _TASK_REGISTRY_H_
+#define _TASK_REGISTRY_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+enum TaskId {
+    kTaskMainEventLoop,
+    kTaskAudioInput,
+    kTaskAudioOutput,
+    kTaskOpusCodec,
+    kTaskAudioCommunication,
+    kTaskAudioDetection,
+    kTaskEpdManager,
+    kTaskOpenChannel,
+    kTaskKeepAlive,
+    kTaskProfiler,
+    kTaskCount
+};
+
+struct TaskPlan {
+    const char* name;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    BaseType_t core_id;     // tskNO_AFFINITY to let the scheduler pick
+};
+
+/*
+ * Placement of the firmware's own tasks in one table, so that priority, stack budget and
+ * core affinity can be tuned side by side with TaskProfiler. Board specific tasks keep
+ * creating themselves.
+ */
+class TaskRegistry {
+public:
+    static const TaskPlan& GetPlan(TaskId id);
+    static BaseType_t Create(TaskId id, TaskFunction_t function, void* arg, TaskHandle_t* handle = nullptr);
+};
+
+#endif // _TASK_REGISTRY_H_
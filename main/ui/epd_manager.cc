@@ -2,6 +2,7 @@
 
 #include "board.h"
 #include "display.h"
+#include "task_registry.h"
 #include "esp_log.h"
 
 #include <algorithm>
@@ -13,8 +14,6 @@
 namespace {
 constexpr size_t kCommandQueueLength = 10;
 constexpr TickType_t kQueueWaitTicks = pdMS_TO_TICKS(100);
-constexpr uint32_t kTaskStackSize = 4096;
-constexpr UBaseType_t kTaskPriority = 4;
 }
 
 struct EpdManager::Command {
@@ -31,6 +30,7 @@ struct EpdManager::Command {
     std::vector<std::string> menu_items;
     int selected_index = 0;
     bool is_user = false;
+    bool append = false;
     std::string text_en;
     std::string text_cn;
     std::string card_html;
@@ -72,7 +72,7 @@ void EpdManager::EnsureTaskCreated() {
     }
 
     if (!task_handle_) {
-        BaseType_t res = xTaskCreate(&EpdManager::TaskEntry, "epd_mgr", kTaskStackSize, this, kTaskPriority, &task_handle_);
+        BaseType_t res = TaskRegistry::Create(kTaskEpdManager, &EpdManager::TaskEntry, this, &task_handle_);
         if (res != pdPASS) {
             ESP_LOGE(TAG, "Failed to create EPD task (%d)", res);
             task_handle_ = nullptr;
@@ -163,7 +163,11 @@ void EpdManager::ProcessCommand(Command& cmd) {
                 cmd.text_en.c_str(),
                 cmd.text_cn.c_str());
 
-            conversation_history_.push_back({cmd.is_user, cmd.text_en, cmd.text_cn});
+            if (cmd.append && !conversation_history_.empty() && conversation_history_.back().is_user == cmd.is_user) {
+                conversation_history_.back().en += cmd.text_en;
+            } else {
+                conversation_history_.push_back({cmd.is_user, cmd.text_en, cmd.text_cn});
+            }
             if ((int)conversation_history_.size() > kMaxConversationHistory) {
                 conversation_history_.erase(conversation_history_.begin());
             }
@@ -283,6 +287,19 @@ void EpdManager::UpdateConversationSide(bool is_user, const std::string& text_en
     DispatchCommand(cmd);
 }
 
+void EpdManager::AppendConversationSide(bool is_user, const std::string& text_en) {
+    Command* cmd = new (std::nothrow) Command();
+    if (!cmd) {
+        ESP_LOGE(TAG, "Failed to allocate command for AppendConversationSide");
+        return;
+    }
+    cmd->type = Command::Type::UPDATE_CONVERSATION;
+    cmd->is_user = is_user;
+    cmd->append = true;
+    cmd->text_en = text_en;
+    DispatchCommand(cmd);
+}
+
 void EpdManager::SetActiveScreen(int screen_id) {
     Command* cmd = new (std::nothrow) Command();
     if (!cmd) {
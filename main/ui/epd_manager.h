@@ -17,6 +17,8 @@ public:
     void ShowMainMenu(const std::vector<std::string>& items, int selected_index);
     void ShowWordCard(const std::string& card_html);
     void UpdateConversationSide(bool is_user, const std::string& text_en, const std::string& text_cn);
+    // Extend the latest entry of the same side instead of adding a new one, e.g. streamed TTS sentences
+    void AppendConversationSide(bool is_user, const std::string& text_en);
     void SetActiveScreen(int screen_id);
     // Set button hints (6 entries) to be shown on screen
     void SetButtonHints(const std::array<std::string, 6>& hints);
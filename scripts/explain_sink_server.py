@@ -0,0 +1,102 @@
+import argparse
+import json
+import struct
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+'''
+  A local sink for the camera explain upload (self.camera.take_photo).
+  It accepts the chunked multipart POST sent by Esp32Camera::Explain and prints, for every upload,
+  the JPEG resolution and size, the time from the request headers to the first and the last body byte,
+  and the effective upload rate. Run it with the camera at 640x480 and at 1280x720 and compare with
+  the device log line "Capture to upload: ... ms (first JPEG chunk after ... ms ...)".
+
+  Point the device at it by returning http://<host>:<port>/explain as the vision url
+  in the MCP initialize capabilities of your server.
+'''
+def now_ms():
+    return time.monotonic() * 1000
+
+
+def jpeg_size(data):
+    # Walk the markers up to the first SOFn segment
+    i = 2
+    while i + 9 < len(data):
+        if data[i] != 0xFF:
+            return None
+        marker = data[i + 1]
+        length = struct.unpack('>H', data[i + 2:i + 4])[0]
+        if 0xC0 <= marker <= 0xCF and marker not in (0xC4, 0xC8, 0xCC):
+            height, width = struct.unpack('>HH', data[i + 5:i + 9])
+            return width, height
+        i += 2 + length
+    return None
+
+
+class ExplainHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def read_chunked(self, on_first_byte):
+        body = bytearray()
+        while True:
+            line = self.rfile.readline()
+            size = int(line.split(b';')[0].strip() or b'0', 16)
+            if size == 0:
+                self.rfile.readline()
+                return bytes(body)
+            chunk = self.rfile.read(size)
+            if not body:
+                on_first_byte()
+            body += chunk
+            self.rfile.readline()
+
+    def do_POST(self):
+        headers_time = now_ms()
+        first_byte_time = None
+
+        def mark_first_byte():
+            nonlocal first_byte_time
+            first_byte_time = now_ms()
+
+        if self.headers.get('Transfer-Encoding', '').lower() == 'chunked':
+            body = self.read_chunked(mark_first_byte)
+        else:
+            body = self.rfile.read(int(self.headers.get('Content-Length', 0)))
+            mark_first_byte()
+        done_time = now_ms()
+
+        start = body.find(b'\xff\xd8')
+        end = body.rfind(b'\xff\xd9')
+        jpeg = body[start:end + 2] if start >= 0 and end > start else b''
+        size = jpeg_size(jpeg) if jpeg else None
+        elapsed = done_time - headers_time
+        rate = len(body) / elapsed if elapsed > 0 else 0
+        print(f"{self.client_address[0]} {size[0] if size else '?'}x{size[1] if size else '?'} "
+              f"jpeg {len(jpeg)} bytes, body {len(body)} bytes: first byte {first_byte_time - headers_time:.0f} ms, "
+              f"complete {elapsed:.0f} ms, {rate:.1f} KB/s")
+
+        reply = json.dumps({"success": True, "result": f"received {len(jpeg)} bytes"}).encode()
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(reply)))
+        self.end_headers()
+        self.wfile.write(reply)
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Local sink for camera explain uploads')
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=8090)
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.host, args.port), ExplainHandler)
+    print(f"Listening on http://{args.host}:{args.port}/explain")
+    server.serve_forever()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,80 @@
+import argparse
+import json
+import subprocess
+import sys
+
+
+'''
+  Symbolizes the heap hotspots reported by a firmware built with CONFIG_USE_HEAP_PROFILER.
+  The input is either the JSON returned by the self.get_heap_hotspots MCP tool or a device log
+  containing "HEAP_HOTSPOTS {...}" lines, the latest dump in the input is decoded.
+
+    idf.py monitor | tee monitor.log
+    python scripts/heap_hotspots.py build/xiaozhi.elf monitor.log
+
+  addr2line defaults to the Xtensa ESP32-S3 toolchain, pass --addr2line for other chips,
+  e.g. riscv32-esp-elf-addr2line for the ESP32-C3 and C6.
+'''
+def load_dump(text):
+    dump = None
+    for line in text.splitlines():
+        marker = line.find('HEAP_HOTSPOTS ')
+        if marker >= 0:
+            dump = json.loads(line[marker + len('HEAP_HOTSPOTS '):].strip())
+    if dump is None:
+        dump = json.loads(text)
+    return dump
+
+
+def symbolize(addr2line, elf, pcs):
+    if not pcs:
+        return {}
+    output = subprocess.run([addr2line, '-pfiaC', '-e', elf, *pcs],
+                            capture_output=True, text=True, check=True).stdout
+    # Every address starts a block with "0x...: ", inlined frames follow as " (inlined by) ..."
+    symbols = {}
+    current = None
+    for line in output.splitlines():
+        if line.startswith('0x'):
+            address, _, location = line.partition(': ')
+            current = f"0x{int(address, 16):08x}"
+            symbols[current] = [location]
+        elif current is not None:
+            symbols[current].append(line.strip())
+    return symbols
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Symbolize heap profiler hotspots against the firmware ELF')
+    parser.add_argument('elf', help='firmware ELF, usually build/xiaozhi.elf')
+    parser.add_argument('dump', nargs='?', help='MCP tool result or device log, stdin by default')
+    parser.add_argument('--addr2line', default='xtensa-esp32s3-elf-addr2line')
+    args = parser.parse_args()
+
+    text = open(args.dump, encoding='utf-8', errors='replace').read() if args.dump else sys.stdin.read()
+    dump = load_dump(text)
+    if 'error' in dump:
+        sys.exit(dump['error'])
+
+    sites = dump.get('sites', [])
+    symbols = symbolize(args.addr2line, args.elf, [s['pc'] for s in sites if s['pc'] != 'other'])
+
+    print(f"Interval {dump.get('interval_s', 0):.1f}s, untracked blocks {dump.get('untracked_blocks', 0)}")
+    print(f"{'live bytes':>12} {'blocks':>7} {'allocs/s':>9}  call site")
+    for site in sites:
+        frames = symbols.get(site['pc'], ['(table overflow)' if site['pc'] == 'other' else '??'])
+        print(f"{site['live_bytes']:>12} {site['live_blocks']:>7} {site['allocs_per_s']:>9.1f}  {site['pc']} {frames[0]}")
+        for frame in frames[1:]:
+            print(f"{'':>31}  {frame}")
+
+    print()
+    print(f"{'heap':<10} {'free':>10} {'largest':>10} {'min free':>10} {'blocks':>7}  fragmentation")
+    for heap in dump.get('heaps', []):
+        free = heap['free']
+        fragmentation = 1 - heap['largest_free_block'] / free if free else 0
+        print(f"{heap['caps']:<10} {free:>10} {heap['largest_free_block']:>10} {heap['min_free']:>10} "
+              f"{heap['free_blocks']:>7}  {fragmentation:.0%}")
+
+
+if __name__ == '__main__':
+    main()
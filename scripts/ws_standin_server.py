@@ -0,0 +1,125 @@
+import argparse
+import asyncio
+import json
+import random
+import time
+import uuid
+
+import websockets
+
+
+'''
+  A minimal local stand-in for the xiaozhi websocket server.
+  It answers the client hello, accepts uplink audio and prints timing of each session:
+  TCP accept -> client hello -> first audio packet after every "listen" message.
+
+  Point the device at it by setting the "websocket" NVS namespace url to ws://<host>:<port>/
+  and compare the device log line "First audio packet sent ... ms after opening the channel"
+  with CONFIG_WEBSOCKET_KEEP_ALIVE_CHANNEL enabled and disabled.
+
+  --hello-delay holds the server hello back (a fixed value or a min-max range in ms) to check that
+  the device stays responsive while connecting: buttons and the clock keep working, and the audio
+  captured meanwhile arrives as a burst right after the listen message ("backlog" below).
+
+  --tts-after answers every listen start with a short silent TTS reply after the given delay, so the
+  device log line "Wake to first TTS audio: ... ms" can be checked without a real server.
+
+  Requires: pip install websockets
+'''
+def now_ms():
+    return time.monotonic() * 1000
+
+
+# Packets arriving this soon after the listen message were captured before it
+BACKLOG_WINDOW_MS = 100
+hello_delay_ms = (0, 0)
+tts_after_ms = None
+# A TOC-only Opus packet (SILK WB, 60 ms): decoders conceal it as silence
+SILENT_OPUS_FRAME = bytes([0x58])
+
+
+async def send_fake_tts(websocket, session_id):
+    await asyncio.sleep(tts_after_ms / 1000)
+    try:
+        await websocket.send(json.dumps({"session_id": session_id, "type": "tts", "state": "start"}))
+        for _ in range(10):
+            await websocket.send(SILENT_OPUS_FRAME)
+            await asyncio.sleep(0.06)
+        await websocket.send(json.dumps({"session_id": session_id, "type": "tts", "state": "stop"}))
+        print(f"[{session_id}] sent fake TTS reply")
+    except websockets.ConnectionClosed:
+        pass
+
+
+async def handle(websocket):
+    accepted = now_ms()
+    session_id = uuid.uuid4().hex[:8]
+    peer = websocket.remote_address
+    listen_time = None
+    backlog_start = None
+    backlog_packets = 0
+    print(f"[{session_id}] connection from {peer}")
+
+    try:
+        async for message in websocket:
+            if isinstance(message, bytes):
+                if listen_time is not None:
+                    print(f"[{session_id}] first audio packet {now_ms() - listen_time:.0f} ms after listen, "
+                          f"{len(message)} bytes")
+                    listen_time = None
+                if backlog_start is not None:
+                    if now_ms() - backlog_start <= BACKLOG_WINDOW_MS:
+                        backlog_packets += 1
+                    else:
+                        print(f"[{session_id}] backlog: {backlog_packets} packets within {BACKLOG_WINDOW_MS} ms of listen")
+                        backlog_start = None
+                continue
+
+            data = json.loads(message)
+            msg_type = data.get("type")
+            if msg_type == "hello":
+                print(f"[{session_id}] client hello {now_ms() - accepted:.0f} ms after accept")
+                delay = random.uniform(*hello_delay_ms)
+                if delay > 0:
+                    print(f"[{session_id}] holding server hello for {delay:.0f} ms")
+                    await asyncio.sleep(delay / 1000)
+                await websocket.send(json.dumps({
+                    "type": "hello",
+                    "transport": "websocket",
+                    "session_id": session_id,
+                    "audio_params": {"format": "opus", "sample_rate": 24000, "channels": 1, "frame_duration": 60},
+                }))
+            elif msg_type == "listen":
+                print(f"[{session_id}] listen {data.get('state')} {data.get('mode', data.get('text', ''))}")
+                if data.get("state") in ("detect", "start") and listen_time is None:
+                    listen_time = now_ms()
+                if data.get("state") == "start":
+                    backlog_start = now_ms()
+                    backlog_packets = 0
+                    if tts_after_ms is not None:
+                        asyncio.create_task(send_fake_tts(websocket, session_id))
+            else:
+                print(f"[{session_id}] {message}")
+    except websockets.ConnectionClosed:
+        pass
+    print(f"[{session_id}] closed after {(now_ms() - accepted) / 1000:.1f} s")
+
+
+async def main(host, port):
+    async with websockets.serve(handle, host, port):
+        print(f"Websocket stand-in server listening on ws://{host}:{port}/")
+        await asyncio.Future()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='本地 WebSocket 测试服务器，用于测量唤醒到首包延迟')
+    parser.add_argument('--host', default='0.0.0.0', help='监听地址 (默认: 0.0.0.0)')
+    parser.add_argument('--port', '-p', type=int, default=8000, help='监听端口 (默认: 8000)')
+    parser.add_argument('--hello-delay', default='0', help='延迟回复 hello 的毫秒数，可以是范围如 500-3000 (默认: 0)')
+    parser.add_argument('--tts-after', type=float, default=None, help='收到 listen start 后多少毫秒回复一段静音 TTS (默认: 不回复)')
+
+    args = parser.parse_args()
+    low, _, high = args.hello_delay.partition('-')
+    hello_delay_ms = (float(low), float(high or low))
+    tts_after_ms = args.tts_after
+    asyncio.run(main(args.host, args.port))
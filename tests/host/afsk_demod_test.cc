@@ -0,0 +1,181 @@
+#include "afsk_demod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace audio_wifi_config;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static const int kInputSampleRate = 16000;
+
+// The frame scripts/sonic_wifi_config.html plays: start bytes, text, checksum, end bytes, MSB first
+static std::vector<uint8_t> FrameBits(const std::string& text) {
+    std::vector<uint8_t> bytes = { 0x01, 0x02 };
+    bytes.insert(bytes.end(), text.begin(), text.end());
+    bytes.push_back(AudioDataBuffer::CalculateChecksum(text));
+    bytes.push_back(0x03);
+    bytes.push_back(0x04);
+
+    std::vector<uint8_t> bits;
+    for (uint8_t byte : bytes) {
+        for (int i = 7; i >= 0; i--) {
+            bits.push_back((byte >> i) & 1);
+        }
+    }
+    return bits;
+}
+
+// Phase continuous AFSK at the microphone rate, after some silence, with white noise on top
+static std::vector<int16_t> Modulate(const std::vector<uint8_t>& bits, int bit_rate, int mark, int space,
+                                     double noise_sigma) {
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0, noise_sigma);
+    int samples_per_bit = kInputSampleRate / bit_rate;
+    int lead_in = kInputSampleRate / 4;
+
+    std::vector<int16_t> pcm;
+    for (int n = 0; n < lead_in; n++) {
+        pcm.push_back((int16_t)noise(rng));
+    }
+    double phase = 0;
+    for (uint8_t bit : bits) {
+        double step = 2 * M_PI * (bit ? mark : space) / kInputSampleRate;
+        for (int n = 0; n < samples_per_bit; n++) {
+            double value = 12000 * std::sin(phase) + noise(rng);
+            pcm.push_back((int16_t)std::max(-32768.0, std::min(32767.0, value)));
+            phase += step;
+        }
+    }
+    return pcm;
+}
+
+// Decimates to kAudioSampleRate the way ReceiveWifiCredentialsFromAudio does and returns the bits
+static std::vector<uint8_t> Demodulate(const std::vector<int16_t>& pcm, int bit_rate, int mark, int space,
+                                       AudioDataBuffer& data_buffer, bool& decoded) {
+    size_t window_size = kAudioSampleRate / bit_rate;
+    AudioSignalProcessor signal_processor(kAudioSampleRate, mark, space, bit_rate, window_size);
+    std::vector<float> probabilities;
+    std::vector<uint8_t> bits;
+    size_t downsample_phase = 0;
+    decoded = false;
+    for (int16_t sample : pcm) {
+        downsample_phase += kAudioSampleRate;
+        if (downsample_phase < kInputSampleRate) {
+            continue;
+        }
+        downsample_phase -= kInputSampleRate;
+        float probability;
+        if (signal_processor.ProcessSample(sample, probability)) {
+            bits.push_back(probability > 0.5f);
+            probabilities.assign(1, probability);
+            decoded |= data_buffer.ProcessProbabilityData(probabilities, 0.5f);
+        }
+    }
+    return bits;
+}
+
+static bool ContainsBits(const std::vector<uint8_t>& haystack, const std::vector<uint8_t>& needle) {
+    for (size_t i = 0; i + needle.size() <= haystack.size(); i++) {
+        if (std::equal(needle.begin(), needle.end(), haystack.begin() + i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void TestRoundTrip(int bit_rate, int mark, int space, double noise_sigma) {
+    const std::string text = "xiaozhi-ap\n12345678";
+    auto frame = FrameBits(text);
+    // The page loops the clip, the first pass also lets the decision point settle
+    std::vector<uint8_t> bits = frame;
+    bits.insert(bits.end(), frame.begin(), frame.end());
+
+    AudioDataBuffer data_buffer;
+    bool decoded;
+    auto received = Demodulate(Modulate(bits, bit_rate, mark, space, noise_sigma), bit_rate, mark, space,
+                               data_buffer, decoded);
+
+    printf("%d bps, noise %.0f: %u bits out of %u\n", bit_rate, noise_sigma, (unsigned)received.size(),
+           (unsigned)bits.size());
+    CHECK(ContainsBits(received, frame));
+    CHECK(decoded);
+    CHECK(data_buffer.decoded_text.has_value() && *data_buffer.decoded_text == text);
+}
+
+// A single tone must drive the mark probability to the matching side once the window is full
+static void TestSteadyTone(int bit_rate, int mark, int space) {
+    size_t window_size = kAudioSampleRate / bit_rate;
+    for (int tone : { mark, space }) {
+        AudioSignalProcessor signal_processor(kAudioSampleRate, mark, space, bit_rate, window_size);
+        int decisions = 0;
+        int correct = 0;
+        for (int n = 0; n < (int)kAudioSampleRate; n++) {
+            int16_t sample = (int16_t)(10000 * std::sin(2 * M_PI * tone * n / kAudioSampleRate));
+            float probability;
+            if (signal_processor.ProcessSample(sample, probability)) {
+                decisions++;
+                correct += tone == mark ? probability > 0.9f : probability < 0.1f;
+            }
+        }
+        CHECK(decisions == bit_rate - 1);
+        CHECK(correct == decisions);
+    }
+}
+
+// The sliding bin must match a direct DFT of the last window, also after many slides
+static void TestSlidingDft() {
+    const size_t window_size = 64;
+    const size_t bin = 18;
+    FrequencyDetector detector(bin, window_size);
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> uniform(-20000, 20000);
+    std::vector<int16_t> samples;
+    for (int n = 0; n < 5000; n++) {
+        int16_t sample = (int16_t)uniform(rng);
+        int16_t oldest = samples.size() >= window_size ? samples[samples.size() - window_size] : 0;
+        samples.push_back(sample);
+        detector.ProcessSample(sample, oldest);
+    }
+
+    double real = 0;
+    double imaginary = 0;
+    for (size_t i = 0; i < window_size; i++) {
+        size_t n = samples.size() - window_size + i;
+        double angle = 2 * M_PI * bin * n / window_size;
+        real += samples[n] * std::cos(angle);
+        imaginary -= samples[n] * std::sin(angle);
+    }
+    double magnitude = std::hypot(real, imaginary);
+    double approximation = detector.GetMagnitude();
+    // Alpha max plus beta min stays within 7%, the Q15 rounding adds a little per sample
+    CHECK(std::abs(approximation - magnitude) <= magnitude * 0.07 + window_size * 2);
+}
+
+int main() {
+    TestSlidingDft();
+    TestSteadyTone(100, 1800, 1500);
+    TestSteadyTone(200, 1800, 1400);
+    TestRoundTrip(100, 1800, 1500, 0);
+    TestRoundTrip(200, 1800, 1400, 0);
+    TestRoundTrip(100, 1800, 1500, 3000);
+    TestRoundTrip(200, 1800, 1400, 3000);
+
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "drop_newest_queue.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+struct Packet {
+    int sequence;
+};
+
+static void TestKeepsOldestItems() {
+    DropNewestQueue<std::unique_ptr<Packet>> queue(4);
+    for (int i = 0; i < 4; i++) {
+        CHECK(queue.Push(std::make_unique<Packet>(Packet{i})));
+    }
+    CHECK(queue.size() == 4);
+
+    auto refused = std::make_unique<Packet>(Packet{4});
+    CHECK(!queue.Push(std::move(refused)));
+    CHECK(refused != nullptr && refused->sequence == 4);
+    CHECK(!queue.Push(std::make_unique<Packet>(Packet{5})));
+    CHECK(queue.size() == 4);
+    CHECK(queue.TakeDroppedCount() == 2);
+    CHECK(queue.TakeDroppedCount() == 0);
+
+    for (int expected = 0; expected < 4; expected++) {
+        CHECK(queue.Pop()->sequence == expected);
+    }
+    CHECK(queue.empty());
+}
+
+static void TestClear() {
+    DropNewestQueue<int> queue(2);
+    queue.Push(1);
+    queue.Push(2);
+    queue.Push(3);
+    queue.clear();
+    CHECK(queue.empty());
+    queue.Push(4);
+    CHECK(queue.front() == 4);
+}
+
+// Mirrors the send queue while the audio channel opens: the encoder keeps producing while
+// the main loop holds the queue, and must never wait for it to drain
+static void TestProducerNeverBlocksWhileConsumerHolds() {
+    const size_t capacity = 40;
+    const int produced = 500;
+    std::mutex mutex;
+    std::condition_variable cv;
+    DropNewestQueue<std::unique_ptr<Packet>> queue(capacity);
+    bool holding = true;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread encoder([&]() {
+        for (int i = 0; i < produced; i++) {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.Push(std::make_unique<Packet>(Packet{i}));
+        }
+    });
+    std::thread sender([&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return !holding; });
+    });
+
+    encoder.join();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    CHECK(elapsed < std::chrono::seconds(1));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        holding = false;
+    }
+    cv.notify_all();
+    sender.join();
+
+    CHECK(queue.size() == capacity);
+    CHECK(queue.TakeDroppedCount() == produced - capacity);
+    int expected = 0;
+    while (!queue.empty()) {
+        CHECK(queue.Pop()->sequence == expected);
+        expected++;
+    }
+    CHECK(expected == (int)capacity);
+}
+
+int main() {
+    TestKeepsOldestItems();
+    TestClear();
+    TestProducerNeverBlocksWhileConsumerHolds();
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,232 @@
+#include "message_dispatcher.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// A flat message as cJSON_Parse would return it, every member a string except "payload"
+class Message {
+public:
+    explicit Message(std::initializer_list<std::pair<const char*, const char*>> members) {
+        root_.type = cJSON_Object;
+        items_.resize(members.size());
+        keys_.reserve(members.size());
+        values_.reserve(members.size());
+        cJSON** link = &root_.child;
+        size_t i = 0;
+        for (auto& [key, value] : members) {
+            auto& item = items_[i++];
+            keys_.emplace_back(key);
+            item.string = keys_.back().data();
+            if (strcmp(key, "payload") == 0) {
+                item.type = cJSON_Object;
+            } else {
+                values_.emplace_back(value);
+                item.type = cJSON_String;
+                item.valuestring = values_.back().data();
+            }
+            *link = &item;
+            link = &item.next;
+        }
+    }
+    Message(const Message&) = delete;
+    Message& operator=(const Message&) = delete;
+
+    const cJSON* root() const { return &root_; }
+
+private:
+    cJSON root_;
+    std::vector<cJSON> items_;
+    std::vector<std::string> keys_;
+    std::vector<std::string> values_;
+};
+
+// The types Application and McpServer register, in their order
+static const char* const kTypes[] = { "tts", "stt", "llm", "system", "alert", "custom", "mcp" };
+
+using Members = std::initializer_list<std::pair<const char*, const char*>>;
+
+static void Add(std::vector<std::unique_ptr<Message>>& stream, Members members) {
+    stream.push_back(std::make_unique<Message>(members));
+}
+
+// One spoken turn as the server sends it: the transcript, an emotion, the reply sentences
+// and a tool call
+static std::vector<std::unique_ptr<Message>> RecordedTurn() {
+    std::vector<std::unique_ptr<Message>> stream;
+    Add(stream, { { "type", "stt" }, { "text", "What's the weather like today?" } });
+    Add(stream, { { "type", "llm" }, { "emotion", "happy" }, { "text", "😀" } });
+    Add(stream, { { "type", "tts" }, { "state", "start" } });
+    Add(stream, { { "type", "tts" }, { "state", "sentence_start" }, { "text", "It is sunny and warm." } });
+    Add(stream, { { "type", "tts" }, { "state", "sentence_start" }, { "text", "Around 25 degrees." } });
+    Add(stream, { { "type", "mcp" }, { "payload", nullptr } });
+    Add(stream, { { "type", "tts" }, { "state", "sentence_start" }, { "text", "Enjoy your day!" } });
+    Add(stream, { { "type", "tts" }, { "state", "stop" } });
+    return stream;
+}
+
+static void TestDispatch() {
+    MessageDispatcher dispatcher;
+    std::vector<std::string> handled;
+    for (auto type : kTypes) {
+        dispatcher.Register(type, [&handled, type](const cJSON* root) {
+            handled.push_back(type);
+        });
+    }
+
+    for (auto type : kTypes) {
+        Message message{ { "type", type } };
+        CHECK(dispatcher.Dispatch(message.root()));
+        CHECK(!handled.empty() && handled.back() == type);
+    }
+
+    size_t count = handled.size();
+    Message unknown{ { "type", "hello" } };
+    Message empty_type{ { "type", "" } };
+    Message no_type{ { "text", "tts" } };
+    CHECK(!dispatcher.Dispatch(unknown.root()));
+    CHECK(!dispatcher.Dispatch(empty_type.root()));
+    CHECK(!dispatcher.Dispatch(no_type.root()));
+    CHECK(handled.size() == count);
+
+    // A later registration replaces the handler, the way a board overrides a default one
+    bool replaced = false;
+    dispatcher.Register("tts", [&replaced](const cJSON* root) {
+        replaced = MessageDispatcher::GetString(root, "state") == "start";
+    });
+    Message tts{ { "type", "tts" }, { "state", "start" } };
+    CHECK(dispatcher.Dispatch(tts.root()));
+    CHECK(replaced);
+    CHECK(handled.size() == count);
+}
+
+// "costarring" and "liquid" share an FNV-1a hash, the stored type tells them apart
+static void TestHashCollision() {
+    static_assert(MessageDispatcher::Hash("costarring") == MessageDispatcher::Hash("liquid"), "not a collision");
+
+    MessageDispatcher dispatcher;
+    int costarring = 0;
+    int liquid = 0;
+    dispatcher.Register("costarring", [&costarring](const cJSON*) { costarring++; });
+    Message first{ { "type", "costarring" } };
+    Message second{ { "type", "liquid" } };
+    CHECK(dispatcher.Dispatch(first.root()));
+    CHECK(!dispatcher.Dispatch(second.root()));
+
+    dispatcher.Register("liquid", [&liquid](const cJSON*) { liquid++; });
+    CHECK(dispatcher.Dispatch(first.root()));
+    CHECK(dispatcher.Dispatch(second.root()));
+    CHECK(costarring == 2 && liquid == 1);
+}
+
+// Many types registered in arbitrary order must all stay reachable through the sorted table
+static void TestManyTypes() {
+    MessageDispatcher dispatcher;
+    std::vector<std::string> types;
+    for (int i = 0; i < 200; i++) {
+        types.push_back("type_" + std::to_string((i * 73) % 200));
+    }
+    int last = -1;
+    for (auto& type : types) {
+        int index = std::stoi(type.substr(5));
+        dispatcher.Register(type, [&last, index](const cJSON*) { last = index; });
+    }
+    for (int i = 0; i < 200; i++) {
+        std::string type = "type_" + std::to_string(i);
+        Message message{ { "type", type.c_str() } };
+        CHECK(dispatcher.Dispatch(message.root()));
+        CHECK(last == i);
+    }
+}
+
+// Replays the recorded turn through the dispatcher and through the strcmp chain it replaced.
+// The handlers only read the sub field they switch on, so the figures are dispatch cost.
+// Parsing is not measured, as cJSON is not part of the host build.
+static void BenchmarkDispatch() {
+    auto stream = RecordedTurn();
+    const int kRounds = 20000;
+    volatile size_t sink = 0;
+
+    MessageDispatcher dispatcher;
+    for (auto type : kTypes) {
+        dispatcher.Register(type, [&sink](const cJSON* root) {
+            auto state = MessageDispatcher::GetString(root, "state");
+            switch (MessageDispatcher::Hash(state)) {
+                case MessageDispatcher::Hash("start"): sink = sink + 1; break;
+                case MessageDispatcher::Hash("stop"): sink = sink + 2; break;
+                default: sink = sink + state.size(); break;
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (auto& message : stream) {
+            dispatcher.Dispatch(message->root());
+        }
+    }
+    auto dispatcher_time = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (auto& message : stream) {
+            auto type = cJSON_GetObjectItem(message->root(), "type");
+            if (!cJSON_IsString(type)) {
+                continue;
+            }
+            bool known = false;
+            for (auto name : kTypes) {
+                if (strcmp(type->valuestring, name) == 0) {
+                    known = true;
+                    break;
+                }
+            }
+            if (!known) {
+                continue;
+            }
+            auto state = cJSON_GetObjectItem(message->root(), "state");
+            if (cJSON_IsString(state)) {
+                if (strcmp(state->valuestring, "start") == 0) {
+                    sink = sink + 1;
+                } else if (strcmp(state->valuestring, "stop") == 0) {
+                    sink = sink + 2;
+                } else {
+                    sink = sink + strlen(state->valuestring);
+                }
+            }
+        }
+    }
+    auto chain_time = std::chrono::steady_clock::now() - start;
+
+    double messages = double(kRounds) * stream.size();
+    printf("Dispatcher: %.1f ns/message, strcmp chain: %.1f ns/message (%zu messages per turn)\n",
+           std::chrono::duration<double, std::nano>(dispatcher_time).count() / messages,
+           std::chrono::duration<double, std::nano>(chain_time).count() / messages, stream.size());
+}
+
+int main() {
+    TestDispatch();
+    TestHashCollision();
+    TestManyTypes();
+    BenchmarkDispatch();
+
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
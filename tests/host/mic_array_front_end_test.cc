@@ -0,0 +1,85 @@
+#include "mic_array_front_end.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static const int kSampleRate = 16000;
+static const int kSpacingMm = 65;
+static const int kFrameSamples = 512;
+static const int16_t kReference = 123;
+
+// Two microphones plus the reference, with a plane wave arriving from the given angle after
+// some silence. A positive angle reaches the second microphone first. The front end collapses
+// every frame to [beam, ref] in place.
+static int TrackSource(MicArrayFrontEnd& front_end, int degrees) {
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 300);
+    double lead = kSpacingMm * std::sin(degrees * M_PI / 180.0) * kSampleRate / 343000.0;
+    auto speech = [](double t) {
+        return 6000 * std::sin(2 * M_PI * 700 * t / kSampleRate) + 3000 * std::sin(2 * M_PI * 1300 * t / kSampleRate);
+    };
+
+    long t = 0;
+    for (int frame = 0; frame < 200; frame++) {
+        bool speaking = frame > 20;
+        std::vector<int16_t> data(kFrameSamples * 3);
+        for (int n = 0; n < kFrameSamples; n++, t++) {
+            data[n * 3] = (int16_t)((speaking ? speech(t) : 0) + noise(rng));
+            data[n * 3 + 1] = (int16_t)((speaking ? speech(t + lead) : 0) + noise(rng));
+            data[n * 3 + 2] = kReference;
+        }
+        CHECK(front_end.Process(data));
+        CHECK(data.size() == kFrameSamples * 2);
+        CHECK(data[1] == kReference && data[data.size() - 1] == kReference);
+    }
+    return front_end.GetDirection();
+}
+
+static void TestTracksDirection() {
+    for (int degrees : { 30, -60, 0 }) {
+        MicArrayFrontEnd front_end(2, true, kSpacingMm, kSampleRate);
+        int direction = TrackSource(front_end, degrees);
+        if (direction != degrees) {
+            printf("source at %d degrees, tracked %d\n", degrees, direction);
+        }
+        CHECK(direction == degrees);
+    }
+}
+
+static void TestSilenceKeepsBroadside() {
+    MicArrayFrontEnd front_end(2, false, kSpacingMm, kSampleRate);
+    std::vector<int16_t> data(kFrameSamples * 2, 0);
+    CHECK(front_end.Process(data));
+    CHECK(data.size() == kFrameSamples);
+    CHECK(front_end.GetDirection() == 0);
+}
+
+static void TestRejectsMismatchedLayout() {
+    MicArrayFrontEnd front_end(3, true, kSpacingMm, kSampleRate);
+    std::vector<int16_t> data(kFrameSamples * 4 + 1, 0);
+    CHECK(!front_end.Process(data));
+    CHECK(data.size() == kFrameSamples * 4 + 1);
+}
+
+int main() {
+    TestTracksDirection();
+    TestSilenceKeepsBroadside();
+    TestRejectsMismatchedLayout();
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "pcm_ops.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// Scalar references, the loops NoAudioCodec used before the kernels were shared
+
+static int32_t ReferenceVolumeToGain(int volume) {
+    return pow(double(volume) / 100.0, 2) * 65536;
+}
+
+static int32_t ReferenceWiden(int16_t sample, int32_t gain) {
+    int64_t temp = int64_t(sample) * gain;
+    return temp > INT32_MAX ? INT32_MAX : temp < INT32_MIN ? INT32_MIN : (int32_t)temp;
+}
+
+static int16_t ReferenceNarrow(int32_t sample, int shift) {
+    int32_t value = sample >> shift;
+    return (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+}
+
+static int16_t ReferenceGain16(int16_t sample, int gain) {
+    int32_t amplified = sample * gain;
+    return (amplified > INT16_MAX) ? INT16_MAX : (amplified < -INT16_MAX) ? -INT16_MAX : (int16_t)amplified;
+}
+
+static std::vector<int16_t> RandomSamples(size_t count, std::mt19937& rng) {
+    std::uniform_int_distribution<int> uniform(INT16_MIN, INT16_MAX);
+    std::vector<int16_t> samples(count);
+    for (auto& sample : samples) {
+        sample = (int16_t)uniform(rng);
+    }
+    // The extremes are where the clamps and the int32 headroom matter
+    if (count >= 2) {
+        samples[0] = INT16_MIN;
+        samples[1] = INT16_MAX;
+    }
+    return samples;
+}
+
+static void TestVolumeToGain() {
+    for (int volume = -10; volume <= 110; volume++) {
+        int clamped = volume < 0 ? 0 : volume > 100 ? 100 : volume;
+        CHECK(std::abs(pcm_volume_to_gain(volume) - ReferenceVolumeToGain(clamped)) <= 1);
+    }
+    CHECK(pcm_volume_to_gain(0) == 0);
+    CHECK(pcm_volume_to_gain(100) == 65536);
+}
+
+// A steady gain widens 16-bit samples into 32-bit I2S slots exactly like the old int64 loop,
+// for every length so the unrolled body and the tail are both covered
+static void TestWidenSteady() {
+    std::mt19937 rng(1);
+    for (size_t count : { 0, 1, 3, 4, 7, 240, 243 }) {
+        auto src = RandomSamples(count, rng);
+        for (int volume : { 0, 1, 37, 70, 99, 100 }) {
+            int32_t gain = pcm_volume_to_gain(volume);
+            std::vector<int32_t> dst(count);
+            pcm_widen_gain(dst.data(), src.data(), count, gain, gain);
+            for (size_t i = 0; i < count; i++) {
+                CHECK(dst[i] == ReferenceWiden(src[i], gain));
+            }
+        }
+    }
+}
+
+// A volume change moves the gain linearly over the buffer, starting at the old gain and
+// ending one step short of the new one, which the next buffer starts with
+static void TestWidenRamp() {
+    std::mt19937 rng(2);
+    const int32_t ramps[][2] = { { 0, 65536 }, { 65536, 0 }, { 6553, 42598 }, { 42598, 42000 } };
+    for (size_t count : { 1, 5, 240, 1023 }) {
+        auto src = RandomSamples(count, rng);
+        for (auto& ramp : ramps) {
+            int32_t from = ramp[0];
+            int32_t to = ramp[1];
+            std::vector<int32_t> dst(count);
+            pcm_widen_gain(dst.data(), src.data(), count, from, to);
+
+            // The Q8 step is truncated, so the gain may lag by up to one unit per 256 samples
+            double tolerance = 2.0 + count / 256.0;
+            int32_t previous_gain = from;
+            for (size_t i = 0; i < count; i++) {
+                double gain = from + double(to - from) * i / count;
+                CHECK(std::abs(dst[i] - src[i] * gain) <= std::abs(src[i]) * tolerance);
+                CHECK(std::abs(int64_t(dst[i])) <= std::abs(int64_t(src[i]) * std::max(from, to)));
+                // The gain never moves away from the target
+                if (src[i] != 0) {
+                    int32_t applied = dst[i] / src[i];
+                    CHECK(to > from ? applied >= previous_gain : applied <= previous_gain);
+                    previous_gain = applied;
+                }
+            }
+        }
+    }
+}
+
+// 32-bit slots from the I2S microphones to 16-bit samples, covering the shift the simplex
+// and duplex reads use and a full 16-bit one
+static void TestNarrow() {
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int32_t> uniform(INT32_MIN, INT32_MAX);
+    for (size_t count : { 0, 1, 4, 6, 257 }) {
+        std::vector<int32_t> src(count);
+        for (auto& sample : src) {
+            sample = uniform(rng);
+        }
+        if (count >= 2) {
+            src[0] = INT32_MIN;
+            src[1] = INT32_MAX;
+        }
+        for (int shift : { 12, 14, 16 }) {
+            std::vector<int16_t> dst(count);
+            pcm_narrow(dst.data(), src.data(), count, shift);
+            for (size_t i = 0; i < count; i++) {
+                CHECK(dst[i] == ReferenceNarrow(src[i], shift));
+            }
+        }
+    }
+}
+
+// The PDM microphone delivers 16-bit samples that are amplified in place
+static void TestGain16() {
+    std::mt19937 rng(4);
+    for (size_t count : { 0, 1, 4, 9, 480 }) {
+        auto src = RandomSamples(count, rng);
+        for (int gain : { 0, 1, 2, 8, 31 }) {
+            auto samples = src;
+            pcm_gain16(samples.data(), count, gain);
+            for (size_t i = 0; i < count; i++) {
+                CHECK(samples[i] == ReferenceGain16(src[i], gain));
+            }
+        }
+    }
+}
+
+int main() {
+    TestVolumeToGain();
+    TestWidenSteady();
+    TestWidenRamp();
+    TestNarrow();
+    TestGain16();
+
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include "pixel_ops.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static std::mt19937 rng(5);
+
+static std::vector<uint8_t> RandomBytes(size_t count) {
+    std::uniform_int_distribution<int> uniform(0, 255);
+    std::vector<uint8_t> bytes(count);
+    for (auto& byte : bytes) {
+        byte = (uint8_t)uniform(rng);
+    }
+    return bytes;
+}
+
+static uint16_t Pack565(int r, int g, int b) {
+    return (uint16_t)(((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3));
+}
+
+// Every combination of source and destination alignment, in place and out of place,
+// with lengths that leave a tail after the four word loop
+static void TestSwapBytes() {
+    for (size_t count : { 0, 1, 2, 3, 8, 9, 17, 301 }) {
+        for (int src_offset = 0; src_offset < 2; src_offset++) {
+            for (int dst_offset = 0; dst_offset < 2; dst_offset++) {
+                std::vector<uint16_t> src(count + 2);
+                for (auto& pixel : src) {
+                    pixel = (uint16_t)rng();
+                }
+                std::vector<uint16_t> dst(count + 2, 0xdead);
+                pixel_swap_bytes16(dst.data() + dst_offset, src.data() + src_offset, count);
+                for (size_t i = 0; i < count; i++) {
+                    uint16_t pixel = src[src_offset + i];
+                    CHECK(dst[dst_offset + i] == (uint16_t)((pixel >> 8) | (pixel << 8)));
+                }
+                CHECK(dst[dst_offset + count] == 0xdead);
+            }
+
+            std::vector<uint16_t> buffer(count + 1);
+            for (auto& pixel : buffer) {
+                pixel = (uint16_t)rng();
+            }
+            auto expected = buffer;
+            pixel_swap_bytes16(buffer.data() + src_offset, buffer.data() + src_offset, count);
+            for (size_t i = 0; i < count; i++) {
+                uint16_t pixel = expected[src_offset + i];
+                CHECK(buffer[src_offset + i] == (uint16_t)((pixel >> 8) | (pixel << 8)));
+            }
+        }
+    }
+}
+
+static void TestDownscale() {
+    const int src_width = 24;
+    const int src_height = 12;
+    std::vector<uint16_t> src(src_width * src_height);
+    for (auto& pixel : src) {
+        pixel = (uint16_t)rng();
+    }
+    for (int factor : { 1, 2, 3, 4 }) {
+        int dst_width = src_width / factor;
+        int dst_height = src_height / factor;
+        std::vector<uint16_t> dst(dst_width * dst_height);
+        pixel_downscale16(dst.data(), dst_width, dst_height, src.data(), src_width, factor);
+        for (int y = 0; y < dst_height; y++) {
+            for (int x = 0; x < dst_width; x++) {
+                CHECK(dst[y * dst_width + x] == src[y * factor * src_width + x * factor]);
+            }
+        }
+    }
+}
+
+// Full range BT.601 in floating point, each channel may land one quantization step off
+static void TestYuyvToRgb565() {
+    const int src_width = 16;
+    const int src_height = 6;
+    auto src = RandomBytes(src_width * src_height * 2);
+    for (int factor : { 1, 2, 3 }) {
+        int dst_width = src_width / factor;
+        int dst_height = src_height / factor;
+        std::vector<uint16_t> dst(dst_width * dst_height);
+        pixel_yuyv_to_rgb565(dst.data(), dst_width, dst_height, src.data(), src_width, factor);
+        for (int y = 0; y < dst_height; y++) {
+            for (int x = 0; x < dst_width; x++) {
+                int sx = x * factor;
+                const uint8_t* pair = &src[(y * factor * src_width + (sx & ~1)) * 2];
+                double luma = pair[(sx & 1) * 2];
+                double u = pair[1] - 128.0;
+                double v = pair[3] - 128.0;
+                double r = std::fmin(255, std::fmax(0, luma + 1.402 * v));
+                double g = std::fmin(255, std::fmax(0, luma - 0.344136 * u - 0.714136 * v));
+                double b = std::fmin(255, std::fmax(0, luma + 1.772 * u));
+
+                uint16_t pixel = dst[y * dst_width + x];
+                CHECK(std::abs((pixel >> 11) * 8 - r) <= 8 + 1);
+                CHECK(std::abs(((pixel >> 5) & 0x3f) * 4 - g) <= 4 + 1);
+                CHECK(std::abs((pixel & 0x1f) * 8 - b) <= 8 + 1);
+            }
+        }
+    }
+}
+
+static void TestRgb888ToRgb565() {
+    const int src_width = 10;
+    const int src_height = 4;
+    auto src = RandomBytes(src_width * src_height * 3);
+    for (int factor : { 1, 2 }) {
+        int dst_width = src_width / factor;
+        int dst_height = src_height / factor;
+        std::vector<uint16_t> dst(dst_width * dst_height);
+        pixel_rgb888_to_rgb565(dst.data(), dst_width, dst_height, src.data(), src_width, factor);
+        for (int y = 0; y < dst_height; y++) {
+            for (int x = 0; x < dst_width; x++) {
+                const uint8_t* p = &src[(y * factor * src_width + x * factor) * 3];
+                CHECK(dst[y * dst_width + x] == Pack565(p[0], p[1], p[2]));
+            }
+        }
+    }
+}
+
+static pixel_luma_stats_t ReferenceLumaStats(const std::vector<int>& luma, int width, int height, int row_step) {
+    pixel_luma_stats_t stats = {};
+    for (int y = 0; y < height; y += row_step) {
+        for (int x = 0; x < width; x++) {
+            int v = luma[y * width + x];
+            int prev = luma[y * width + (x > 0 ? x - 1 : 0)];
+            stats.samples++;
+            stats.sum += v;
+            stats.gradient += std::abs(v - prev);
+            stats.clipped += v <= 8 || v >= 247;
+        }
+    }
+    return stats;
+}
+
+static bool SameStats(const pixel_luma_stats_t& a, const pixel_luma_stats_t& b) {
+    return a.samples == b.samples && a.sum == b.sum && a.gradient == b.gradient && a.clipped == b.clipped;
+}
+
+// GREY and YUYV, with the YUYV rows both word aligned (word loop) and not (byte loop)
+static void TestLumaStats8() {
+    const int width = 13;
+    const int height = 7;
+    for (int pixel_stride : { 1, 2 }) {
+        for (int offset : { 0, 2 }) {
+            auto bytes = RandomBytes(width * height * pixel_stride + offset);
+            // Some clipped samples
+            bytes[offset] = 0;
+            bytes[offset + pixel_stride] = 255;
+            std::vector<int> luma(width * height);
+            for (int i = 0; i < width * height; i++) {
+                luma[i] = bytes[offset + i * pixel_stride];
+            }
+            for (int row_step : { 1, 3 }) {
+                pixel_luma_stats_t stats = {};
+                pixel_luma_stats8(bytes.data() + offset, width, height, pixel_stride, row_step, &stats);
+                CHECK(SameStats(stats, ReferenceLumaStats(luma, width, height, row_step)));
+            }
+        }
+    }
+}
+
+static void TestLumaStats565() {
+    const int width = 9;
+    const int height = 5;
+    std::vector<uint16_t> pixels(width * height);
+    for (auto& pixel : pixels) {
+        pixel = (uint16_t)rng();
+    }
+    for (bool big_endian : { false, true }) {
+        std::vector<int> luma(width * height);
+        for (int i = 0; i < width * height; i++) {
+            uint16_t pixel = big_endian ? (uint16_t)((pixels[i] >> 8) | (pixels[i] << 8)) : pixels[i];
+            luma[i] = ((pixel >> 5) & 0x3f) << 2;
+        }
+        pixel_luma_stats_t stats = {};
+        pixel_luma_stats565(pixels.data(), width, height, big_endian, 2, &stats);
+        CHECK(SameStats(stats, ReferenceLumaStats(luma, width, height, 2)));
+    }
+}
+
+int main() {
+    TestSwapBytes();
+    TestDownscale();
+    TestYuyvToRgb565();
+    TestRgb888ToRgb565();
+    TestLumaStats8();
+    TestLumaStats565();
+
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
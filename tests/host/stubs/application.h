@@ -0,0 +1,30 @@
+// Minimal stand-in for the parts of Application the acoustic provisioning loop touches
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "display.h"
+
+#define pdMS_TO_TICKS(ms) (ms)
+inline void vTaskDelay(int) {}
+inline void esp_restart() {}
+
+enum DeviceState {
+    kDeviceStateIdle,
+    kDeviceStateWifiConfiguring,
+};
+
+class AudioService {
+public:
+    bool ReadAudioData(std::vector<int16_t>&, int, int) { return false; }
+};
+
+class Application {
+public:
+    DeviceState GetDeviceState() const { return kDeviceStateIdle; }
+    AudioService& GetAudioService() { return audio_service_; }
+
+private:
+    AudioService audio_service_;
+};
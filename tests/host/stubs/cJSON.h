@@ -0,0 +1,33 @@
+// Minimal stand-in for the cJSON object model, enough to build messages by hand.
+// There is no parser, the tests construct the trees cJSON_Parse would return.
+#pragma once
+
+#include <cstring>
+
+#define cJSON_String (1 << 4)
+#define cJSON_Object (1 << 6)
+
+struct cJSON {
+    cJSON* next = nullptr;
+    cJSON* child = nullptr;
+    int type = 0;
+    char* valuestring = nullptr;
+    char* string = nullptr;
+};
+
+inline cJSON* cJSON_GetObjectItem(const cJSON* object, const char* key) {
+    for (cJSON* item = object != nullptr ? object->child : nullptr; item != nullptr; item = item->next) {
+        if (item->string != nullptr && strcmp(item->string, key) == 0) {
+            return item;
+        }
+    }
+    return nullptr;
+}
+
+inline bool cJSON_IsString(const cJSON* item) {
+    return item != nullptr && (item->type & 0xff) == cJSON_String;
+}
+
+inline bool cJSON_IsObject(const cJSON* item) {
+    return item != nullptr && (item->type & 0xff) == cJSON_Object;
+}
@@ -0,0 +1,7 @@
+// Minimal stand-in for Display
+#pragma once
+
+class Display {
+public:
+    void SetChatMessage(const char*, const char*) {}
+};
@@ -0,0 +1,10 @@
+// Minimal stand-in for WifiConfigurationAp
+#pragma once
+
+#include <string>
+
+class WifiConfigurationAp {
+public:
+    bool ConnectToWifi(const std::string&, const std::string&) { return false; }
+    void Save(const std::string&, const std::string&) {}
+};